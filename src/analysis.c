@@ -0,0 +1,651 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include <math.h>
+#include "analysis.h"
+#include "spectrum.h"
+#include "window.h"
+
+#if !defined(AT_NO_SIMD) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#    define AT_SIMD_X86
+#    include <immintrin.h>
+#endif
+
+#ifndef M_PI
+#    define M_PI 3.14159265358979323846
+#endif
+
+#define LOUDNESS_OFFSET   (-0.691)              // offset of loudness of ITU-R BS.1770 in LU
+#define TRUE_PEAK_BETA    4.0                   // shape of Kaiser window of true peak interpolator
+
+// loudness of weighted mean square in LUFS
+static double loudness(double energy) {
+    return LOUDNESS_OFFSET + 10 * log10(energy);
+}
+
+// weighted mean square of center of histogram bin
+static double bin_energy(int bin) {
+    return pow(10, (LOUDNESS_MIN + (bin + 0.5) * (LOUDNESS_MAX - LOUDNESS_MIN) / LOUDNESS_BINS - LOUDNESS_OFFSET) / 10);
+}
+
+// loudness of center of histogram bin
+static double bin_loudness(int bin) {
+    return LOUDNESS_MIN + (bin + 0.5) * (LOUDNESS_MAX - LOUDNESS_MIN) / LOUDNESS_BINS;
+}
+
+// first bin of loudness not below 'gate'
+static int gate_bin(double gate) {
+    double bin = ceil((gate - LOUDNESS_MIN) * LOUDNESS_BINS / (LOUDNESS_MAX - LOUDNESS_MIN));
+
+    return (int) MIN(MAX(bin, 0), LOUDNESS_BINS);
+}
+
+// count block of given loudness, blocks below absolute gate are dropped
+static void histogram_add(uint32_t *histogram, double value) {
+    if (value < LOUDNESS_MIN)
+        return;
+
+    histogram[MIN((int) ((value - LOUDNESS_MIN) * LOUDNESS_BINS / (LOUDNESS_MAX - LOUDNESS_MIN)), LOUDNESS_BINS - 1)]++;
+}
+
+// mean of weighted mean squares of bins starting at 'first'; returns count of blocks in them
+static uint64_t histogram_mean(const uint32_t *histogram, int first, double *mean) {
+    double sum = 0;
+    uint64_t count = 0;
+
+    for (int i = first; i < LOUDNESS_BINS; i++) {
+        if (histogram[i] > 0) {
+            sum += histogram[i] * bin_energy(i);
+            count += histogram[i];
+        }
+    }
+
+    *mean = count > 0 ? sum / count : 0;
+
+    return count;
+}
+
+// loudness at given share of blocks of bins starting at 'first', which hold 'count' blocks
+static double histogram_percentile(const uint32_t *histogram, int first, uint64_t count, double share) {
+    uint64_t rank = (uint64_t) (share * (count - 1)), seen = 0;
+
+    for (int i = first; i < LOUDNESS_BINS; i++) {
+        seen += histogram[i];
+        if (seen > rank)
+            return bin_loudness(i);
+    }
+
+    return bin_loudness(LOUDNESS_BINS - 1);
+}
+
+/* Weights of channels of BS.1770 for positions of layout; LFE is not measured and surround
+ * channels are weighted by +1.5 dB. Output of LFE channel only is measured unweighted. */
+static void channel_weights(at_analysis_t *analysis, const int *layout) {
+    bool any = false;
+
+    for (int c = 0; c < analysis->channels; c++) {
+        analysis->weight[c] = 1.0;
+
+        if (layout == NULL)
+            continue;
+
+        if (layout[c] == LFE)
+            analysis->weight[c] = 0;
+        else if (layout[c] == SL || layout[c] == SR || layout[c] == SSL || layout[c] == SSR)
+            analysis->weight[c] = 1.41;
+    }
+
+    for (int c = 0; c < analysis->channels; c++)
+        any = any || analysis->weight[c] > 0;
+
+    for (int c = 0; c < analysis->channels && !any; c++)
+        analysis->weight[c] = 1.0;
+}
+
+// Kaiser windowed sinc interpolating sample 'delay' past the one 'TRUE_PEAK_TAPS / 2' samples before the last tap
+static void interpolator(double delay, double *taps) {
+    double half = TRUE_PEAK_TAPS / 2.0, norm = at_bessel_i0(TRUE_PEAK_BETA), sum = 0;
+
+    for (int t = 0; t < TRUE_PEAK_TAPS; t++) {
+        double u = half - 1 - t + delay, r = u / half;
+
+        taps[t] = sin(M_PI * u) / (M_PI * u) * at_bessel_i0(TRUE_PEAK_BETA * sqrt(MAX(1 - r * r, 0))) / norm;
+        sum += taps[t];
+    }
+
+    // unit gain at DC
+    for (int t = 0; t < TRUE_PEAK_TAPS; t++)
+        taps[t] /= sum;
+}
+
+/* Polyphase interpolator of true peak. Phase 'p / phases' is the reverse of phase '1 - p / phases',
+ * so phase of half a sample is symmetric and phases of quarters are given by sum and difference
+ * of their symmetric and antisymmetric parts. Phase 0 is the sample itself. */
+static void true_peak_init(at_analysis_t *analysis) {
+    double half[TRUE_PEAK_TAPS], quarter[TRUE_PEAK_TAPS], half_gain = 0, quarter_gain = 0;
+
+    analysis->phases = analysis->samplerate < 96000 ? 4 : analysis->samplerate < 192000 ? 2 : 1;
+
+    interpolator(0.5, half);
+    interpolator(0.25, quarter);
+
+    for (int t = 0; t < TRUE_PEAK_TAPS; t++) {
+        half_gain += fabs(half[t]);
+        quarter_gain += fabs(quarter[t]);
+    }
+
+    for (int t = 0; t < TRUE_PEAK_TAPS / 2; t++) {
+        analysis->tp_half[t] = (sample_t) half[t];
+        analysis->tp_even[t] = (sample_t) ((quarter[t] + quarter[TRUE_PEAK_TAPS - 1 - t]) / 2);
+        analysis->tp_odd[t] = (sample_t) ((quarter[t] - quarter[TRUE_PEAK_TAPS - 1 - t]) / 2);
+    }
+
+    analysis->tp_gain = analysis->phases == 4 ? MAX(half_gain, quarter_gain) : half_gain;
+}
+
+// octave bands of FFT bins, bins of a band lie in <center / sqrt(2), center * sqrt(2))
+static void bands_init(at_analysis_t *analysis, int spectrum_rate) {
+    int bins = SPECTRUM_BINS(analysis->fft_size);
+
+    analysis->bin_width = (double) spectrum_rate / analysis->fft_size;
+    analysis->bands = 0;
+
+    for (int b = 0; b < ANALYSIS_BANDS && 1000 * pow(2, b - 5) < spectrum_rate / 2.0; b++) {
+        double low = 1000 * pow(2, b - 5.5), high = 1000 * pow(2, b - 4.5);
+
+        analysis->band_start[b] = MIN((int) ceil(low / analysis->bin_width), bins);
+        analysis->band_start[b + 1] = MIN((int) ceil(high / analysis->bin_width), bins);
+        analysis->bands++;
+    }
+}
+
+void at_analysis_init(at_analysis_t *analysis, int channels, const int *layout, int samplerate, int fft_size,
+                      int spectrum_rate, const sample_t *window, size_t window_size) {
+    memset(analysis, 0, sizeof(*analysis));
+
+    analysis->channels = channels;
+    analysis->samplerate = samplerate;
+
+    channel_weights(analysis, layout);
+    for (int c = 0; c < channels; c++)
+        at_iir_k_weighting(&analysis->k_filter[c], samplerate);
+
+    analysis->block_size = (size_t) MAX(samplerate / 10, 1);
+    analysis->momentary_max = -INFINITY;
+    analysis->short_term_max = -INFINITY;
+    analysis->momentary_hist = at_malloc(sizeof(uint32_t) * LOUDNESS_BINS);
+    analysis->short_term_hist = at_malloc(sizeof(uint32_t) * LOUDNESS_BINS);
+    memset(analysis->momentary_hist, 0, sizeof(uint32_t) * LOUDNESS_BINS);
+    memset(analysis->short_term_hist, 0, sizeof(uint32_t) * LOUDNESS_BINS);
+
+    true_peak_init(analysis);
+    analysis->scratch = init_buffer_sample(TRUE_PEAK_TAPS - 1 + ANALYSIS_CHUNK);
+
+    analysis->fft_size = fft_size;
+    analysis->power = init_buffer_sample(SPECTRUM_BINS(fft_size));
+    bands_init(analysis, spectrum_rate);
+
+    for (size_t i = 0; i < window_size; i++)
+        analysis->window_energy += (double) window[i] * window[i];
+}
+
+// max. magnitude of samples; maxima of four lanes are independent, so the loop vectorizes
+static sample_t peak_of(const sample_t *data, size_t length) {
+    sample_t max[4] = {0, 0, 0, 0};
+    size_t i = 0;
+
+    for (; i + 4 <= length; i += 4) {
+        for (int l = 0; l < 4; l++)
+            max[l] = MAX(max[l], fabs(data[i + l]));
+    }
+    for (; i < length; i++)
+        max[0] = MAX(max[0], fabs(data[i]));
+
+    return MAX(MAX(max[0], max[1]), MAX(max[2], max[3]));
+}
+
+// max. magnitude of 'frames' samples interpolated by true peak interpolator from 'data'
+static sample_t interpolated_peak(const at_analysis_t *analysis, const sample_t *data, size_t frames) {
+    sample_t out[TRUE_PEAK_BLOCK];
+
+    // symmetric taps are added first, the loop of samples vectorizes
+    if (analysis->phases == 4) {
+        for (size_t i = 0; i < frames; i++) {
+            const sample_t *x = data + i;
+            sample_t center = 0, even = 0, odd = 0;
+
+            for (int t = 0; t < TRUE_PEAK_TAPS / 2; t++) {
+                sample_t sum = x[t] + x[TRUE_PEAK_TAPS - 1 - t], diff = x[t] - x[TRUE_PEAK_TAPS - 1 - t];
+
+                center += analysis->tp_half[t] * sum;
+                even += analysis->tp_even[t] * sum;
+                odd += analysis->tp_odd[t] * diff;
+            }
+
+            // larger of quarter phases is 'even + odd' or 'even - odd'
+            out[i] = MAX(fabs(even) + fabs(odd), fabs(center));
+        }
+    }
+    else {
+        for (size_t i = 0; i < frames; i++) {
+            const sample_t *x = data + i;
+            sample_t center = 0;
+
+            for (int t = 0; t < TRUE_PEAK_TAPS / 2; t++)
+                center += analysis->tp_half[t] * (x[t] + x[TRUE_PEAK_TAPS - 1 - t]);
+            out[i] = fabs(center);
+        }
+    }
+
+    return peak_of(out, frames);
+}
+
+/* Sample peak of 'frames' samples of channel and their true peak. Samples interpolated in a block
+ * of TRUE_PEAK_BLOCK samples depend only on the block and the next one, so a block is
+ * interpolated only if the bound of interpolator gain lets it exceed the current true peak. */
+static void analyse_peaks(at_analysis_t *analysis, int c, const sample_t *data, size_t frames) {
+    sample_t *buffer = analysis->scratch;
+    size_t history = TRUE_PEAK_TAPS - 1, length = history + frames;
+    size_t blocks = (length + TRUE_PEAK_BLOCK - 1) / TRUE_PEAK_BLOCK;
+    // blocks of history and the longest chunk, followed by the empty block
+    sample_t block_max[(TRUE_PEAK_TAPS - 1 + ANALYSIS_CHUNK + TRUE_PEAK_BLOCK - 1) / TRUE_PEAK_BLOCK + 1];
+
+    if (analysis->phases == 1) {
+        analysis->sample_peak[c] = MAX(analysis->sample_peak[c], peak_of(data, frames));
+        return;
+    }
+
+    memcpy(buffer, analysis->tp_history[c], sizeof(*buffer) * history);
+    memcpy(buffer + history, data, sizeof(*buffer) * frames);
+    memcpy(analysis->tp_history[c], buffer + frames, sizeof(*buffer) * history);
+
+    // samples of history were already counted by sample peak
+    for (size_t b = 0; b < blocks; b++) {
+        block_max[b] = peak_of(buffer + b * TRUE_PEAK_BLOCK, MIN(TRUE_PEAK_BLOCK, length - b * TRUE_PEAK_BLOCK));
+        analysis->sample_peak[c] = MAX(analysis->sample_peak[c], block_max[b]);
+    }
+    block_max[blocks] = 0;
+
+    for (size_t i = 0, b = 0; i < frames; i += TRUE_PEAK_BLOCK, b++) {
+        if (MAX(block_max[b], block_max[b + 1]) * analysis->tp_gain > analysis->true_peak[c])
+            analysis->true_peak[c] = MAX(analysis->true_peak[c],
+                                         interpolated_peak(analysis, buffer + i, MIN(TRUE_PEAK_BLOCK, frames - i)));
+    }
+}
+
+/* K-weighting of a pair of channels: states 'z' of both sections of both filters are updated,
+ * squares of output are added to 'sum'. Both sections run in a single loop, so that their
+ * recursions overlap; terms of input and older state are summed first, out of the recursion. */
+#ifdef AT_SIMD_X86
+// lanes of vectors hold the pair of channels
+static void k_weighting_pair(const at_biquad_t *shelf, const at_biquad_t *high_pass, const sample_t *x0,
+                             const sample_t *x1, size_t frames, double z[4][2], double sum[2]) {
+    __m128d sb0 = _mm_set1_pd(shelf->b0), sb1 = _mm_set1_pd(shelf->b1), sb2 = _mm_set1_pd(shelf->b2);
+    __m128d sa1 = _mm_set1_pd(shelf->a1), sa2 = _mm_set1_pd(shelf->a2);
+    __m128d hb0 = _mm_set1_pd(high_pass->b0), hb1 = _mm_set1_pd(high_pass->b1), hb2 = _mm_set1_pd(high_pass->b2);
+    __m128d ha1 = _mm_set1_pd(high_pass->a1), ha2 = _mm_set1_pd(high_pass->a2);
+    __m128d z0 = _mm_loadu_pd(z[0]), z1 = _mm_loadu_pd(z[1]), z2 = _mm_loadu_pd(z[2]), z3 = _mm_loadu_pd(z[3]);
+    __m128d acc = _mm_setzero_pd();
+
+    for (size_t i = 0; i < frames; i++) {
+        __m128d x = _mm_set_pd((double) x1[i], (double) x0[i]);
+        __m128d u = _mm_add_pd(_mm_mul_pd(sb0, x), z0);
+        __m128d y;
+
+        z0 = _mm_sub_pd(_mm_add_pd(_mm_mul_pd(sb1, x), z1), _mm_mul_pd(sa1, u));
+        z1 = _mm_sub_pd(_mm_mul_pd(sb2, x), _mm_mul_pd(sa2, u));
+
+        y = _mm_add_pd(_mm_mul_pd(hb0, u), z2);
+        z2 = _mm_sub_pd(_mm_add_pd(_mm_mul_pd(hb1, u), z3), _mm_mul_pd(ha1, y));
+        z3 = _mm_sub_pd(_mm_mul_pd(hb2, u), _mm_mul_pd(ha2, y));
+
+        acc = _mm_add_pd(acc, _mm_mul_pd(y, y));
+    }
+
+    _mm_storeu_pd(z[0], z0);
+    _mm_storeu_pd(z[1], z1);
+    _mm_storeu_pd(z[2], z2);
+    _mm_storeu_pd(z[3], z3);
+    _mm_storeu_pd(sum, _mm_add_pd(_mm_loadu_pd(sum), acc));
+}
+#else
+static void k_weighting_pair(const at_biquad_t *shelf, const at_biquad_t *high_pass, const sample_t *x0,
+                             const sample_t *x1, size_t frames, double z[4][2], double sum[2]) {
+    const sample_t *data[2] = {x0, x1};
+
+    for (size_t i = 0; i < frames; i++) {
+        for (int l = 0; l < 2; l++) {
+            double x = data[l][i];
+            double u = shelf->b0 * x + z[0][l];
+            double y;
+
+            z[0][l] = (shelf->b1 * x + z[1][l]) - shelf->a1 * u;
+            z[1][l] = shelf->b2 * x - shelf->a2 * u;
+
+            y = high_pass->b0 * u + z[2][l];
+            z[2][l] = (high_pass->b1 * u + z[3][l]) - high_pass->a1 * y;
+            z[3][l] = high_pass->b2 * u - high_pass->a2 * y;
+
+            sum[l] += y * y;
+        }
+    }
+}
+#endif
+
+/* Squares of K-weighted samples of channels 'c' and 'c + 1' are added to sums of current block;
+ * the last of odd count of channels is paired with a copy of its filter state, which is dropped. */
+static void analyse_loudness(at_analysis_t *analysis, int c, sample_t *const *channel, size_t offset, size_t frames) {
+    int pair = MIN(c + 1, analysis->channels - 1);
+    at_biquad_t *shelf[2] = {&analysis->k_filter[c].section[0], &analysis->k_filter[pair].section[0]};
+    at_biquad_t *high_pass[2] = {&analysis->k_filter[c].section[1], &analysis->k_filter[pair].section[1]};
+    double z[4][2], sum[2] = {0, 0};
+
+    for (int l = 0; l < 2; l++) {
+        z[0][l] = shelf[l]->z1;
+        z[1][l] = shelf[l]->z2;
+        z[2][l] = high_pass[l]->z1;
+        z[3][l] = high_pass[l]->z2;
+    }
+
+    k_weighting_pair(shelf[0], high_pass[0], channel[c] + offset, channel[pair] + offset, frames, z, sum);
+
+    for (int l = 0; l < (pair != c ? 2 : 1); l++) {
+        shelf[l]->z1 = z[0][l];
+        shelf[l]->z2 = z[1][l];
+        high_pass[l]->z1 = z[2][l];
+        high_pass[l]->z2 = z[3][l];
+    }
+
+    analysis->block_sum[c] += sum[0];
+    if (pair != c)
+        analysis->block_sum[pair] += sum[1];
+}
+
+// mean of weighted mean squares of last 'count' blocks
+static double block_mean(const at_analysis_t *analysis, int count) {
+    double sum = 0;
+
+    for (int i = 1; i <= count; i++)
+        sum += analysis->energy[(analysis->blocks - i) % SHORT_TERM_BLOCKS];
+
+    return sum / count;
+}
+
+// complete 100 ms block, momentary and short-term loudness are updated once their windows are full
+static void block_end(at_analysis_t *analysis) {
+    double energy = 0;
+
+    for (int c = 0; c < analysis->channels; c++) {
+        energy += analysis->weight[c] * analysis->block_sum[c] / analysis->block_size;
+        analysis->block_sum[c] = 0;
+    }
+
+    analysis->energy[analysis->blocks % SHORT_TERM_BLOCKS] = energy;
+    analysis->blocks++;
+    analysis->block_fill = 0;
+
+    if (analysis->blocks >= MOMENTARY_BLOCKS) {
+        double value = loudness(block_mean(analysis, MOMENTARY_BLOCKS));
+
+        analysis->momentary_max = MAX(analysis->momentary_max, value);
+        histogram_add(analysis->momentary_hist, value);
+    }
+
+    if (analysis->blocks >= SHORT_TERM_BLOCKS) {
+        double value = loudness(block_mean(analysis, SHORT_TERM_BLOCKS));
+
+        analysis->short_term_max = MAX(analysis->short_term_max, value);
+        histogram_add(analysis->short_term_hist, value);
+    }
+}
+
+void at_analysis_samples(at_analysis_t *analysis, sample_t *const *channel, size_t frames) {
+    size_t done = 0;
+
+    // chunks never cross boundary of a block
+    while (done < frames) {
+        size_t count = MIN(MIN(frames - done, ANALYSIS_CHUNK), analysis->block_size - analysis->block_fill);
+
+        for (int c = 0; c < analysis->channels; c++)
+            analyse_peaks(analysis, c, channel[c] + done, count);
+        for (int c = 0; c < analysis->channels; c += 2)
+            analyse_loudness(analysis, c, channel, done, count);
+
+        done += count;
+        analysis->block_fill += count;
+        if (analysis->block_fill == analysis->block_size)
+            block_end(analysis);
+    }
+
+    analysis->frames += frames;
+}
+
+void at_analysis_spectrum(at_analysis_t *analysis, const audio_container_t *spectrum) {
+    int bins = SPECTRUM_BINS(analysis->fft_size);
+
+    for (int c = 0; c < MIN(analysis->channels, spectrum->used_channels); c++) {
+        const sample_t *power = analysis->power;
+        double weighted = 0;
+
+        analysis->power_sum += at_spectrum_power(spectrum->channel[c], analysis->fft_size, analysis->power);
+
+        for (int b = 0; b < analysis->bands; b++) {
+            double sum = 0;
+
+            for (int k = analysis->band_start[b]; k < analysis->band_start[b + 1]; k++)
+                sum += power[k];
+            analysis->band_energy[c][b] += sum;
+        }
+
+        for (int k = 1; k < bins; k++)
+            weighted += (double) k * power[k];
+        analysis->centroid_sum += weighted * analysis->bin_width;
+    }
+
+    analysis->spectra++;
+}
+
+double at_analysis_integrated(const at_analysis_t *analysis) {
+    double mean;
+
+    // relative gate lies 10 LU below loudness of blocks above absolute gate
+    if (histogram_mean(analysis->momentary_hist, 0, &mean) == 0)
+        return -INFINITY;
+
+    histogram_mean(analysis->momentary_hist, gate_bin(loudness(mean) - 10), &mean);
+
+    return loudness(mean);
+}
+
+double at_analysis_range(const at_analysis_t *analysis) {
+    double mean;
+    uint64_t count;
+    int first;
+
+    // relative gate of loudness range lies 20 LU below loudness of short-term blocks
+    if (histogram_mean(analysis->short_term_hist, 0, &mean) == 0)
+        return 0;
+
+    first = gate_bin(loudness(mean) - 20);
+    if ((count = histogram_mean(analysis->short_term_hist, first, &mean)) == 0)
+        return 0;
+
+    return histogram_percentile(analysis->short_term_hist, first, count, 0.95) -
+           histogram_percentile(analysis->short_term_hist, first, count, 0.10);
+}
+
+// level in dB, -inf for silence
+static double decibels(double amplitude) {
+    return amplitude > 0 ? 20 * log10(amplitude) : -INFINITY;
+}
+
+// true peak is never below sample peak, even for rates without oversampling
+static double true_peak(const at_analysis_t *analysis, int c) {
+    return MAX(analysis->true_peak[c], analysis->sample_peak[c]);
+}
+
+// RMS level of octave band of channel in dBFS, from sum of powers of its bins in all frames
+static double band_level(const at_analysis_t *analysis, int c, int b) {
+    double scale = (double) analysis->fft_size * analysis->window_energy * analysis->spectra;
+
+    if (scale <= 0 || analysis->band_start[b] == analysis->band_start[b + 1])
+        return NAN;
+
+    return 10 * log10(2 * analysis->band_energy[c][b] / scale);
+}
+
+// power weighted mean frequency of all spectra
+static double centroid(const at_analysis_t *analysis) {
+    return analysis->power_sum > 0 ? analysis->centroid_sum / analysis->power_sum : NAN;
+}
+
+static double band_center(int b) {
+    return 1000 * pow(2, b - 5);
+}
+
+void at_analysis_print(FILE *out, const at_analysis_t *analysis) {
+    double sample_max = 0, true_max = 0;
+
+    for (int c = 0; c < analysis->channels; c++) {
+        sample_max = MAX(sample_max, analysis->sample_peak[c]);
+        true_max = MAX(true_max, true_peak(analysis, c));
+    }
+
+    fprintf(out, "Analysis of output:\n");
+    fprintf(out, "-----------------------------------------------------------------------------\n");
+    fprintf(out, "Integrated loudness:     %8.1f LUFS\n", at_analysis_integrated(analysis));
+    fprintf(out, "Loudness range:          %8.1f LU\n", at_analysis_range(analysis));
+    fprintf(out, "Max. momentary loudness: %8.1f LUFS\n", analysis->momentary_max);
+    fprintf(out, "Max. short-term loudness:%8.1f LUFS\n", analysis->short_term_max);
+    fprintf(out, "Sample peak:             %8.1f dBFS\n", decibels(sample_max));
+    fprintf(out, "True peak:               %8.1f dBTP\n", decibels(true_max));
+    if (analysis->spectra > 0)
+        fprintf(out, "Spectral centroid:       %8.1f Hz\n", centroid(analysis));
+    fprintf(out, "-----------------------------------------------------------------------------\n");
+
+    fprintf(out, "%-12s", "channel");
+    for (int c = 0; c < analysis->channels; c++)
+        fprintf(out, " %7d", c + 1);
+    fprintf(out, "\n%-12s", "peak [dBFS]");
+    for (int c = 0; c < analysis->channels; c++)
+        fprintf(out, " %7.1f", decibels(analysis->sample_peak[c]));
+    fprintf(out, "\n%-12s", "true [dBTP]");
+    for (int c = 0; c < analysis->channels; c++)
+        fprintf(out, " %7.1f", decibels(true_peak(analysis, c)));
+    fprintf(out, "\n");
+
+    for (int b = 0; b < analysis->bands && analysis->spectra > 0; b++) {
+        fprintf(out, "%7.0f Hz  ", band_center(b));
+        // bands narrower than FFT bin have no level
+        for (int c = 0; c < analysis->channels; c++) {
+            if (isnan(band_level(analysis, c, b)))
+                fprintf(out, " %7s", "-");
+            else
+                fprintf(out, " %7.1f", band_level(analysis, c, b));
+        }
+        fprintf(out, "\n");
+    }
+}
+
+// number in JSON, null for infinite and undefined values
+static void json_number(FILE *out, double value) {
+    if (isfinite(value))
+        fprintf(out, "%.3f", value);
+    else
+        fprintf(out, "null");
+}
+
+// string in JSON with quotes and backslashes escaped
+static void json_string(FILE *out, const char *value) {
+    fputc('"', out);
+    for (; value != NULL && *value; value++) {
+        if (*value == '"' || *value == '\\')
+            fputc('\\', out);
+        fputc(*value, out);
+    }
+    fputc('"', out);
+}
+
+void at_analysis_write_json(const char *path, const at_analysis_t *analysis, const char *input) {
+    double sample_max = 0, true_max = 0;
+    FILE *out = fopen(path, "w");
+
+    if (out == NULL) {
+        fprintf(stderr, "Error: Unable to write analysis into '%s'.\n", path);
+        return;
+    }
+
+    for (int c = 0; c < analysis->channels; c++) {
+        sample_max = MAX(sample_max, analysis->sample_peak[c]);
+        true_max = MAX(true_max, true_peak(analysis, c));
+    }
+
+    fprintf(out, "{\n  \"file\": ");
+    json_string(out, input);
+    fprintf(out, ",\n  \"samplerate\": %d,\n", analysis->samplerate);
+    fprintf(out, "  \"channels\": %d,\n", analysis->channels);
+    fprintf(out, "  \"duration\": %.6f,\n", (double) analysis->frames / analysis->samplerate);
+
+    fprintf(out, "  \"loudness\": {\"integrated\": ");
+    json_number(out, at_analysis_integrated(analysis));
+    fprintf(out, ", \"range\": ");
+    json_number(out, at_analysis_range(analysis));
+    fprintf(out, ", \"momentary_max\": ");
+    json_number(out, analysis->momentary_max);
+    fprintf(out, ", \"short_term_max\": ");
+    json_number(out, analysis->short_term_max);
+    fprintf(out, "},\n");
+
+    fprintf(out, "  \"peak\": {\"sample\": ");
+    json_number(out, decibels(sample_max));
+    fprintf(out, ", \"true\": ");
+    json_number(out, decibels(true_max));
+    fprintf(out, ", \"channels\": [");
+    for (int c = 0; c < analysis->channels; c++) {
+        fprintf(out, "%s\n    {\"sample\": ", c > 0 ? "," : "");
+        json_number(out, decibels(analysis->sample_peak[c]));
+        fprintf(out, ", \"true\": ");
+        json_number(out, decibels(true_peak(analysis, c)));
+        fprintf(out, "}");
+    }
+    fprintf(out, "\n  ]},\n");
+
+    fprintf(out, "  \"spectrum\": {\"centroid\": ");
+    json_number(out, centroid(analysis));
+    fprintf(out, ", \"bands\": [");
+    for (int b = 0; b < analysis->bands && analysis->spectra > 0; b++) {
+        fprintf(out, "%s\n    {\"center\": %.1f, \"low\": %.1f, \"high\": %.1f, \"levels\": [", b > 0 ? "," : "",
+                band_center(b), analysis->band_start[b] * analysis->bin_width,
+                analysis->band_start[b + 1] * analysis->bin_width);
+        for (int c = 0; c < analysis->channels; c++) {
+            fprintf(out, "%s", c > 0 ? ", " : "");
+            json_number(out, band_level(analysis, c, b));
+        }
+        fprintf(out, "]}");
+    }
+    fprintf(out, "\n  ]}\n}\n");
+
+    fclose(out);
+}
+
+void at_analysis_free(at_analysis_t *analysis) {
+    free(analysis->momentary_hist);
+    free(analysis->short_term_hist);
+    free(analysis->scratch);
+    free(analysis->power);
+}
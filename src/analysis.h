@@ -0,0 +1,120 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ANALYSIS_H_
+#define ANALYSIS_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "common.h"
+#include "dsp.h"
+#include "filter.h"
+
+/* Streaming analysis of processed output in a single pass. Loudness follows EBU R128
+ * (ITU-R BS.1770-4, EBU Tech 3341 and 3342): channels are K-weighted and their mean squares
+ * are summed with weights of their positions over 100 ms blocks. Momentary loudness is taken
+ * over 4 blocks, short-term over 30 blocks; gated integrated loudness and loudness range are
+ * computed from histograms of momentary and short-term loudness with 0.01 LU bins, so memory
+ * does not grow with length of input. True peak is the maximum of input oversampled by
+ * polyphase interpolator, whose phases are symmetric pairs, so that each pair costs a single
+ * phase; short blocks, which cannot exceed current true peak by bound of the interpolator
+ * gain, are not oversampled. Levels of octave bands and spectral centroid are
+ * accumulated from spectra of frames, which are computed by processing anyway.
+ */
+
+#define ANALYSIS_BANDS    10                    // octave bands, centers from 31.5 Hz to 16 kHz
+#define LOUDNESS_MIN      (-70.0)               // absolute gate and lower end of histograms in LUFS
+#define LOUDNESS_MAX      30.0                  // upper end of histograms in LUFS
+#define LOUDNESS_BINS     10000                 // bins of histograms, 0.01 LU each
+#define SHORT_TERM_BLOCKS 30                    // 100 ms blocks of short-term loudness
+#define MOMENTARY_BLOCKS  4                     // 100 ms blocks of momentary loudness
+#define TRUE_PEAK_TAPS    12                    // taps of each phase of true peak interpolator
+#define TRUE_PEAK_PHASES  4                     // max. oversampling of true peak
+#define TRUE_PEAK_BLOCK   32                    // samples interpolated at once, at least TRUE_PEAK_TAPS - 1
+#define ANALYSIS_CHUNK    256                   // samples of each channel analysed at once
+
+typedef struct at_analysis_t {
+    int channels;
+    int samplerate;                     // sample rate of analysed output
+    uint64_t frames;                    // count of analysed output frames
+
+    // loudness
+    double weight[MAX_CHANNELS];        // weight of each channel given by its position
+    at_iir_cascade_t k_filter[MAX_CHANNELS];
+    size_t block_size;                  // samples of a 100 ms block
+    size_t block_fill;                  // samples of current block analysed so far
+    double block_sum[MAX_CHANNELS];     // sum of squares of K-weighted samples of current block
+    double energy[SHORT_TERM_BLOCKS];   // weighted mean squares of last blocks, ring indexed by 'blocks'
+    uint64_t blocks;                    // count of complete blocks
+    double momentary_max;               // max. momentary loudness in LUFS, -inf if none
+    double short_term_max;              // max. short-term loudness in LUFS, -inf if none
+    uint32_t *momentary_hist;           // histogram of momentary loudness, gating blocks of integrated loudness
+    uint32_t *short_term_hist;          // histogram of short-term loudness, input of loudness range
+
+    // peaks
+    double sample_peak[MAX_CHANNELS];
+    double true_peak[MAX_CHANNELS];
+    int phases;                         // oversampling of true peak, 1 for rates of 192 kHz and more
+    double tp_gain;                     // max. sum of absolute coefficients of a phase
+    sample_t tp_half[TRUE_PEAK_TAPS / 2];   // first half of symmetric phase half a sample past
+    sample_t tp_even[TRUE_PEAK_TAPS / 2];   // symmetric part of phase a quarter of sample past
+    sample_t tp_odd[TRUE_PEAK_TAPS / 2];    // antisymmetric part of it, mirrored phase has opposite one
+    sample_t tp_history[MAX_CHANNELS][TRUE_PEAK_TAPS - 1];      // last input samples of each channel
+    sample_t *scratch;                  // history followed by a chunk of input, or K-weighted chunk
+
+    // spectrum
+    int fft_size;
+    double bin_width;                   // width of FFT bin in Hz
+    int bands;                          // count of octave bands below Nyquist frequency
+    int band_start[ANALYSIS_BANDS + 1]; // first bin of each band, the last item ends the last band
+    double window_energy;               // sum of squares of frame window
+    uint64_t spectra;                   // count of analysed frames
+    double band_energy[MAX_CHANNELS][ANALYSIS_BANDS];   // sum of powers of bins of each band
+    double centroid_sum;                // sum of powers multiplied by frequency
+    double power_sum;                   // sum of powers of all bins
+    sample_t *power;                    // power spectrum of a channel
+} at_analysis_t;
+
+/* Prepare analysis of 'channels' channels placed by 'layout' (positions of channels, see
+ * at_mix_layout(); NULL weights all channels equally) at 'samplerate'. Spectra are computed
+ * by FFT of 'fft_size' from frames weighted by 'window' of 'window_size' samples; frequency
+ * of their bins is given by 'spectrum_rate'. */
+void at_analysis_init(at_analysis_t *analysis, int channels, const int *layout, int samplerate, int fft_size,
+                      int spectrum_rate, const sample_t *window, size_t window_size);
+
+/* analyse next 'frames' output samples of each channel */
+void at_analysis_samples(at_analysis_t *analysis, sample_t *const *channel, size_t frames);
+
+/* analyse spectra of all channels of a frame */
+void at_analysis_spectrum(at_analysis_t *analysis, const audio_container_t *spectrum);
+
+/* gated integrated loudness in LUFS, -inf if all blocks are below absolute gate */
+double at_analysis_integrated(const at_analysis_t *analysis);
+
+/* loudness range in LU, 0 if there are no short-term blocks above absolute gate */
+double at_analysis_range(const at_analysis_t *analysis);
+
+/* print human readable report */
+void at_analysis_print(FILE *out, const at_analysis_t *analysis);
+
+/* write report in JSON format into given file; 'input' is name of analysed file */
+void at_analysis_write_json(const char *path, const at_analysis_t *analysis, const char *input);
+
+void at_analysis_free(at_analysis_t *analysis);
+
+#endif /* ANALYSIS_H_ */
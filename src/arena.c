@@ -0,0 +1,64 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "arena.h"
+#include "common.h"
+
+#define ARENA_ROUND(x)      (((x) + ARENA_ALIGNMENT - 1) & ~((size_t) ARENA_ALIGNMENT - 1))
+
+void at_arena_init_measure(at_arena_t *arena) {
+    memset(arena, 0, sizeof(*arena));
+}
+
+void at_arena_init(at_arena_t *arena, size_t size) {
+    memset(arena, 0, sizeof(*arena));
+
+    arena->size = ARENA_ROUND(MAX(size, 1));
+    arena->base = at_malloc_aligned(ARENA_ALIGNMENT, arena->size);
+    memset(arena->base, 0, arena->size);
+}
+
+void *at_arena_alloc(at_arena_t *arena, size_t size) {
+    size_t offset = arena->used;
+
+    arena->used += ARENA_ROUND(size);
+
+    // measuring only
+    if (arena->base == NULL)
+        return NULL;
+
+    if (arena->used > arena->size) {
+        fprintf(stderr, "Error: Memory arena exhausted (%zu of %zu bytes).\n", arena->used, arena->size);
+        exit(1);
+    }
+
+    return arena->base + offset;
+}
+
+void at_arena_reset(at_arena_t *arena) {
+    arena->used = 0;
+
+    if (arena->base != NULL)
+        memset(arena->base, 0, arena->size);
+}
+
+void at_arena_free(at_arena_t *arena) {
+    free(arena->base);
+    memset(arena, 0, sizeof(*arena));
+}
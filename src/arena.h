@@ -0,0 +1,51 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <stddef.h>
+
+#define ARENA_ALIGNMENT   64                    // alignment of each block (cache line, AVX-512)
+
+/* Arena is a single aligned memory block from which all buffers of a processing session
+ * are carved. Arena without memory only measures: at_arena_alloc() returns NULL and
+ * accumulates required size, so the same layout code can be run first to measure
+ * and then to allocate.
+ */
+typedef struct at_arena_t {
+    char *base;         // memory block, NULL for measuring arena
+    size_t size;        // size of memory block
+    size_t used;        // bytes already handed out
+} at_arena_t;
+
+/* initialize arena only measuring required size */
+void at_arena_init_measure(at_arena_t *arena);
+
+/* allocate memory block of given size for arena */
+void at_arena_init(at_arena_t *arena, size_t size);
+
+/* get zero initialized block of memory aligned to ARENA_ALIGNMENT */
+void *at_arena_alloc(at_arena_t *arena, size_t size);
+
+/* hand out memory of arena again from its beginning, memory is zeroed */
+void at_arena_reset(at_arena_t *arena);
+
+/* release whole arena */
+void at_arena_free(at_arena_t *arena);
+
+#endif /* ARENA_H_ */
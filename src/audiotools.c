@@ -18,40 +18,123 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <getopt.h>
 #include <ctype.h>
+#include <unistd.h>
 
 #include "audiotools.h"
+#include "wisdom.h"
+#include "pool.h"
+#include "ring.h"
+#include "pa_play.h"
+#include "batch.h"
+#include "writer.h"
+#include "vocoder.h"
 #include "config.h"
 
 /* Print usage */
 static void help(const char *argv0);
 
+/* Batch processing of more files */
+static int at_batch_main(int count, const char **args, bool verbose);
+
+static const char **add_file(const char **files, size_t *count, size_t *capacity, const char *file);
+
 /* Print status info */
 void at_print_status_info(SF_INFO sfinfo);
 
 /* Basic information about runtime variables */
 static AT_INFO info;
 
-/* Main function */
-int main(int argc, char **argv) {
+/* Settings of a session processed by calling thread, getters fall back to 'info' without it */
+static __thread AT_INFO *bound_info = NULL;
+
+static AT_INFO *current(void) {
+    return bound_info != NULL ? bound_info : &info;
+}
+
+AT_INFO *at_bind_settings(AT_INFO *settings) {
+    AT_INFO *previous = bound_info;
+
+    bound_info = settings;
+
+    return previous;
+}
+
+/* Default settings, also used by kernel benchmark */
+void at_init_defaults(void) {
+    at_default_settings(&info);
+}
+
+void at_default_settings(AT_INFO *info) {
+    memset(info, 0, sizeof(*info));
+    info->overlap = -1;
+    info->volume = 1.0;
+    info->tempo = 1.0;
+    info->window = AT_WINDOW_HAMMING;
+    info->kaiser_beta = KAISER_BETA;
+    info->plan_effort = AT_PLAN_MEASURE;
+    info->wisdom_file = at_wisdom_default_path();
+    info->threads = 1;
+    info->lfe_cutoff = CUTOFF_FREQ;
+    info->lfe_slope = LFE_SLOPE;
+    info->lfe_decimation = 1;
+    info->pipeline_depth = PIPELINE_DEPTH;
+    info->pulse_latency = PULSE_LATENCY;
+    info->segments = 1;
+    info->mmap_input = true;
+    info->resample_quality = AT_RESAMPLE_MEDIUM;
+}
+
+/* Command line tool */
+int at_main(int argc, char **argv) {
     /* command line rules */
     enum audiotools_args_t {
         ARG_OUT_CHANNELS,
         ARG_LFE,
+        ARG_MIX_MATRIX,
         ARG_FRAME_DURATION,
         ARG_OVERLAP,
         ARG_VERBOSITY,
         ARG_VOLUME,
-        ARG_PLAYBACK_SPEED
+        ARG_PLAYBACK_SPEED,
+        ARG_TEMPO,
+        ARG_CONVOLVE,
+        ARG_WINDOW,
+        ARG_KAISER_BETA,
+        ARG_SPECTRAL_PASSTHROUGH,
+        ARG_PLAN_EFFORT,
+        ARG_WISDOM,
+        ARG_NO_WISDOM,
+        ARG_THREADS,
+        ARG_LFE_CUTOFF,
+        ARG_LFE_SLOPE,
+        ARG_LFE_DECIMATION,
+        ARG_PIPELINE_DEPTH,
+        ARG_PA_LATENCY,
+        ARG_PA_MINREQ,
+        ARG_PA_SIMPLE,
+        ARG_STATS,
+        ARG_STATS_JSON,
+        ARG_ANALYZE,
+        ARG_ANALYSIS_JSON,
+        ARG_JOBS,
+        ARG_SEGMENTS,
+        ARG_NO_MMAP,
+        ARG_SAMPLE_FORMAT,
+        ARG_DITHER,
+        ARG_RESAMPLE,
+        ARG_RESAMPLE_QUALITY
     };
 
     // verbose output
     static bool verbose = false;
 
-    memset(&info, 0, sizeof(info));
-    info.overlap = -1;
-    info.volume = 1.0;
+    // batch processing requested by --jobs
+    bool batch = false;
+
+    at_init_defaults();
 
     /* options for getopt library */
     static const struct option long_options[] = {
@@ -61,10 +144,38 @@ int main(int argc, char **argv) {
             {"output",         required_argument, NULL, 'o'},
             {"channels",       required_argument, NULL, ARG_OUT_CHANNELS},
             {"lfe-only",       no_argument,       NULL, ARG_LFE},
+            {"mix-matrix",     required_argument, NULL, ARG_MIX_MATRIX},
             {"volume",         required_argument, NULL, ARG_VOLUME},
             {"frame-dur",      required_argument, NULL, ARG_FRAME_DURATION},
             {"overlap",        required_argument, NULL, ARG_OVERLAP},
             {"playback-speed", required_argument, NULL, ARG_PLAYBACK_SPEED},
+            {"tempo",          required_argument, NULL, ARG_TEMPO},
+            {"convolve",       required_argument, NULL, ARG_CONVOLVE},
+            {"window",         required_argument, NULL, ARG_WINDOW},
+            {"kaiser-beta",    required_argument, NULL, ARG_KAISER_BETA},
+            {"spectral-passthrough", no_argument, NULL, ARG_SPECTRAL_PASSTHROUGH},
+            {"plan-effort",    required_argument, NULL, ARG_PLAN_EFFORT},
+            {"wisdom",         required_argument, NULL, ARG_WISDOM},
+            {"no-wisdom",      no_argument,       NULL, ARG_NO_WISDOM},
+            {"threads",        required_argument, NULL, ARG_THREADS},
+            {"lfe-cutoff",     required_argument, NULL, ARG_LFE_CUTOFF},
+            {"lfe-slope",      required_argument, NULL, ARG_LFE_SLOPE},
+            {"lfe-decimate",   required_argument, NULL, ARG_LFE_DECIMATION},
+            {"pipeline-depth", required_argument, NULL, ARG_PIPELINE_DEPTH},
+            {"pa-latency",     required_argument, NULL, ARG_PA_LATENCY},
+            {"pa-minreq",      required_argument, NULL, ARG_PA_MINREQ},
+            {"pa-simple",      no_argument,       NULL, ARG_PA_SIMPLE},
+            {"stats",          no_argument,       NULL, ARG_STATS},
+            {"stats-json",     required_argument, NULL, ARG_STATS_JSON},
+            {"analyze",        no_argument,       NULL, ARG_ANALYZE},
+            {"analysis-json",  required_argument, NULL, ARG_ANALYSIS_JSON},
+            {"jobs",           required_argument, NULL, ARG_JOBS},
+            {"segments",       required_argument, NULL, ARG_SEGMENTS},
+            {"no-mmap",        no_argument,       NULL, ARG_NO_MMAP},
+            {"sample-format",  required_argument, NULL, ARG_SAMPLE_FORMAT},
+            {"dither",         no_argument,       NULL, ARG_DITHER},
+            {"resample",       required_argument, NULL, ARG_RESAMPLE},
+            {"resample-quality", required_argument, NULL, ARG_RESAMPLE_QUALITY},
             {NULL,             no_argument,       NULL, 0}
     };
 
@@ -94,6 +205,9 @@ int main(int argc, char **argv) {
             case ARG_LFE: // optional, LFE frequency output only
                 info.lfe_only = true;
                 break;
+            case ARG_MIX_MATRIX:    // matrix mixing input channels into output ones
+                info.mix_matrix = optarg;
+                break;
             case ARG_FRAME_DURATION:  // optional, specifies frame duration in milliseconds //
                 info.frame_duration = atoi(optarg);
                 break;
@@ -109,19 +223,213 @@ int main(int argc, char **argv) {
             case ARG_PLAYBACK_SPEED:    // playback speed setting, range <0.5 - 1.5>
                 info.playback_speed = atof(optarg);
                 break;
+            case ARG_TEMPO:     // tempo change keeping pitch, range <0.5 - 2.0>
+                info.tempo = atof(optarg);
+                break;
+            case ARG_CONVOLVE:  // FIR filter or impulse response applied to output channels
+                info.impulse_response = optarg;
+                break;
+            case ARG_WINDOW:    // window function applied to each frame
+                if (at_window_parse(optarg, &info.window) < 0) {
+                    fprintf(stderr, "Error: Unknown window function '%s'.\n", optarg);
+                    exit(1);
+                }
+                break;
+            case ARG_KAISER_BETA:   // shape parameter of Kaiser window
+                info.kaiser_beta = atof(optarg);
+                break;
+            case ARG_SPECTRAL_PASSTHROUGH:  // run FFT/IFFT even if spectrum is not modified
+                info.spectral_passthrough = true;
+                break;
+            case ARG_PLAN_EFFORT:   // effort of FFTW planner
+                if (at_plan_effort_parse(optarg, &info.plan_effort) < 0) {
+                    fprintf(stderr, "Error: Unknown planner effort '%s'.\n", optarg);
+                    exit(1);
+                }
+                break;
+            case ARG_WISDOM:    // location of FFTW wisdom cache
+                info.wisdom_file = optarg;
+                break;
+            case ARG_NO_WISDOM: // disable FFTW wisdom cache
+                info.wisdom_file = NULL;
+                break;
+            case ARG_THREADS:   // size of worker pool, 0 means count of CPUs
+                info.threads = atoi(optarg);
+                break;
+            case ARG_LFE_CUTOFF:    // cutoff frequency of LFE filter in Hz
+                info.lfe_cutoff = atof(optarg);
+                break;
+            case ARG_LFE_SLOPE:     // slope of LFE filter in dB/oct
+                info.lfe_slope = atoi(optarg);
+                break;
+            case ARG_LFE_DECIMATION:    // LFE filter runs at samplerate divided by this factor
+                info.lfe_decimation = atoi(optarg);
+                break;
+            case ARG_PIPELINE_DEPTH:    // count of frames buffered between reader, processor and writer
+                info.pipeline_depth = atoi(optarg);
+                break;
+            case ARG_PA_LATENCY:    // target latency of playback (tlength) in ms
+                info.pulse_latency = atoi(optarg);
+                break;
+            case ARG_PA_MINREQ:     // minimal request of playback stream in ms
+                info.pulse_minreq = atoi(optarg);
+                break;
+            case ARG_PA_SIMPLE:     // blocking PA Simple API instead of asynchronous stream
+                info.pulse_simple = true;
+                break;
+            case ARG_STATS:         // timing of processing stages
+                info.stats = true;
+                break;
+            case ARG_STATS_JSON:    // timing of processing stages written into JSON file
+                info.stats = true;
+                info.stats_json = optarg;
+                break;
+            case ARG_ANALYZE:       // loudness, peaks and spectrum of output
+                info.analyze = true;
+                break;
+            case ARG_ANALYSIS_JSON: // analysis of output written into JSON file
+                info.analyze = true;
+                info.analysis_json = optarg;
+                break;
+            case ARG_JOBS:          // count of worker processes of batch processing, 0 means count of CPUs
+                info.jobs = atoi(optarg);
+                batch = true;
+                break;
+            case ARG_SEGMENTS:      // count of threads processing segments of a single file
+                info.segments = atoi(optarg);
+                break;
+            case ARG_NO_MMAP:       // read PCM input by libsndfile instead of mapping it
+                info.mmap_input = false;
+                break;
+            case ARG_SAMPLE_FORMAT: // sample format of output file
+                if (at_writer_parse(optarg, &info.sample_format) < 0) {
+                    fprintf(stderr, "Error: Unknown sample format '%s'.\n", optarg);
+                    exit(1);
+                }
+                break;
+            case ARG_DITHER:        // TPDF dither of integer output
+                info.dither = true;
+                break;
+            case ARG_RESAMPLE:      // sample rate of output, 'native' for rate of PA sink
+                info.resample_rate = strcasecmp(optarg, "native") == 0 ? RESAMPLE_NATIVE : atoi(optarg);
+                break;
+            case ARG_RESAMPLE_QUALITY:  // filter preset of resampler
+                if (at_resample_quality_parse(optarg, &info.resample_quality) < 0) {
+                    fprintf(stderr, "Error: Unknown resampler quality '%s'.\n", optarg);
+                    exit(1);
+                }
+                break;
             default:
                 break;
         }
     }
 
-    // update input file name info
-    info.in_file = argv[optind++];
-    if (info.in_file == NULL) {
+    // more input files, list of files on stdin ('-') or --jobs switch select batch processing
+    if (optind >= argc) {
         puts("Please specify an input file to process.");
         exit(1);
     }
 
-    // process files
+    if (batch || argc - optind > 1 || strcmp(argv[optind], "-") == 0)
+        return at_batch_main(argc - optind, (const char **) argv + optind, verbose);
+
+    // process file
+    SF_INFO sfinfo;
+
+    if (at_process_file(argv[optind], info.out_file, verbose, &sfinfo) < 0)
+        exit(1);
+
+    // plans and buffers are released after the last file
+    at_audio_session_free();
+
+    return EXIT_SUCCESS;
+}
+
+// process files given on command line or listed on stdin by pool of worker processes
+static int at_batch_main(int count, const char **args, bool verbose) {
+    const char **files = NULL;
+    size_t file_count = 0, capacity = 0;
+
+    for (int i = 0; i < count; i++) {
+        char *line = NULL;
+        size_t line_size = 0;
+        ssize_t len;
+
+        if (strcmp(args[i], "-") != 0) {
+            files = add_file(files, &file_count, &capacity, args[i]);
+            continue;
+        }
+
+        // one file name per line
+        while ((len = getline(&line, &line_size, stdin)) > 0) {
+            while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+                line[--len] = '\0';
+            if (len > 0)
+                files = add_file(files, &file_count, &capacity, strdup(line));
+        }
+        free(line);
+    }
+
+    if (file_count == 0) {
+        puts("Please specify an input file to process.");
+        exit(1);
+    }
+
+    if (info.out_file == NULL) {
+        puts("Please specify an output directory (-o) for batch processing.");
+        exit(1);
+    }
+
+    // check for count of worker processes
+    if (info.jobs == 0)
+        info.jobs = (int) MAX(1, sysconf(_SC_NPROCESSORS_ONLN));
+
+    if (info.jobs < 0 || info.jobs > MAX_JOBS) {
+        puts("Count of jobs is out of range. Setting do defaults (count of CPUs).");
+        info.jobs = (int) MAX(1, sysconf(_SC_NPROCESSORS_ONLN));
+    }
+
+    // statistics of workers would be mixed together
+    if (info.stats) {
+        puts("Timing statistics are not available in batch mode, ignoring --stats.");
+        info.stats = false;
+        info.stats_json = NULL;
+    }
+
+    // every file would need its own report
+    if (info.analyze) {
+        puts("Analysis is not available in batch mode, ignoring --analyze.");
+        info.analyze = false;
+        info.analysis_json = NULL;
+    }
+
+    int failed = at_batch_run(files, (int) file_count, info.out_file, info.jobs, verbose);
+
+    return failed > 0 ? 1 : EXIT_SUCCESS;
+}
+
+// append file name to growing list
+static const char **add_file(const char **files, size_t *count, size_t *capacity, const char *file) {
+    if (*count == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 64;
+        if ((files = realloc(files, sizeof(*files) * *capacity)) == NULL) {
+            fprintf(stderr, "Error: Out of memory.\n");
+            exit(1);
+        }
+    }
+
+    files[(*count)++] = file;
+
+    return files;
+}
+
+int at_process_file(const char *in_file, const char *out_file, bool verbose, SF_INFO *in_info) {
+    // settings derived from input audio are valid only for this file
+    AT_INFO settings = info;
+
+    info.in_file = in_file;
+    info.out_file = out_file;
+
     SNDFILE *infile = NULL, *outfile = NULL;
     SF_INFO sfinfo;
 
@@ -130,9 +438,12 @@ int main(int argc, char **argv) {
     // open input file
     if ((infile = sf_open(info.in_file, SFM_READ, &sfinfo)) == NULL) {
         fprintf(stderr, "Error: Unable to open input file '%s': %s\n", info.in_file, sf_strerror(NULL));
-        exit(1);
+        info = settings;
+        return -1;
     }
 
+    *in_info = sfinfo;
+
     // set output format for audio
     if (info.out_file != NULL && strrchr(info.in_file, '.') != NULL
         && strrchr(info.out_file, '.') != NULL) {
@@ -186,11 +497,29 @@ int main(int argc, char **argv) {
     // set output channels to specified number
     sfinfo.channels = info.out_channels;
 
+    // resampled output file is written at the new rate
+    if (info.out_file && info.resample_rate > 0)
+        sfinfo.samplerate = info.resample_rate;
+
+    // sample format of output requested by --sample-format
+    if (info.out_file && info.sample_format != 0) {
+        sfinfo.format = (sfinfo.format & SF_FORMAT_TYPEMASK) | info.sample_format;
+
+        if (!sf_format_check(&sfinfo)) {
+            fprintf(stderr, "Error: Sample format '%s' is not supported by output file '%s'.\n",
+                    at_writer_name(info.sample_format), info.out_file);
+            sf_close(infile);
+            info = settings;
+            return -1;
+        }
+    }
+
     // open output file, if specified
     if (info.out_file && (outfile = sf_open(info.out_file, SFM_WRITE, &sfinfo)) == NULL) {
         fprintf(stderr, "Error: Unable to open output file '%s': %s\n", info.out_file, sf_strerror(NULL));
         sf_close(infile);
-        exit(1);
+        info = settings;
+        return -1;
     }
 
     // main processing loop
@@ -203,7 +532,9 @@ int main(int argc, char **argv) {
     if (verbose)
         puts("End of processing.");
 
-    return EXIT_SUCCESS;
+    info = settings;
+
+    return 0;
 }
 
 /* Print usage */
@@ -212,13 +543,14 @@ static void help(const char *argv0) {
     printf(
             "\nAudio Tools\n"
                     "--------------------------\n\n"
-                    "Usage: %s [options] file\n\n"
+                    "Usage: %s [options] file\n"
+                    "       %s [options] --jobs N -o outdir file... ('-' reads list of files from stdin)\n\n"
                     "  -h, --help                  Show this help and quit\n"
                     "  -v, --version               Show version and quit\n"
 
                     "      --verbose               Enable verbose operations\n\n"
 
-                    "  -o, --output                Output file name\n\n"
+                    "  -o, --output                Output file name (output directory in batch processing)\n\n"
 
                     "                              If this switch is omitted,\n"
                     "                              processed audio is played via default sound card instead\n\n"
@@ -227,11 +559,32 @@ static void help(const char *argv0) {
 
                     "                              If specified, output audio will be downmixed or upmixed\n"
                     "                              to desired number of channels\n"
-                    "                              Valid values: <1 - 6> channels\n\n"
+                    "                              Valid values: <1 - 12> channels (8 = 7.1, 12 = 7.1.4)\n\n"
 
-                    "      --lfe-only              Create only a LFE channel as a output using cutoff frequency 100 Hz\n"
+                    "      --lfe-only              Create only a LFE channel as a output\n"
                     "                              --channels switch is ignored\n\n"
 
+                    "      --mix-matrix            Mix input channels into output ones by matrix read from\n"
+                    "                              given text file: a row of coefficients of all input channels\n"
+                    "                              for each output channel, '#' starts a comment. Channels are\n"
+                    "                              ordered FL FR C LFE SL SR SSL SSR TFL TFR TBL TBR, positions\n"
+                    "                              missing in a layout are left out:\n"
+                    "                              4 channels are FL FR SL SR, 5 FL FR C SL SR,\n"
+                    "                              6 (5.1) FL FR C LFE SL SR,\n"
+                    "                              8 (7.1) FL FR C LFE SL SR SSL SSR,\n"
+                    "                              12 (7.1.4) FL FR C LFE SL SR SSL SSR TFL TFR TBL TBR.\n"
+                    "                              If output has LFE channel and input has none, whatever\n"
+                    "                              the matrix mixes into LFE is low-pass filtered.\n\n"
+
+                    "      --lfe-cutoff            Cutoff frequency of LFE low-pass filter in Hz,\n"
+                    "                              range <20 - 500>, default 120 Hz\n\n"
+
+                    "      --lfe-slope             Slope of LFE Linkwitz-Riley filter in dB/oct,\n"
+                    "                              12, 24 (default), 36, 48, ... 96\n\n"
+
+                    "      --lfe-decimate          Run LFE filter at sampling frequency divided by given factor,\n"
+                    "                              range <1 - 32>, default 1 (no decimation)\n\n"
+
                     "      --volume                Increase or decrease audio volume.\n"
                     "                              Range <0.0 - 2.0> - where 0.0 means silence\n"
                     "                              and 2.0 means boost of volume 2-times.\n"
@@ -247,6 +600,73 @@ static void help(const char *argv0) {
                     "                              and enables to control playback speed of a recording.\n"
                     "                              Range <0.5 - 1.5>\n\n"
 
+                    "      --tempo                 Change tempo of a recording keeping its pitch (phase vocoder),\n"
+                    "                              range <0.5 - 2.0>, where 2.0 plays it twice as fast.\n"
+                    "                              Overlap of frames is raised to at least 75 %%.\n\n"
+
+                    "      --convolve              Convolve output channels with impulse response or FIR filter\n"
+                    "                              of any length read from given audio file. The file has one\n"
+                    "                              channel or a channel for each output channel and sample rate\n"
+                    "                              of input.\n\n"
+
+                    "      --window                Window function applied to each frame:\n"
+                    "                              hamming (default), hann, sqrt-hann, blackman, kaiser\n\n"
+
+                    "      --kaiser-beta           Shape parameter of Kaiser window, default 8.6\n\n"
+
+                    "      --spectral-passthrough  Transform each frame into frequency domain and back\n"
+                    "                              even if no spectral processing is requested\n\n"
+
+                    "      --plan-effort           Effort of FFTW planner: estimate, measure (default), patient\n\n"
+
+                    "      --wisdom                FFTW wisdom cache file,\n"
+                    "                              default $XDG_CACHE_HOME/audiotools/wisdom\n"
+                    "      --no-wisdom             Do not load nor store FFTW wisdom\n\n"
+
+                    "      --threads               Count of worker threads for per-channel FFT,\n"
+                    "                              range <0 - 64>, where '0' means count of CPUs, default 1\n\n"
+
+                    "      --pipeline-depth        Count of blocks buffered between reader, processing and writer\n"
+                    "                              threads, range <0 - 64>, where '0' means processing on a single\n"
+                    "                              thread, default 4\n\n"
+
+                    "      --pa-latency            Target latency of playback (buffer length tlength) in ms,\n"
+                    "                              range <1 - 2000>, default 100 ms\n"
+                    "      --pa-minreq             Minimal request of playback stream in ms, range <0 - latency>,\n"
+                    "                              where '0' means value chosen by server (default)\n"
+                    "      --pa-simple             Play audio by blocking PulseAudio Simple API\n\n"
+
+                    "      --stats                 Print timing of processing stages, frames per second\n"
+                    "                              and real-time factor; DSP load is shown during playback\n"
+                    "      --stats-json            Write timing of processing stages into given JSON file\n\n"
+
+                    "      --analyze               Measure output in a single pass: integrated, short-term and\n"
+                    "                              momentary loudness and loudness range (EBU R128), sample\n"
+                    "                              and true peak, octave band levels and spectral centroid;\n"
+                    "                              without '-o' output is only analysed, not played\n"
+                    "      --analysis-json         Write analysis of output into given JSON file\n\n"
+
+                    "      --segments              Split a single file written into output into segments\n"
+                    "                              processed in parallel by given count of threads,\n"
+                    "                              range <0 - 64>, where '0' means count of CPUs, default 1\n"
+                    "                              (serial processing); output is identical to serial one\n\n"
+
+                    "      --sample-format         Sample format of output file: s16, s24, s32, float;\n"
+                    "                              default is format of input, 16-bit for converted files\n"
+                    "      --dither                Add TPDF dither of 1 LSB to integer output\n\n"
+
+                    "      --resample              Convert output to given sample rate in Hz, range <8000 - 384000>,\n"
+                    "                              or to native rate of PulseAudio sink ('native'); polyphase\n"
+                    "                              filter runs inside the pipeline instead of sound server\n"
+                    "      --resample-quality      Filter of resampler: fast, medium (default), best\n\n"
+
+                    "      --no-mmap               Decode PCM WAV, W64 and AIFF input by libsndfile instead\n"
+                    "                              of converting it straight from memory-mapped file\n\n"
+
+                    "      --jobs                  Process more files by given count of worker processes,\n"
+                    "                              range <0 - 256>, where '0' means count of CPUs (default);\n"
+                    "                              '-o' specifies output directory, files keep their names\n\n"
+
                     "Supported formats for input audio:\n"
                     "----------------------------------\n"
                     "WAV, AIFF, AU, SND, VOC, W64, FLAC, OGG\n\n"
@@ -255,31 +675,40 @@ static void help(const char *argv0) {
                     "-----------------------------------\n"
                     "WAV, FLAC, OGG\n\n"
                     "For detailed information regarding format support see documentation to a library\n"
-                    "libsndfile at < http://www.mega-nerd.com/libsndfile/#Features >\n\n", argv0);
+                    "libsndfile at < http://www.mega-nerd.com/libsndfile/#Features >\n\n", argv0, argv0);
 }
 
 int at_get_out_channels(void) {
-    return info.out_channels;
+    return current()->out_channels;
 }
 
 void at_set_out_channels(int channels) {
-    info.out_channels = channels;
+    current()->out_channels = channels;
 }
 
 bool at_get_lfe_only_setting(void) {
-    return info.lfe_only;
+    return current()->lfe_only;
+}
+
+// get file of matrix mixing input channels into output ones, NULL for default mixing
+const char *at_get_mix_matrix(void) {
+    return current()->mix_matrix;
 }
 
 int at_get_frame_duration(void) {
-    return info.frame_duration;
+    return current()->frame_duration;
 }
 
 int at_get_overlap(void) {
-    return info.overlap;
+    return current()->overlap;
 }
 
 const char *at_get_out_file(void) {
-    return info.out_file;
+    return current()->out_file;
+}
+
+const char *at_get_in_file(void) {
+    return current()->in_file;
 }
 
 void at_print_status_info(SF_INFO sfinfo) {
@@ -295,6 +724,12 @@ void at_print_status_info(SF_INFO sfinfo) {
         printf("Output File: %s\n", info.out_file);
     printf("Playback speed of output audio: %.2f X\n", info.playback_speed);
     printf("Sample rate of output audio: %d Hz\n", (int) floor(sfinfo.samplerate * info.playback_speed));
+    if (info.tempo != 1.0)
+        printf("Tempo of output audio: %.2f X\n", info.tempo);
+    if (info.impulse_response)
+        printf("Impulse response: %s\n", info.impulse_response);
+    if (info.mix_matrix)
+        printf("Mixing matrix: %s\n", info.mix_matrix);
 
     char *ch_out;
     if (info.lfe_only == true)
@@ -307,9 +742,39 @@ void at_print_status_info(SF_INFO sfinfo) {
         ch_out = "downmix";
 
     printf("Output channels: %d (%s)\n", info.out_channels, ch_out);
+    printf("LFE filter: %.1f Hz, %d dB/oct, decimation %d\n", info.lfe_cutoff, info.lfe_slope, info.lfe_decimation);
     printf("Volume: %.3f\n", info.volume);
     printf("Frame Duration: %d ms\n", info.frame_duration);
     printf("Overlap: %d %%\n", info.overlap);
+    printf("Sample precision: %s\n", sizeof(sample_t) == sizeof(float) ? "single (float)" : "double");
+    printf("FFT planner effort: %s\n", at_plan_effort_name(info.plan_effort));
+    printf("Worker threads: %d\n", info.threads);
+    if (info.segments > 1)
+        printf("Segment threads: %d\n", info.segments);
+    if (info.pipeline_depth > 0)
+        printf("Pipeline: reader, processing and writer threads, depth %d\n", info.pipeline_depth);
+    else
+        printf("Pipeline: disabled\n");
+    if (info.out_file == NULL && !info.analyze) {
+        if (info.pulse_simple)
+            printf("Playback: PulseAudio Simple API\n");
+        else
+            printf("Playback: PulseAudio asynchronous, latency %d ms, minreq %d ms\n", info.pulse_latency,
+                   info.pulse_minreq);
+    }
+    if (info.out_file)
+        printf("Dither: %s\n", info.dither ? "TPDF" : "disabled");
+    if (info.analyze)
+        printf("Analysis: loudness, peaks and spectrum of output%s\n", info.out_file ? "" : " (not played)");
+    if (info.resample_rate == RESAMPLE_NATIVE)
+        printf("Resampling: native rate of sink, %s quality\n", at_resample_quality_name(info.resample_quality));
+    else if (info.resample_rate > 0)
+        printf("Resampling: %d Hz, %s quality\n", info.resample_rate, at_resample_quality_name(info.resample_quality));
+    printf("FFTW wisdom: %s\n", info.wisdom_file ? info.wisdom_file : "disabled");
+    if (info.window == AT_WINDOW_KAISER)
+        printf("Window: %s (beta %.2f)\n", at_window_name(info.window), info.kaiser_beta);
+    else
+        printf("Window: %s\n", at_window_name(info.window));
     printf("-----------------------------------------\n");
 }
 
@@ -330,8 +795,8 @@ void at_parse_input_args(AT_INFO *info, SF_INFO *sfinfo, bool verbose) {
     }
 
     // check for output channels parameter
-    if (!(info->out_channels) || info->out_channels > 6) {
-        if (verbose && info->out_channels > 6)
+    if (!(info->out_channels) || info->out_channels > MAX_CHANNELS) {
+        if (verbose && info->out_channels > MAX_CHANNELS)
             puts("Value for output channels is out of range. Setting to same value as input.");
         info->out_channels = sfinfo->channels;
     }
@@ -347,27 +812,242 @@ void at_parse_input_args(AT_INFO *info, SF_INFO *sfinfo, bool verbose) {
         info->volume = 1.0;
     }
 
+    // check for Kaiser window parameter
+    if (info->kaiser_beta < 0) {
+        puts("Kaiser window parameter is out of range. Setting do defaults.");
+        info->kaiser_beta = KAISER_BETA;
+    }
+
+    // check for LFE filter settings
+    if (info->lfe_cutoff < 20 || info->lfe_cutoff > 500) {
+        puts("Cutoff frequency of LFE filter is out of range. Setting do defaults (120 Hz).");
+        info->lfe_cutoff = CUTOFF_FREQ;
+    }
+
+    if (info->lfe_slope < 12 || info->lfe_slope > 96 || info->lfe_slope % 12 != 0) {
+        puts("Slope of LFE filter is not supported. Setting do defaults (24 dB/oct).");
+        info->lfe_slope = LFE_SLOPE;
+    }
+
+    if (info->lfe_decimation < 1 || info->lfe_decimation > MAX_LFE_DECIMATION) {
+        puts("Decimation of LFE filter is out of range. Setting do defaults (no decimation).");
+        info->lfe_decimation = 1;
+    }
+
+    // check for count of threads
+    if (info->threads == 0)
+        info->threads = (int) MAX(1, sysconf(_SC_NPROCESSORS_ONLN));
+
+    if (info->threads < 0 || info->threads > MAX_THREADS) {
+        puts("Count of threads is out of range. Setting do defaults (1 thread).");
+        info->threads = 1;
+    }
+    info->threads = MIN(info->threads, MAX_CHANNELS);
+
+    // check for count of segment threads
+    if (info->segments == 0)
+        info->segments = (int) MAX(1, sysconf(_SC_NPROCESSORS_ONLN));
+
+    if (info->segments < 0 || info->segments > MAX_THREADS) {
+        puts("Count of segment threads is out of range. Setting do defaults (serial processing).");
+        info->segments = 1;
+    }
+
+    // check for depth of pipeline
+    if (info->pipeline_depth < 0 || info->pipeline_depth > MAX_PIPELINE_DEPTH) {
+        puts("Depth of pipeline is out of range. Setting do defaults (4 blocks).");
+        info->pipeline_depth = PIPELINE_DEPTH;
+    }
+
+    // timing counters are not shared by threads
+    if (info->stats && info->segments > 1 && info->out_file != NULL) {
+        puts("Timing statistics are not available with segment-parallel processing, ignoring --stats.");
+        info->stats = false;
+        info->stats_json = NULL;
+    }
+
+#ifndef AT_STATS
+    if (info->stats) {
+        puts("Timing statistics are not available in this build, ignoring --stats.");
+        info->stats = false;
+        info->stats_json = NULL;
+    }
+#endif
+
+    // check for attributes of playback stream
+    if (info->pulse_latency < 1 || info->pulse_latency > 2000) {
+        puts("Playback latency is out of range. Setting do defaults (100 ms).");
+        info->pulse_latency = PULSE_LATENCY;
+    }
+
+    if (info->pulse_minreq < 0 || info->pulse_minreq > info->pulse_latency) {
+        puts("Minimal request of playback stream is out of range. Setting do defaults (chosen by server).");
+        info->pulse_minreq = 0;
+    }
+
     // check for playback speed settings
     if (info->playback_speed > 1.5 || info->playback_speed < 0.5) {
         puts("Playback speed setting is out of range. Setting do defaults.");
         info->playback_speed = 1.0;
     }
 
+    // check for tempo settings; phase vocoder needs frames overlapping at least by TEMPO_MIN_OVERLAP
+    if (info->tempo > 2.0 || info->tempo < 0.5) {
+        puts("Tempo setting is out of range. Setting do defaults (no change of tempo).");
+        info->tempo = 1.0;
+    }
+
+    if (info->tempo != 1.0 && info->overlap < TEMPO_MIN_OVERLAP) {
+        if (verbose)
+            printf("Overlap of frames is too small for change of tempo. Setting to %d %%.\n", TEMPO_MIN_OVERLAP);
+        info->overlap = TEMPO_MIN_OVERLAP;
+    }
+
+    // check for output rate of resampler
+    if (info->resample_rate != 0 && info->resample_rate != RESAMPLE_NATIVE &&
+        (info->resample_rate < 8000 || info->resample_rate > 384000)) {
+        puts("Sample rate of resampler is out of range. Setting do defaults (no resampling).");
+        info->resample_rate = 0;
+    }
+
     // insert empty line
     puts("");
 
 }
 
 void at_set_frame_duration(int duration) {
-    info.frame_duration = duration;
+    current()->frame_duration = duration;
 }
 
 // get audio volume settings
 double at_get_volume(void) {
-    return info.volume;
+    return current()->volume;
 }
 
 // get playback speed setting
 double at_get_playback_speed(void) {
-    return info.playback_speed;
+    return current()->playback_speed;
+}
+
+// get tempo change of phase vocoder
+double at_get_tempo(void) {
+    return current()->tempo;
+}
+
+// get file of impulse response convolved with output
+const char *at_get_impulse_response(void) {
+    return current()->impulse_response;
+}
+
+// get window function setting
+at_window_type_t at_get_window_type(void) {
+    return current()->window;
+}
+
+// get shape parameter of Kaiser window
+double at_get_kaiser_beta(void) {
+    return current()->kaiser_beta;
+}
+
+// get spectral passthrough setting
+bool at_get_spectral_passthrough(void) {
+    return current()->spectral_passthrough;
+}
+
+// get FFTW planner effort
+at_plan_effort_t at_get_plan_effort(void) {
+    return current()->plan_effort;
+}
+
+// get location of FFTW wisdom cache
+const char *at_get_wisdom_file(void) {
+    return current()->wisdom_file;
+}
+
+// get size of worker pool
+int at_get_threads(void) {
+    return current()->threads;
+}
+
+// get cutoff frequency of LFE filter
+double at_get_lfe_cutoff(void) {
+    return current()->lfe_cutoff;
+}
+
+// get slope of LFE filter
+int at_get_lfe_slope(void) {
+    return current()->lfe_slope;
+}
+
+// get decimation factor of LFE filter
+int at_get_lfe_decimation(void) {
+    return current()->lfe_decimation;
+}
+
+// get count of blocks buffered by pipeline, 0 if disabled
+int at_get_pipeline_depth(void) {
+    return current()->pipeline_depth;
+}
+
+// get target latency of playback in ms
+int at_get_pulse_latency(void) {
+    return current()->pulse_latency;
+}
+
+// get minimal request of playback stream in ms, 0 if chosen by server
+int at_get_pulse_minreq(void) {
+    return current()->pulse_minreq;
+}
+
+bool at_get_pulse_simple(void) {
+    return current()->pulse_simple;
+}
+
+bool at_get_stats(void) {
+    return current()->stats;
+}
+
+// get count of threads processing segments of a single file, 1 if processing is serial
+int at_get_segments(void) {
+    return current()->segments;
+}
+
+// get libsndfile sub-format of output requested on command line, 0 if not set
+int at_get_sample_format(void) {
+    return current()->sample_format;
+}
+
+// get TPDF dither setting of integer output
+bool at_get_dither(void) {
+    return current()->dither;
+}
+
+// get setting of zero-copy input of memory-mapped PCM files
+bool at_get_mmap_input(void) {
+    return current()->mmap_input;
+}
+
+// get output sample rate of resampler, 0 if disabled, RESAMPLE_NATIVE for native rate of PA sink
+int at_get_resample_rate(void) {
+    return current()->resample_rate;
+}
+
+// get filter preset of resampler
+at_resample_quality_t at_get_resample_quality(void) {
+    return current()->resample_quality;
+}
+
+// get path of JSON file with timing statistics, NULL if not requested
+const char *at_get_stats_json(void) {
+    return current()->stats_json;
+}
+
+// get analysis setting, output is measured while it is processed
+bool at_get_analyze(void) {
+    return current()->analyze;
+}
+
+// get path of JSON file with analysis of output, NULL if not requested
+const char *at_get_analysis_json(void) {
+    return current()->analysis_json;
 }
@@ -20,16 +20,47 @@
 
 #include "common.h"
 #include "dsp.h"
+#include "window.h"
+#include "resample.h"
+
+#define RESAMPLE_NATIVE   (-1)                  // resampling to native rate of PA sink
 
 typedef struct AT_INFO {
     int out_channels;        // no. of channels for output audio
     bool lfe_only;            // LFE output only
+    const char *mix_matrix;   // text file with matrix mixing input channels into output, NULL for default
     const char *in_file;    // input filename
     const char *out_file;    // output filename
     int frame_duration;    // frame duration
     int overlap;            // overlap
     double volume;            // volume setting
     double playback_speed;  // tempo setting
+    double tempo;           // change of tempo keeping pitch, 1.0 for no change
+    const char *impulse_response;   // audio file with impulse response convolved with output, NULL if disabled
+    at_window_type_t window;    // analysis window
+    double kaiser_beta;     // shape parameter of Kaiser window
+    bool spectral_passthrough;  // keep FFT/IFFT round trip without spectral stages
+    at_plan_effort_t plan_effort;   // FFTW planner effort
+    const char *wisdom_file;    // FFTW wisdom cache, NULL if disabled
+    int threads;            // size of worker pool
+    double lfe_cutoff;      // cutoff frequency of LFE filter
+    int lfe_slope;          // slope of LFE filter in dB/oct
+    int lfe_decimation;     // decimation factor of LFE filter
+    int pipeline_depth;     // slots of rings between pipeline threads, 0 for serial processing
+    int pulse_latency;      // target latency of playback in ms
+    int pulse_minreq;       // minimal request of playback stream in ms, 0 for server default
+    bool pulse_simple;      // use blocking PA Simple API
+    bool stats;             // collect timing of processing stages
+    const char *stats_json; // JSON file with timing statistics, NULL if not requested
+    bool analyze;           // measure loudness, peaks and spectrum of output
+    const char *analysis_json;  // JSON file with analysis of output, NULL if not requested
+    int jobs;               // count of worker processes of batch processing, 0 for count of CPUs
+    int segments;           // count of threads processing segments of a single file, 1 for serial processing
+    bool mmap_input;        // convert PCM input straight from memory-mapped file
+    int sample_format;      // libsndfile sub-format of output, 0 for format chosen by extension
+    bool dither;            // TPDF dither of integer output
+    int resample_rate;      // output sample rate of resampler, 0 if disabled, RESAMPLE_NATIVE for rate of PA sink
+    at_resample_quality_t resample_quality;  // filter preset of resampler
 } AT_INFO;
 
 // getters for AT_INFO
@@ -37,6 +68,8 @@ int at_get_out_channels(void);
 
 bool at_get_lfe_only_setting(void);
 
+const char *at_get_mix_matrix(void);
+
 int at_get_frame_duration(void);
 
 int at_get_overlap(void);
@@ -45,14 +78,83 @@ double at_get_volume(void);
 
 double at_get_playback_speed(void);
 
+double at_get_tempo(void);
+
+const char *at_get_impulse_response(void);
+
+at_window_type_t at_get_window_type(void);
+
+double at_get_kaiser_beta(void);
+
+bool at_get_spectral_passthrough(void);
+
+at_plan_effort_t at_get_plan_effort(void);
+
+const char *at_get_wisdom_file(void);
+
+int at_get_threads(void);
+
+double at_get_lfe_cutoff(void);
+
+int at_get_lfe_slope(void);
+
+int at_get_lfe_decimation(void);
+
+int at_get_pipeline_depth(void);
+
+int at_get_pulse_latency(void);
+
+int at_get_pulse_minreq(void);
+
+bool at_get_pulse_simple(void);
+
+bool at_get_stats(void);
+
+const char *at_get_stats_json(void);
+
+bool at_get_analyze(void);
+
+const char *at_get_analysis_json(void);
+
 const char *at_get_out_file(void);
 
+const char *at_get_in_file(void);
+
+int at_get_segments(void);
+
+bool at_get_mmap_input(void);
+
+int at_get_sample_format(void);
+
+bool at_get_dither(void);
+
+int at_get_resample_rate(void);
+
+at_resample_quality_t at_get_resample_quality(void);
+
 // putters for AT_INFO
 void at_set_out_channels(int channels);
 
 void at_set_frame_duration(int duration);
 
+/* Bind settings of a session to calling thread, getters and putters use them instead of global
+ * settings until previous binding, which is returned, is restored; NULL binds global settings. */
+AT_INFO *at_bind_settings(AT_INFO *settings);
+
 // parse input arguments
 void at_parse_input_args(AT_INFO *info, SF_INFO *sfinfo, bool verbose);
 
+// reset AT_INFO to default settings
+void at_init_defaults(void);
+
+// fill 'info' with default settings
+void at_default_settings(AT_INFO *info);
+
+// command line tool, called from main()
+int at_main(int argc, char **argv);
+
+/* Process single file with current settings, output is played back if 'out_file' is NULL.
+ * Returns -1 if files can not be opened; properties of input audio are stored into 'in_info'. */
+int at_process_file(const char *in_file, const char *out_file, bool verbose, SF_INFO *in_info);
+
 #endif /* AUDIOTOOLS_H_ */
@@ -0,0 +1,410 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "batch.h"
+#include "audiotools.h"
+#include "common.h"
+#include "stats.h"
+
+#ifndef PATH_MAX
+#    define PATH_MAX 4096
+#endif
+
+/* Files are processed by worker processes rather than threads: FFTW plans, settings
+ * and buffers of a processing session are global, and an error while processing
+ * a file ends the process. Parent only waits for workers, marks file of a failed
+ * worker and starts a new worker in its place.
+ */
+
+typedef enum batch_state_t {
+    JOB_PENDING = 0,
+    JOB_RUNNING,
+    JOB_DONE,
+    JOB_FAILED
+} batch_state_t;
+
+// result of a single file
+typedef struct batch_job_t {
+    int state;
+    int samplerate;
+    int64_t frames;
+} batch_job_t;
+
+/* Positions <head, tail) of files dealt to a worker; both ends are packed into one word,
+ * so owner (taking from head) and thieves (taking from tail) move them by a single CAS. */
+typedef struct batch_deque_t {
+    uint64_t range __attribute__((aligned(64)));
+} batch_deque_t;
+
+// memory shared by parent and worker processes
+typedef struct batch_shared_t {
+    batch_deque_t deques[MAX_JOBS];
+    int current[MAX_JOBS];              // file processed by each worker, -1 if none
+    batch_job_t jobs[];
+} batch_shared_t;
+
+typedef struct batch_t {
+    const char **files;
+    int count;
+    const char *out_dir;
+    int jobs;
+    bool verbose;
+    int *order;                         // files in order of dealing to workers
+    batch_shared_t *shared;
+    pid_t pids[MAX_JOBS];
+} batch_t;
+
+// input file with its size used as estimate of its duration
+typedef struct batch_file_t {
+    int index;
+    off_t size;
+    const char *name;                   // name of output file
+} batch_file_t;
+
+#define RANGE(head, tail)   (((uint64_t) (tail) << 32) | (uint32_t) (head))
+#define RANGE_HEAD(range)   ((uint32_t) (range))
+#define RANGE_TAIL(range)   ((uint32_t) ((range) >> 32))
+
+// take position from front (owner) or back (thief) of deque; returns -1 if deque is empty
+static int deque_take(batch_deque_t *deque, bool steal) {
+    uint64_t range = __atomic_load_n(&deque->range, __ATOMIC_SEQ_CST);
+
+    while (RANGE_HEAD(range) < RANGE_TAIL(range)) {
+        uint32_t head = RANGE_HEAD(range), tail = RANGE_TAIL(range);
+        uint64_t next = steal ? RANGE(head, tail - 1) : RANGE(head + 1, tail);
+
+        if (__atomic_compare_exchange_n(&deque->range, &range, next, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+            return (int) (steal ? tail - 1 : head);
+    }
+
+    return -1;
+}
+
+static uint32_t deque_size(batch_deque_t *deque) {
+    uint64_t range = __atomic_load_n(&deque->range, __ATOMIC_SEQ_CST);
+
+    return RANGE_TAIL(range) - RANGE_HEAD(range);
+}
+
+// next file of worker; own files go first, then the worker with most files left is robbed
+static int next_file(batch_t *batch, int worker) {
+    int pos = deque_take(&batch->shared->deques[worker], false);
+
+    while (pos < 0) {
+        int victim = -1;
+        uint32_t most = 0;
+
+        for (int i = 0; i < batch->jobs; i++) {
+            uint32_t size = deque_size(&batch->shared->deques[i]);
+            if (size > most) {
+                most = size;
+                victim = i;
+            }
+        }
+
+        if (victim < 0)
+            return -1;
+
+        pos = deque_take(&batch->shared->deques[victim], true);
+    }
+
+    return batch->order[pos];
+}
+
+static bool work_left(batch_t *batch) {
+    for (int i = 0; i < batch->jobs; i++) {
+        if (deque_size(&batch->shared->deques[i]) > 0)
+            return true;
+    }
+
+    return false;
+}
+
+// output keeps name of input file
+static const char *output_name(const char *file) {
+    const char *name = strrchr(file, '/');
+
+    return name != NULL ? name + 1 : file;
+}
+
+static void output_path(char *path, size_t size, const char *out_dir, const char *file) {
+    snprintf(path, size, "%s/%s", out_dir, output_name(file));
+}
+
+static bool same_file(const char *a, const char *b) {
+    struct stat st_a, st_b;
+
+    return stat(a, &st_a) == 0 && stat(b, &st_b) == 0 && st_a.st_dev == st_b.st_dev && st_a.st_ino == st_b.st_ino;
+}
+
+static void worker_main(batch_t *batch, int worker) {
+    char out_path[PATH_MAX];
+    SF_INFO sfinfo;
+    int file;
+
+    // progress of single files is not shown, workers would overwrite each other
+    int null_fd = open("/dev/null", O_WRONLY);
+    if (null_fd >= 0) {
+        dup2(null_fd, STDOUT_FILENO);
+        close(null_fd);
+    }
+
+    while ((file = next_file(batch, worker)) >= 0) {
+        batch_job_t *job = &batch->shared->jobs[file];
+
+        batch->shared->current[worker] = file;
+        job->state = JOB_RUNNING;
+
+        output_path(out_path, sizeof(out_path), batch->out_dir, batch->files[file]);
+
+        if (same_file(batch->files[file], out_path)) {
+            fprintf(stderr, "Error: Output file '%s' would overwrite its input.\n", out_path);
+            job->state = JOB_FAILED;
+        }
+        else if (at_process_file(batch->files[file], out_path, false, &sfinfo) < 0) {
+            job->state = JOB_FAILED;
+        }
+        else {
+            job->frames = sfinfo.frames;
+            job->samplerate = sfinfo.samplerate;
+            job->state = JOB_DONE;
+        }
+
+        if (batch->verbose)
+            fprintf(stderr, "%s: %s\n", job->state == JOB_DONE ? "Done" : "Failed", batch->files[file]);
+
+        batch->shared->current[worker] = -1;
+    }
+
+    at_audio_session_free();
+    exit(0);
+}
+
+static void spawn_worker(batch_t *batch, int worker) {
+    // buffered output would be written by both processes
+    fflush(stdout);
+    fflush(stderr);
+
+    pid_t pid = fork();
+
+    if (pid < 0) {
+        fprintf(stderr, "Error: Unable to start worker process: %s\n", strerror(errno));
+        exit(1);
+    }
+
+    if (pid == 0)
+        worker_main(batch, worker);
+
+    batch->pids[worker] = pid;
+}
+
+// larger files first, equal ones in order given by user
+static int compare_files(const void *a, const void *b) {
+    const batch_file_t *fa = a, *fb = b;
+
+    if (fa->size != fb->size)
+        return fa->size < fb->size ? 1 : -1;
+
+    return fa->index - fb->index;
+}
+
+// equal names of output in order given by user
+static int compare_names(const void *a, const void *b) {
+    const batch_file_t *fa = a, *fb = b;
+    int order = strcmp(fa->name, fb->name);
+
+    return order != 0 ? order : fa->index - fb->index;
+}
+
+/* Outputs are written into a single directory under names of inputs, so inputs of equal
+ * names from different directories would be written into the same file, possibly by two
+ * workers at once. Only the first of them given by user is processed, others fail.
+ * Returns count of failed files. */
+static int check_names(batch_t *batch) {
+    batch_file_t *sorted = at_malloc(sizeof(*sorted) * batch->count);
+    int failed = 0;
+
+    for (int i = 0; i < batch->count; i++) {
+        sorted[i].index = i;
+        sorted[i].name = output_name(batch->files[i]);
+    }
+
+    qsort(sorted, (size_t) batch->count, sizeof(*sorted), compare_names);
+
+    for (int i = 1, first = 0; i < batch->count; i++) {
+        if (strcmp(sorted[i].name, sorted[first].name) != 0) {
+            first = i;
+            continue;
+        }
+
+        fprintf(stderr, "Error: Output of '%s' would overwrite output of '%s' in '%s'.\n",
+                batch->files[sorted[i].index], batch->files[sorted[first].index], batch->out_dir);
+        batch->shared->jobs[sorted[i].index].state = JOB_FAILED;
+        failed++;
+    }
+
+    free(sorted);
+
+    return failed;
+}
+
+/* Files are sorted from the largest one and dealt round-robin, so every worker starts
+ * with long files and keeps short ones at the back of its deque for thieves. Failed
+ * files are not dealt. */
+static void deal_files(batch_t *batch) {
+    batch_file_t *sorted = at_malloc(sizeof(*sorted) * batch->count);
+    struct stat st;
+    int pos = 0, count = 0;
+
+    for (int i = 0; i < batch->count; i++) {
+        if (batch->shared->jobs[i].state == JOB_FAILED)
+            continue;
+
+        sorted[count].index = i;
+        sorted[count++].size = stat(batch->files[i], &st) == 0 ? st.st_size : 0;
+    }
+
+    qsort(sorted, (size_t) count, sizeof(*sorted), compare_files);
+
+    for (int worker = 0; worker < batch->jobs; worker++) {
+        int head = pos;
+
+        for (int i = worker; i < count; i += batch->jobs)
+            batch->order[pos++] = sorted[i].index;
+
+        batch->shared->deques[worker].range = RANGE(head, pos);
+        batch->shared->current[worker] = -1;
+    }
+
+    free(sorted);
+}
+
+int at_batch_run(const char **files, int count, const char *out_dir, int jobs, bool verbose) {
+    batch_t batch;
+
+    memset(&batch, 0, sizeof(batch));
+    batch.files = files;
+    batch.count = count;
+    batch.out_dir = out_dir;
+    batch.jobs = MAX(1, MIN(jobs, count));
+    batch.verbose = verbose;
+
+    if (mkdir(out_dir, 0755) < 0 && errno != EEXIST) {
+        fprintf(stderr, "Error: Unable to create output directory '%s': %s\n", out_dir, strerror(errno));
+        exit(1);
+    }
+
+    // anonymous shared mapping is inherited by forked workers
+    size_t shared_size = sizeof(batch_shared_t) + sizeof(batch_job_t) * count;
+    batch.shared = mmap(NULL, shared_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (batch.shared == MAP_FAILED) {
+        fprintf(stderr, "Error: Unable to map shared memory: %s\n", strerror(errno));
+        exit(1);
+    }
+
+    batch.order = at_malloc(sizeof(*batch.order) * count);
+    int duplicates = check_names(&batch);
+    deal_files(&batch);
+
+    printf("Processing %d files by %d jobs.\n", count - duplicates, batch.jobs);
+
+    uint64_t start = at_stats_now();
+    int alive = 0;
+
+    for (int worker = 0; worker < batch.jobs; worker++, alive++)
+        spawn_worker(&batch, worker);
+
+    while (alive > 0) {
+        int status, worker = -1;
+        pid_t pid = wait(&status);
+
+        if (pid < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        for (int i = 0; i < batch.jobs; i++) {
+            if (batch.pids[i] == pid)
+                worker = i;
+        }
+
+        if (worker < 0)
+            continue;
+
+        alive--;
+
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+            continue;
+
+        // worker ended on an error; its file is failed, incomplete output is removed
+        int file = batch.shared->current[worker];
+        if (file >= 0) {
+            char out_path[PATH_MAX];
+
+            output_path(out_path, sizeof(out_path), out_dir, files[file]);
+            if (!same_file(files[file], out_path))
+                unlink(out_path);
+
+            batch.shared->jobs[file].state = JOB_FAILED;
+            batch.shared->current[worker] = -1;
+            fprintf(stderr, "Error: Processing of '%s' failed.\n", files[file]);
+        }
+
+        if (work_left(&batch)) {
+            spawn_worker(&batch, worker);
+            alive++;
+        }
+    }
+
+    double wall_time = MAX((at_stats_now() - start) / 1e9, 1e-9);
+    double audio_time = 0;
+    int done = 0, failed = 0;
+
+    for (int i = 0; i < count; i++) {
+        batch_job_t *job = &batch.shared->jobs[i];
+
+        if (job->state == JOB_DONE) {
+            done++;
+            if (job->samplerate > 0)
+                audio_time += (double) job->frames / job->samplerate;
+        }
+        else {
+            failed++;
+        }
+    }
+
+    printf("Processed %d of %d files (%d failed) in %.3f s\n", done, count, failed, wall_time);
+    printf("Throughput: %.2f files/s, %.4f audio-hours/s (%.1fx real time)\n", done / wall_time,
+           audio_time / 3600 / wall_time, audio_time / wall_time);
+
+    munmap(batch.shared, shared_size);
+    free(batch.order);
+
+    return failed;
+}
@@ -0,0 +1,34 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BATCH_H_
+#define BATCH_H_
+
+#include <stdbool.h>
+
+#define MAX_JOBS          256                   // maximum count of worker processes of batch processing
+
+/* Process 'count' input files by 'jobs' worker processes; each output is written into
+ * directory 'out_dir' under the name of its input file. Files are ordered from the largest
+ * one and dealt to per-worker deques; a worker takes its own files from the front and,
+ * when it runs out of them, steals the smallest remaining files of the most loaded worker.
+ * A worker keeps its FFT plans, window tables and buffers over all processed files.
+ * Throughput is reported at the end. Returns count of failed files.
+ */
+int at_batch_run(const char **files, int count, const char *out_dir, int jobs, bool verbose);
+
+#endif /* BATCH_H_ */
@@ -0,0 +1,1110 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Microbenchmark of processing kernels. Each kernel runs over synthetic signals
+ * across frame sizes, channel counts and FFT sizes; the fastest of several runs
+ * is reported as ns per sample and GB/s of touched memory. Results can be saved
+ * and compared against a saved baseline, regressions are reported by exit code.
+ * With --errors, kernels are not timed; their output is compared with a reference
+ * computed in double precision from the same input instead.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <complex.h>
+#include <float.h>
+#include <getopt.h>
+
+#include "audiotools.h"
+#include "common.h"
+#include "dsp.h"
+#include "fft.h"
+#include "spectrum.h"
+#include "stats.h"
+#include "window.h"
+#include "writer.h"
+#include "resample.h"
+#include "vocoder.h"
+#include "convolve.h"
+#include "mix.h"
+#include "analysis.h"
+#include "filter.h"
+
+#define BENCH_RUNS        5                     // count of measured runs, the fastest one is reported
+#define BENCH_MIN_TIME    20                    // default minimal duration of a run in ms
+#define BENCH_THRESHOLD   10.0                  // default tolerated slowdown against baseline in percents
+#define BENCH_RATE        48000                 // sampling frequency of synthetic signals
+#define MAX_RESULTS       512
+
+typedef struct bench_result_t {
+    char name[64];
+    double ns_per_sample;
+} bench_result_t;
+
+// data shared by benchmarked kernels
+typedef struct bench_ctx_t {
+    audio_container_t *td;              // channels in time domain
+    audio_container_t *fd;              // spectra
+    sample_t *multi;                    // interleaved frames
+    sample_t *source;                   // pristine copy of time domain channels
+    sample_t *out;                      // output of spectral kernels
+    sample_t *gain;                     // unit complex gains, so that repeated calls keep magnitudes
+    sample_t *sign;                     // real gains of +1 and -1
+    sample_t *lfe_tail;
+    at_lfe_t lfe;
+    at_mix_t mix;
+    at_fft_batch_t *batch;
+    at_writer_t writer;                 // conversion of channels into output format
+    at_resampler_t resampler;
+    sample_t *resampled[MAX_CHANNELS];  // output of resampler
+    at_vocoder_t vocoder;
+    at_convolver_t convolver;
+    at_analysis_t analysis;
+    int channels;
+    size_t length;
+    int fft_size;
+} bench_ctx_t;
+
+typedef void (*bench_func_t)(bench_ctx_t *ctx);
+
+static bench_result_t results[MAX_RESULTS];
+static int result_count = 0;
+
+static bench_result_t baseline[MAX_RESULTS];
+static int baseline_count = 0;
+
+static const char *filter = NULL;
+static double min_time = BENCH_MIN_TIME * 1e6;
+static double threshold = BENCH_THRESHOLD;
+static int regressions = 0;
+static int inaccurate = 0;
+
+// counts of channels of stereo, 5.1 and 7.1.4 output
+static const int layouts[] = {2, 6, 12};
+
+/* kernels */
+
+// input is restored before windowing, otherwise repeated calls decay it into denormals
+static void run_window(bench_ctx_t *ctx) {
+    for (int ch = 0; ch < MAX_CHANNELS; ch++)
+        memcpy(ctx->td->channel[ch], ctx->source + ch * FFT_MAX, sizeof(sample_t) * ctx->length);
+    apply_window(ctx->td, ctx->length);
+}
+
+static void run_separate(bench_ctx_t *ctx) {
+    at_separate_channels(ctx->multi, ctx->td, ctx->channels);
+}
+
+static void run_combine(bench_ctx_t *ctx) {
+    at_combine_channels(ctx->multi, ctx->td, ctx->channels);
+}
+
+static void run_convert(bench_ctx_t *ctx) {
+    at_writer_convert(&ctx->writer, ctx->multi, ctx->td->channel, ctx->length);
+}
+
+static void run_mix(bench_ctx_t *ctx) {
+    at_mix_process(&ctx->mix, ctx->td);
+}
+
+static void run_lfe(bench_ctx_t *ctx) {
+    at_create_lfe(ctx->td->channel[LFE], &ctx->lfe);
+}
+
+static void run_resample(bench_ctx_t *ctx) {
+    at_resampler_process(&ctx->resampler, ctx->td->channel, ctx->length, ctx->resampled);
+}
+
+static void run_vocoder(bench_ctx_t *ctx) {
+    at_vocoder_process(&ctx->vocoder, ctx->fd, ctx->length);
+}
+
+// input is restored before filtering, output of convolution would grow over repeated calls
+static void run_convolve(bench_ctx_t *ctx) {
+    for (int ch = 0; ch < MAX_CHANNELS; ch++)
+        memcpy(ctx->td->channel[ch], ctx->source + ch * FFT_MAX, sizeof(sample_t) * ctx->length);
+    at_convolver_process(&ctx->convolver, ctx->td->channel);
+}
+
+// loudness and peaks of stationary signal, true peak is oversampled only until it settles
+static void run_meter(bench_ctx_t *ctx) {
+    at_analysis_samples(&ctx->analysis, ctx->td->channel, ctx->length);
+}
+
+// true peak is cleared before each call, so every chunk is oversampled
+static void run_meter_true_peak(bench_ctx_t *ctx) {
+    memset(ctx->analysis.true_peak, 0, sizeof(ctx->analysis.true_peak));
+    at_analysis_samples(&ctx->analysis, ctx->td->channel, ctx->length);
+}
+
+static void run_analysis_spectrum(bench_ctx_t *ctx) {
+    at_analysis_spectrum(&ctx->analysis, ctx->fd);
+}
+
+static void run_magnitude(bench_ctx_t *ctx) {
+    at_spectrum_magnitude(ctx->fd->channel[0], ctx->fft_size, ctx->out);
+}
+
+static void run_power(bench_ctx_t *ctx) {
+    at_spectrum_power(ctx->fd->channel[0], ctx->fft_size, ctx->out);
+}
+
+static void run_phase(bench_ctx_t *ctx) {
+    at_spectrum_phase(ctx->fd->channel[0], ctx->fft_size, ctx->out);
+}
+
+static void run_polar(bench_ctx_t *ctx) {
+    at_spectrum_polar(ctx->source, ctx->source + FFT_MAX, ctx->fft_size, ctx->out);
+}
+
+static void run_gain(bench_ctx_t *ctx) {
+    at_spectrum_gain(ctx->sign, ctx->fft_size, ctx->fd->channel[0]);
+}
+
+static void run_complex_gain(bench_ctx_t *ctx) {
+    at_spectrum_complex_gain(ctx->gain, ctx->fft_size, ctx->fd->channel[0]);
+}
+
+/* previous kernels on FFTW halfcomplex spectra (imaginary part of bin 'k' at 'fft_size - k'),
+ * measured for comparison with kernels on split spectra */
+
+static double hc_argument(const double real, const double imag) {
+    if (real > 0)
+        return (atan(imag / real));
+    if ((real < 0) && (imag >= 0))
+        return (atan(imag / real) + M_PI);
+    if ((real < 0) && (imag < 0))
+        return (atan(imag / real) - M_PI);
+    if ((real == 0) && (imag > 0))
+        return (M_PI / 2);
+    if ((real == 0) && (imag < 0))
+        return (-M_PI / 2);
+
+    return 0;
+}
+
+static void run_magnitude_hc(bench_ctx_t *ctx) {
+    const sample_t *freq = ctx->fd->channel[0];
+    int n = ctx->fft_size;
+
+    for (int i = 0; i <= n / 2; i++) {
+        if (i == 0 || i == n / 2)
+            ctx->out[i] = sqrt(freq[i] * freq[i]);
+        else
+            ctx->out[i] = sqrt(freq[i] * freq[i] + freq[n - i] * freq[n - i]);
+    }
+}
+
+static void run_power_hc(bench_ctx_t *ctx) {
+    const sample_t *freq = ctx->fd->channel[0];
+    int n = ctx->fft_size;
+
+    ctx->out[0] = freq[0] * freq[0];
+    for (int k = 1; k < n / 2; k++)
+        ctx->out[k] = freq[k] * freq[k] + freq[n - k] * freq[n - k];
+    ctx->out[n / 2] = freq[n / 2] * freq[n / 2];
+}
+
+static void run_phase_hc(bench_ctx_t *ctx) {
+    const sample_t *freq = ctx->fd->channel[0];
+    int n = ctx->fft_size;
+
+    for (int i = 0; i <= n / 2; i++) {
+        if (i == 0 || i == n / 2)
+            ctx->out[i] = hc_argument(freq[i], 0.0);
+        else
+            ctx->out[i] = hc_argument(freq[i], freq[n - i]);
+    }
+}
+
+static void run_polar_hc(bench_ctx_t *ctx) {
+    const sample_t *magnitude = ctx->source, *phase = ctx->source + FFT_MAX;
+    int n = ctx->fft_size;
+
+    for (int i = 0; i <= n / 2; i++) {
+        if (i == 0 || i == n / 2)
+            ctx->out[i] = magnitude[i];
+        else {
+            ctx->out[i] = magnitude[i] * cos(phase[i]);
+            ctx->out[n - i] = magnitude[i] * sin(phase[i]);
+        }
+    }
+}
+
+static void run_gain_hc(bench_ctx_t *ctx) {
+    sample_t *freq = ctx->fd->channel[0];
+    int n = ctx->fft_size;
+
+    for (int i = 0; i <= n / 2; i++) {
+        if (i == 0 || i == n / 2)
+            freq[i] *= ctx->sign[i];
+        else {
+            freq[i] *= ctx->sign[i];
+            freq[n - i] *= ctx->sign[i];
+        }
+    }
+}
+
+static void run_complex_gain_hc(bench_ctx_t *ctx) {
+    sample_t *freq = ctx->fd->channel[0];
+    const sample_t *gain = ctx->gain;
+    int n = ctx->fft_size;
+
+    freq[0] *= gain[0];
+    for (int i = 1; i < n / 2; i++) {
+        sample_t re = freq[i], im = freq[n - i];
+
+        freq[i] = re * gain[i] - im * gain[n - i];
+        freq[n - i] = re * gain[n - i] + im * gain[i];
+    }
+    freq[n / 2] *= gain[n / 2];
+}
+
+static void run_fft(bench_ctx_t *ctx) {
+    at_compute_fft(ctx->td->channel[0], ctx->length, ctx->fd->channel[0]);
+}
+
+static void run_ifft(bench_ctx_t *ctx) {
+    at_compute_ifft(ctx->fd->channel[0], ctx->length, ctx->td->channel[0]);
+}
+
+static void run_fft_batch(bench_ctx_t *ctx) {
+    at_compute_fft_batch(ctx->batch);
+}
+
+static void run_ifft_batch(bench_ctx_t *ctx) {
+    at_compute_ifft_batch(ctx->batch);
+}
+
+/* measurement */
+
+// deterministic test signal: two tones and white noise
+static void fill_signal(sample_t *data, size_t length, int seed) {
+    unsigned state = 12345u + (unsigned) seed;
+
+    for (size_t i = 0; i < length; i++) {
+        state = state * 1103515245u + 12345u;
+        double noise = ((state >> 8) & 0xffff) / 65536.0 - 0.5;
+        data[i] = (sample_t) (0.4 * sin(2 * M_PI * 440.0 * i / BENCH_RATE + seed) +
+                              0.2 * sin(2 * M_PI * 60.0 * i / BENCH_RATE) + 0.1 * noise);
+    }
+}
+
+static double baseline_lookup(const char *name) {
+    for (int i = 0; i < baseline_count; i++) {
+        if (strcmp(baseline[i].name, name) == 0)
+            return baseline[i].ns_per_sample;
+    }
+
+    return 0;
+}
+
+// kernel is selected by filter of command line
+static bool selected(const char *name) {
+    return filter == NULL || strstr(name, filter) != NULL;
+}
+
+/* Measure kernel; 'samples' is count of samples processed by single call and 'bytes'
+ * amount of memory read and written by it. */
+static void bench(const char *name, bench_func_t func, bench_ctx_t *ctx, size_t samples, size_t bytes) {
+    if (!selected(name))
+        return;
+
+    if (result_count >= MAX_RESULTS) {
+        fprintf(stderr, "Error: Too many benchmark results.\n");
+        exit(1);
+    }
+
+    // calibrate count of iterations, so that a run lasts at least minimal time
+    unsigned long iterations = 1;
+    while (true) {
+        uint64_t start = at_stats_now();
+        for (unsigned long i = 0; i < iterations; i++)
+            func(ctx);
+        if (at_stats_now() - start >= min_time || iterations >= (1ul << 30))
+            break;
+        iterations *= 2;
+    }
+
+    double best = INFINITY;
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        uint64_t start = at_stats_now();
+        for (unsigned long i = 0; i < iterations; i++)
+            func(ctx);
+        double elapsed = (double) (at_stats_now() - start) / iterations;
+        if (elapsed < best)
+            best = elapsed;
+    }
+
+    bench_result_t *result = &results[result_count++];
+    snprintf(result->name, sizeof(result->name), "%s", name);
+    result->ns_per_sample = best / samples;
+
+    printf("%-28s %10.3f ns/sample %9.2f GB/s", name, result->ns_per_sample, bytes / best);
+
+    double base = baseline_lookup(name);
+    if (base > 0) {
+        double change = 100.0 * (result->ns_per_sample - base) / base;
+        printf(" %+8.1f %%", change);
+        if (change > threshold) {
+            printf("  REGRESSION");
+            regressions++;
+        }
+    }
+
+    putchar('\n');
+}
+
+static void load_baseline(const char *path) {
+    FILE *in = fopen(path, "r");
+    char name[64];
+    double value;
+
+    if (in == NULL) {
+        fprintf(stderr, "Error: Unable to open baseline file '%s'.\n", path);
+        exit(1);
+    }
+
+    while (baseline_count < MAX_RESULTS && fscanf(in, "%63s %lf", name, &value) == 2) {
+        snprintf(baseline[baseline_count].name, sizeof(baseline[baseline_count].name), "%s", name);
+        baseline[baseline_count++].ns_per_sample = value;
+    }
+
+    fclose(in);
+}
+
+static void save_results(const char *path) {
+    FILE *out = fopen(path, "w");
+
+    if (out == NULL) {
+        fprintf(stderr, "Error: Unable to write results into '%s'.\n", path);
+        exit(1);
+    }
+
+    for (int i = 0; i < result_count; i++)
+        fprintf(out, "%s %.6f\n", results[i].name, results[i].ns_per_sample);
+
+    fclose(out);
+}
+
+/* benchmark suites */
+
+static void bench_time_domain(bench_ctx_t *ctx) {
+    static const size_t lengths[] = {256, 512, WINDOW_MAX};
+    char name[64];
+
+    for (int l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+        size_t n = lengths[l];
+        ctx->td->length = n;
+        ctx->length = n;
+
+        snprintf(name, sizeof(name), "window/n=%zu", n);
+        bench(name, run_window, ctx, n * MAX_CHANNELS, 4 * sizeof(sample_t) * n * MAX_CHANNELS);
+
+        for (int ch = 1; ch <= MAX_CHANNELS; ch++) {
+            ctx->channels = ch;
+
+            snprintf(name, sizeof(name), "separate/ch=%d/n=%zu", ch, n);
+            bench(name, run_separate, ctx, n * ch, 2 * sizeof(sample_t) * n * ch);
+
+            snprintf(name, sizeof(name), "combine/ch=%d/n=%zu", ch, n);
+            bench(name, run_combine, ctx, n * ch, 2 * sizeof(sample_t) * n * ch);
+        }
+
+        // conversion into output formats of stereo, 5.1 and 7.1.4 output
+        for (int l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+            int ch = layouts[l];
+            static const struct {
+                const char *name;
+                at_writer_format_t format;
+                bool dither;
+            } formats[] = {
+                    {"s16",        AT_WRITER_S16,   false},
+                    {"s16-dither", AT_WRITER_S16,   true},
+                    {"s24",        AT_WRITER_S24,   false},
+                    {"float",      AT_WRITER_FLOAT, false}
+            };
+
+            for (int f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+                at_writer_init(&ctx->writer, formats[f].format, ch, formats[f].dither);
+
+                snprintf(name, sizeof(name), "convert-%s/ch=%d/n=%zu", formats[f].name, ch, n);
+                bench(name, run_convert, ctx, n * ch,
+                      (sizeof(sample_t) + at_writer_sample_size(formats[f].format)) * n * ch);
+            }
+        }
+
+        // filter state is carried over frames with 50 % overlap
+        at_lfe_init(&ctx->lfe, BENCH_RATE, n, n / 2, ctx->lfe_tail);
+
+        snprintf(name, sizeof(name), "lfe/n=%zu", n);
+        bench(name, run_lfe, ctx, n, 2 * sizeof(sample_t) * n);
+
+        // default matrices of common upmixes and downmixes
+        static const int mixes[][2] = {{1, 2}, {2, 6}, {5, 6}, {6, 2}, {6, 1}, {6, 8}, {12, 6}, {12, 2}};
+
+        for (int m = 0; m < sizeof(mixes) / sizeof(mixes[0]); m++) {
+            int in = mixes[m][0], out = mixes[m][1];
+
+            at_mix_init(&ctx->mix, in, out, false);
+
+            snprintf(name, sizeof(name), "mix/%dx%d/n=%zu", in, out, n);
+            bench(name, run_mix, ctx, n * out, sizeof(sample_t) * n * (in + out));
+        }
+    }
+}
+
+// streaming conversion of frames between common rates, stereo, 5.1 and 7.1.4
+static void bench_resample(bench_ctx_t *ctx) {
+    static const int rates[][2] = {{44100, 48000}, {48000, 44100}, {48000, 96000}};
+    const size_t n = 1024;
+    char name[64];
+
+    ctx->td->length = n;
+    ctx->length = n;
+
+    for (int q = AT_RESAMPLE_FAST; q <= AT_RESAMPLE_BEST; q++) {
+        for (int r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+            for (int l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+                int ch = layouts[l];
+
+                at_resampler_init(&ctx->resampler, rates[r][0], rates[r][1], ch, (at_resample_quality_t) q, n);
+
+                size_t out_frames = at_resampler_max_output(&ctx->resampler, n);
+                for (int i = 0; i < ch; i++)
+                    ctx->resampled[i] = init_buffer_sample(out_frames);
+
+                snprintf(name, sizeof(name), "resample-%s/%d-%d/ch=%d", at_resample_quality_name(q),
+                         rates[r][0], rates[r][1], ch);
+                bench(name, run_resample, ctx, n * ch, sizeof(sample_t) * (n + out_frames) * ch);
+
+                for (int i = 0; i < ch; i++)
+                    free(ctx->resampled[i]);
+                at_resampler_free(&ctx->resampler);
+            }
+        }
+    }
+}
+
+/* phase vocoder of all channels; frames of 20 ms overlap by 75 %, analysis hop is
+ * given by tempo, phases of the first frame are taken as they are */
+static void bench_vocoder(bench_ctx_t *ctx) {
+    static const double tempos[] = {0.8, 1.25};
+    char name[64];
+
+    for (int size = 512; size <= FFT_MAX; size *= 2) {
+        size_t window_size = (size_t) size * 15 / 32, synthesis_hop = window_size / 4;
+        const sample_t *window = at_window_get(AT_WINDOW_HAMMING, window_size, KAISER_BETA);
+
+        for (int t = 0; t < sizeof(tempos) / sizeof(tempos[0]); t++) {
+            double error = 0;
+
+            at_vocoder_init(&ctx->vocoder, tempos[t], window_size, size, synthesis_hop, window, MAX_CHANNELS);
+            at_vocoder_process(&ctx->vocoder, ctx->fd, synthesis_hop);
+            ctx->fft_size = size;
+            ctx->length = at_vocoder_hop(tempos[t], synthesis_hop, &error);
+
+            snprintf(name, sizeof(name), "vocoder-%.2f/fft=%d", tempos[t], size);
+            bench(name, run_vocoder, ctx, (size_t) size * MAX_CHANNELS, 2 * sizeof(sample_t) * size * MAX_CHANNELS);
+
+            at_vocoder_free(&ctx->vocoder);
+        }
+    }
+}
+
+/* partitioned convolution of all channels in blocks of a 20 ms frame hop (50 % overlap)
+ * with impulse responses of 0.1 s to 4 s; cost grows with count of partitions */
+static void bench_convolve(bench_ctx_t *ctx) {
+    static const double durations[] = {0.1, 1.0, 4.0};
+    size_t block = BENCH_RATE / 100;
+    char name[64];
+
+    for (int d = 0; d < sizeof(durations) / sizeof(durations[0]); d++) {
+        size_t length = (size_t) (durations[d] * BENCH_RATE);
+        sample_t *response = init_buffer_sample(length);
+
+        fill_signal(response, length, 3 * MAX_CHANNELS);
+        at_convolver_init(&ctx->convolver, &response, 1, length, MAX_CHANNELS, block, BENCH_RATE);
+        ctx->length = block;
+
+        snprintf(name, sizeof(name), "convolve/ir=%zu", length);
+        bench(name, run_convolve, ctx, block * MAX_CHANNELS,
+              2 * sizeof(sample_t) * ctx->convolver.partitions * SPECTRUM_SIZE(ctx->convolver.fft_size) * MAX_CHANNELS);
+
+        at_convolver_free(&ctx->convolver);
+        free(response);
+    }
+}
+
+/* analysis of output: meter of loudness and peaks in blocks of 1024 frames at 48 kHz and 96 kHz,
+ * octave bands and centroid of spectra of all FFT sizes; stereo, 5.1 and 7.1.4 */
+static void bench_analysis(bench_ctx_t *ctx) {
+    static const int rates[] = {48000, 96000};
+    const size_t n = 1024;
+    char name[64];
+
+    ctx->td->length = n;
+    ctx->length = n;
+
+    for (int l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+        int ch = layouts[l];
+
+        for (int r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+            at_analysis_init(&ctx->analysis, ch, at_mix_layout(ch, false), rates[r], 1024, rates[r],
+                             at_window_get(AT_WINDOW_HAMMING, 960, KAISER_BETA), 960);
+
+            snprintf(name, sizeof(name), "meter/%d/ch=%d", rates[r], ch);
+            bench(name, run_meter, ctx, n * ch, sizeof(sample_t) * n * ch);
+            snprintf(name, sizeof(name), "meter-true-peak/%d/ch=%d", rates[r], ch);
+            bench(name, run_meter_true_peak, ctx, n * ch, sizeof(sample_t) * n * ch);
+
+            at_analysis_free(&ctx->analysis);
+        }
+
+        ctx->fd->used_channels = ch;
+        for (int size = 512; size <= FFT_MAX; size *= 2) {
+            size_t window_size = (size_t) size * 15 / 16;
+
+            at_analysis_init(&ctx->analysis, ch, at_mix_layout(ch, false), BENCH_RATE, size, BENCH_RATE,
+                             at_window_get(AT_WINDOW_HAMMING, window_size, KAISER_BETA), window_size);
+
+            snprintf(name, sizeof(name), "analysis-spectrum/fft=%d/ch=%d", size, ch);
+            bench(name, run_analysis_spectrum, ctx, (size_t) size * ch, sizeof(sample_t) * size * ch);
+
+            at_analysis_free(&ctx->analysis);
+        }
+        ctx->fd->used_channels = MAX_CHANNELS;
+    }
+}
+
+static void bench_spectral(bench_ctx_t *ctx) {
+    char name[64];
+
+    for (int size = 64; size <= FFT_MAX; size *= 2) {
+        ctx->fft_size = size;
+        ctx->length = (size_t) size / 2;
+
+        // kernels on split spectra, each followed by previous kernel on halfcomplex spectra
+        static const struct {
+            const char *name;
+            bench_func_t split, halfcomplex;
+            int arrays;                 // count of arrays of 'size / 2' samples read and written
+        } kernels[] = {
+                {"magnitude",    run_magnitude,    run_magnitude_hc,    3},
+                {"power",        run_power,        run_power_hc,        3},
+                {"phase",        run_phase,        run_phase_hc,        3},
+                {"polar",        run_polar,        run_polar_hc,        4},
+                {"gain",         run_gain,         run_gain_hc,         5},
+                {"complex-gain", run_complex_gain, run_complex_gain_hc, 6}
+        };
+
+        for (int k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+            snprintf(name, sizeof(name), "%s/fft=%d", kernels[k].name, size);
+            bench(name, kernels[k].split, ctx, (size_t) size, sizeof(sample_t) * kernels[k].arrays * size / 2);
+
+            snprintf(name, sizeof(name), "%s-hc/fft=%d", kernels[k].name, size);
+            bench(name, kernels[k].halfcomplex, ctx, (size_t) size, sizeof(sample_t) * kernels[k].arrays * size / 2);
+        }
+
+        // single channel transforms copy data through FFT buffer
+        at_fftw_init(size);
+
+        snprintf(name, sizeof(name), "fft/fft=%d", size);
+        bench(name, run_fft, ctx, (size_t) size, 4 * sizeof(sample_t) * size);
+
+        snprintf(name, sizeof(name), "ifft/fft=%d", size);
+        bench(name, run_ifft, ctx, (size_t) size, 4 * sizeof(sample_t) * size);
+
+        // batched transforms work in place of containers with channel stride equal to FFT size
+        audio_container_t *td = at_allocate_buffer_stride(MAX_CHANNELS, (size_t) size / 2, (size_t) size, BENCH_RATE);
+        audio_container_t *fd = at_allocate_buffer_stride(MAX_CHANNELS, (size_t) size, SPECTRUM_SIZE((size_t) size),
+                                                          BENCH_RATE);
+        bench_ctx_t batch_ctx = *ctx;
+
+        batch_ctx.batch = at_fftw_plan_batch(td, fd);
+        for (int ch = 0; ch < MAX_CHANNELS; ch++)
+            fill_signal(td->channel[ch], (size_t) size / 2, ch);
+
+        snprintf(name, sizeof(name), "fft-batch/fft=%d", size);
+        bench(name, run_fft_batch, &batch_ctx, (size_t) size * MAX_CHANNELS,
+              2 * sizeof(sample_t) * size * MAX_CHANNELS);
+
+        snprintf(name, sizeof(name), "ifft-batch/fft=%d", size);
+        bench(name, run_ifft_batch, &batch_ctx, (size_t) size * MAX_CHANNELS,
+              2 * sizeof(sample_t) * size * MAX_CHANNELS);
+
+        at_fftw_free_batch(batch_ctx.batch);
+        at_free_buffer(td);
+        at_free_buffer(fd);
+
+        at_fftw_free();
+    }
+}
+
+/* accuracy */
+
+// absolute error of kernel output against reference
+typedef struct check_error_t {
+    double max;
+    double sum;                         // sum of squares
+    size_t count;
+} check_error_t;
+
+static void check_add(check_error_t *error, const sample_t *out, const double *reference, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        double e = fabs(out[i] - reference[i]);
+
+        // NaN is reported as infinite error
+        if (isnan(e))
+            e = INFINITY;
+        error->max = MAX(error->max, e);
+        error->sum += e * e;
+    }
+    error->count += length;
+}
+
+/* Print max. and RMS error of kernel; error is bounded by 'bound' plus 'ulps' rounding errors
+ * of sample precision, exceeding it is reported. */
+static void check_report(const char *name, const check_error_t *error, double bound, double ulps) {
+    double epsilon = sizeof(sample_t) == sizeof(float) ? FLT_EPSILON : DBL_EPSILON;
+    double limit = bound + ulps * epsilon;
+
+    printf("%-28s %12.3e %12.3e %12.3e", name, error->max, sqrt(error->sum / MAX(error->count, 1)), limit);
+    if (!(error->max <= limit)) {
+        printf("  INACCURATE");
+        inaccurate++;
+    }
+    putchar('\n');
+}
+
+// phase of reference is moved by 2 pi to the side of output, -pi and pi are the same phase
+static double check_angle(double out, double reference) {
+    return out + remainder(reference - out, 2 * M_PI);
+}
+
+// Hamming window of all frame lengths against its formula
+static void check_window(bench_ctx_t *ctx, double *reference) {
+    static const size_t lengths[] = {256, 512, WINDOW_MAX};
+    check_error_t error = {0};
+
+    if (!selected("window"))
+        return;
+
+    for (int l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+        size_t n = lengths[l];
+        sample_t *data = ctx->td->channel[0];
+
+        memcpy(data, ctx->source, sizeof(sample_t) * n);
+        at_window_multiply(data, at_window_get(AT_WINDOW_HAMMING, n, KAISER_BETA), n);
+
+        for (size_t i = 0; i < n; i++)
+            reference[i] = (double) ctx->source[i] * (0.54 - 0.46 * cos(2 * M_PI * i / (n - 1)));
+        check_add(&error, data, reference, n);
+    }
+
+    check_report("window", &error, 0, 4);
+}
+
+// default matrices of upmixes and downmixes, each output channel against sum of products
+static void check_mix(bench_ctx_t *ctx, double *reference) {
+    static const int mixes[][2] = {{1, 2}, {2, 6}, {6, 2}, {6, 8}, {12, 6}, {12, 2}};
+    const size_t n = 1024;
+    char name[64];
+
+    for (int m = 0; m < sizeof(mixes) / sizeof(mixes[0]); m++) {
+        int in = mixes[m][0], out = mixes[m][1];
+        check_error_t error = {0};
+
+        snprintf(name, sizeof(name), "mix/%dx%d", in, out);
+        if (!selected(name))
+            continue;
+
+        at_mix_init(&ctx->mix, in, out, false);
+        for (int ch = 0; ch < MAX_CHANNELS; ch++)
+            memcpy(ctx->td->channel[ch], ctx->source + ch * FFT_MAX, sizeof(sample_t) * n);
+        ctx->td->length = n;
+        at_mix_process(&ctx->mix, ctx->td);
+
+        for (int o = 0; o < out; o++) {
+            for (size_t i = 0; i < n; i++) {
+                reference[i] = 0;
+                for (int c = 0; c < in; c++)
+                    reference[i] += (double) ctx->mix.matrix[o * in + c] * ctx->source[c * FFT_MAX + i];
+            }
+            check_add(&error, ctx->td->channel[o], reference, n);
+        }
+
+        check_report(name, &error, 0, 4 * in);
+    }
+}
+
+/* Kernels on split spectra of all FFT sizes; real and imaginary parts of DC and Nyquist
+ * bins are taken as zero, as r2c transform leaves them, every third bin is silent. */
+static void check_spectral(bench_ctx_t *ctx, double *reference) {
+    sample_t *spectrum = init_buffer_sample(SPECTRUM_SIZE(FFT_MAX));
+    check_error_t errors[5] = {{0}};
+
+    for (int size = 64; size <= FFT_MAX; size *= 2) {
+        int bins = SPECTRUM_BINS(size);
+        const sample_t *re = spectrum, *im = spectrum + SPECTRUM_IMAG(size);
+        const sample_t *magnitude = ctx->source, *phase = ctx->source + FFT_MAX;
+        sample_t *out = ctx->out;
+
+        memcpy(spectrum, ctx->fd->channel[0], sizeof(sample_t) * SPECTRUM_SIZE(size));
+        spectrum[SPECTRUM_IMAG(size)] = 0;
+        spectrum[SPECTRUM_IMAG(size) + size / 2] = 0;
+
+        for (int k = 0; k < bins; k += 3) {
+            spectrum[k] = 0;
+            spectrum[SPECTRUM_IMAG(size) + k] = 0;
+        }
+
+        at_spectrum_magnitude(spectrum, size, out);
+        for (int k = 0; k < bins; k++)
+            reference[k] = sqrt((double) re[k] * re[k] + (double) im[k] * im[k]);
+        check_add(&errors[0], out, reference, bins);
+
+        at_spectrum_power(spectrum, size, out);
+        for (int k = 0; k < bins; k++)
+            reference[k] = (double) re[k] * re[k] + (double) im[k] * im[k];
+        check_add(&errors[1], out, reference, bins);
+
+        at_spectrum_phase(spectrum, size, out);
+        for (int k = 0; k < bins; k++)
+            reference[k] = check_angle(out[k], atan2(im[k], re[k]));
+        check_add(&errors[2], out, reference, bins);
+
+        // real parts and imaginary parts up to Nyquist bin
+        at_spectrum_polar(magnitude, phase, size, out);
+        for (int k = 0; k < bins; k++) {
+            reference[k] = magnitude[k] * cos(phase[k]);
+            reference[SPECTRUM_IMAG(size) + k] = magnitude[k] * sin(phase[k]);
+        }
+        reference[SPECTRUM_IMAG(size)] = reference[SPECTRUM_IMAG(size) + size / 2] = 0;
+        check_add(&errors[3], out, reference, bins);
+        check_add(&errors[3], out + SPECTRUM_IMAG(size), reference + SPECTRUM_IMAG(size), bins);
+
+        memcpy(out, spectrum, sizeof(sample_t) * SPECTRUM_SIZE(size));
+        at_spectrum_complex_gain(ctx->gain, size, out);
+        for (int k = 0; k < bins; k++) {
+            const sample_t *g_re = ctx->gain, *g_im = ctx->gain + SPECTRUM_IMAG(size);
+
+            reference[k] = (double) re[k] * g_re[k] - (double) im[k] * g_im[k];
+            reference[SPECTRUM_IMAG(size) + k] = (double) re[k] * g_im[k] + (double) im[k] * g_re[k];
+        }
+        check_add(&errors[4], out, reference, bins);
+        check_add(&errors[4], out + SPECTRUM_IMAG(size), reference + SPECTRUM_IMAG(size), bins);
+    }
+
+    // bounds of approximations of phase and of sine and cosine are given in spectrum.h
+    static const struct {
+        const char *name;
+        double bound, ulps;
+    } kernels[] = {
+            {"magnitude",    0,    4},
+            {"power",        0,    4},
+            {"phase",        2e-6, 16},
+            {"polar",        1e-8, 8},
+            {"complex-gain", 0,    4}
+    };
+
+    for (int k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        if (selected(kernels[k].name))
+            check_report(kernels[k].name, &errors[k], kernels[k].bound, kernels[k].ulps);
+    }
+
+    free(spectrum);
+}
+
+// magnitude response of cascade at normalized angular frequency 'w' in dB
+static double cascade_response(const at_iir_cascade_t *filter, double w) {
+    double gain = 1;
+
+    for (int i = 0; i < filter->sections; i++) {
+        const at_biquad_t *bq = &filter->section[i];
+        double complex z = cexp(-I * w);
+
+        gain *= cabs((bq->b0 + bq->b1 * z + bq->b2 * z * z) / (1 + bq->a1 * z + bq->a2 * z * z));
+    }
+
+    return 20 * log10(gain);
+}
+
+// Linkwitz-Riley filters of LFE of all slopes are 6 dB down at cutoff frequency
+static void check_lfe(void) {
+    char name[64];
+
+    for (int slope = 12; slope <= 96; slope += 12) {
+        at_iir_cascade_t filter;
+        check_error_t error = {0};
+        double expected = -20 * log10(2.0);
+        sample_t response;
+
+        snprintf(name, sizeof(name), "lfe-cutoff/slope=%d", slope);
+        if (!selected(name))
+            continue;
+
+        at_iir_linkwitz_riley_lowpass(&filter, CUTOFF_FREQ, slope, BENCH_RATE);
+        response = (sample_t) cascade_response(&filter, 2 * M_PI * CUTOFF_FREQ / BENCH_RATE);
+        check_add(&error, &response, &expected, 1);
+
+        check_report(name, &error, 1e-6, 0);
+    }
+}
+
+/* Meter of stereo and 5.1 sines of a quarter of sampling frequency shifted by 45 degrees:
+ * samples have 1/sqrt(2) of amplitude, peaks of the continuous signal lie halfway between
+ * them, so that both 4x and 2x oversampling hit them. Stereo sine of 1 kHz has loudness equal
+ * to its level in dBFS, K-weighting gain and offset of BS.1770 cancel out. */
+static void check_meter(bench_ctx_t *ctx) {
+    static const int rates[] = {48000, 96000};
+    static const int channels[] = {2, 6};
+    const double amplitude = 0.5, level = 20 * log10(amplitude);
+    const size_t n = 1024;
+    char name[64];
+
+    for (int r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+        size_t length = (size_t) rates[r] * 3;
+        sample_t *data[MAX_CHANNELS], *block[MAX_CHANNELS];
+
+        for (int l = 0; l < sizeof(channels) / sizeof(channels[0]); l++) {
+            int ch = channels[l];
+            check_error_t sample_error = {0}, true_error = {0};
+            char true_name[64];
+
+            snprintf(name, sizeof(name), "sample-peak/%d/ch=%d", rates[r], ch);
+            snprintf(true_name, sizeof(true_name), "true-peak/%d/ch=%d", rates[r], ch);
+            if (!selected(name) && !selected(true_name))
+                continue;
+
+            // peaks are measured on the sine of a quarter of sampling frequency, its samples repeat by 4
+            for (int c = 0; c < ch; c++) {
+                data[c] = init_buffer_sample(length);
+                for (size_t i = 0; i < length; i++)
+                    data[c][i] = (sample_t) (amplitude * M_SQRT1_2 * (i % 4 < 2 ? 1 : -1));
+            }
+
+            at_analysis_init(&ctx->analysis, ch, at_mix_layout(ch, false), rates[r], 1024, rates[r],
+                             at_window_get(AT_WINDOW_HAMMING, 960, KAISER_BETA), 960);
+            for (size_t i = 0; i < length; i += n) {
+                for (int c = 0; c < ch; c++)
+                    block[c] = data[c] + i;
+                at_analysis_samples(&ctx->analysis, block, MIN(n, length - i));
+            }
+
+            for (int c = 0; c < ch; c++) {
+                sample_t sample_peak = (sample_t) ctx->analysis.sample_peak[c];
+                sample_t true_peak = (sample_t) ctx->analysis.true_peak[c];
+                double expected = amplitude * M_SQRT1_2;
+
+                check_add(&sample_error, &sample_peak, &expected, 1);
+                check_add(&true_error, &true_peak, &amplitude, 1);
+            }
+            at_analysis_free(&ctx->analysis);
+
+            for (int c = 0; c < ch; c++)
+                free(data[c]);
+
+            // interpolator of 12 taps overshoots peaks of a quarter of sampling frequency by 0.17 dB
+            check_report(name, &sample_error, 0, 4);
+            check_report(true_name, &true_error, amplitude * 0.025, 4);
+        }
+
+        snprintf(name, sizeof(name), "loudness/%d", rates[r]);
+        if (!selected(name))
+            continue;
+
+        // loudness of mono sine of 1 kHz, it has half of power of the sine in both channels of stereo
+        check_error_t loudness_error = {0};
+        double expected = level - 10 * log10(2.0);
+
+        data[0] = init_buffer_sample(length);
+        for (size_t i = 0; i < length; i++)
+            data[0][i] = (sample_t) (amplitude * sin(2 * M_PI * 1000.0 * i / rates[r]));
+
+        at_analysis_init(&ctx->analysis, 1, NULL, rates[r], 1024, rates[r],
+                         at_window_get(AT_WINDOW_HAMMING, 960, KAISER_BETA), 960);
+        for (size_t i = 0; i < length; i += n) {
+            block[0] = data[0] + i;
+            at_analysis_samples(&ctx->analysis, block, MIN(n, length - i));
+        }
+        sample_t integrated = (sample_t) at_analysis_integrated(&ctx->analysis);
+
+        check_add(&loudness_error, &integrated, &expected, 1);
+
+        at_analysis_free(&ctx->analysis);
+        free(data[0]);
+
+        // histograms have bins of 0.01 LU, K-weighting gain at 1 kHz differs from offset of BS.1770 by 0.01 dB
+        check_report(name, &loudness_error, 0.03, 0);
+    }
+}
+
+static void help(const char *argv0) {
+    printf("\nAudio Tools kernel benchmark\n"
+                   "----------------------------\n\n"
+                   "Usage: %s [options]\n\n"
+                   "  -h, --help                  Show this help and quit\n"
+                   "      --filter                Run only kernels whose name contains given string\n"
+                   "      --min-time              Minimal duration of a measured run in ms, default 20 ms\n"
+                   "      --save                  Save results into given file\n"
+                   "      --baseline              Compare results with file written by --save\n"
+                   "      --threshold             Slowdown against baseline reported as regression,\n"
+                   "                              in percents, default 10 %%\n"
+                   "      --errors                Report max. and RMS error of kernels against reference\n"
+                   "                              computed in double precision instead of timing them\n\n"
+                   "Exit status is 2 if any kernel regressed against baseline, 3 if an error of kernel\n"
+                   "exceeds its bound.\n\n", argv0);
+}
+
+int main(int argc, char **argv) {
+    enum bench_args_t {
+        ARG_FILTER,
+        ARG_MIN_TIME,
+        ARG_SAVE,
+        ARG_BASELINE,
+        ARG_THRESHOLD,
+        ARG_ERRORS
+    };
+
+    static const struct option long_options[] = {
+            {"help",      no_argument,       NULL, 'h'},
+            {"filter",    required_argument, NULL, ARG_FILTER},
+            {"min-time",  required_argument, NULL, ARG_MIN_TIME},
+            {"save",      required_argument, NULL, ARG_SAVE},
+            {"baseline",  required_argument, NULL, ARG_BASELINE},
+            {"threshold", required_argument, NULL, ARG_THRESHOLD},
+            {"errors",    no_argument,       NULL, ARG_ERRORS},
+            {NULL, 0,                        NULL, 0}
+    };
+
+    const char *save_file = NULL;
+    bool errors = false;
+    int c;
+
+    // kernels read their settings from defaults of command line tool
+    at_init_defaults();
+
+    while ((c = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'h':
+                help(argv[0]);
+                exit(0);
+            case ARG_FILTER:
+                filter = optarg;
+                break;
+            case ARG_MIN_TIME:
+                min_time = atof(optarg) * 1e6;
+                break;
+            case ARG_SAVE:
+                save_file = optarg;
+                break;
+            case ARG_BASELINE:
+                load_baseline(optarg);
+                break;
+            case ARG_THRESHOLD:
+                threshold = atof(optarg);
+                break;
+            case ARG_ERRORS:
+                errors = true;
+                break;
+            default:
+                help(argv[0]);
+                exit(1);
+        }
+    }
+
+    if (min_time <= 0) {
+        puts("Minimal duration of a run is out of range. Setting do defaults (20 ms).");
+        min_time = BENCH_MIN_TIME * 1e6;
+    }
+
+    bench_ctx_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+
+    ctx.td = at_allocate_buffer_stride(MAX_CHANNELS, WINDOW_MAX, FFT_MAX, BENCH_RATE);
+    ctx.fd = at_allocate_buffer_stride(MAX_CHANNELS, FFT_MAX, SPECTRUM_SIZE(FFT_MAX), BENCH_RATE);
+    ctx.multi = init_buffer_sample(FFT_MAX * MAX_CHANNELS);
+    ctx.source = init_buffer_sample(FFT_MAX * MAX_CHANNELS);
+    ctx.out = init_buffer_sample(SPECTRUM_SIZE(FFT_MAX));
+    ctx.gain = init_buffer_sample(SPECTRUM_SIZE(FFT_MAX));
+    ctx.sign = init_buffer_sample(FFT_MAX);
+    ctx.lfe_tail = init_buffer_sample(WINDOW_MAX);
+
+    for (int ch = 0; ch < MAX_CHANNELS; ch++) {
+        fill_signal(ctx.source + ch * FFT_MAX, FFT_MAX, ch);
+        memcpy(ctx.td->channel[ch], ctx.source + ch * FFT_MAX, sizeof(sample_t) * FFT_MAX);
+        fill_signal(ctx.fd->channel[ch], SPECTRUM_SIZE(FFT_MAX), ch + MAX_CHANNELS);
+    }
+
+    // complex gains have unit magnitude in both split and halfcomplex layout
+    for (int k = 0; k < SPECTRUM_SIZE(FFT_MAX); k++)
+        ctx.gain[k] = (sample_t) M_SQRT1_2;
+    for (int k = 0; k < FFT_MAX; k++)
+        ctx.sign[k] = k % 3 == 0 ? -1 : 1;
+    fill_signal(ctx.multi, FFT_MAX * MAX_CHANNELS, 2 * MAX_CHANNELS);
+
+    printf("Sample precision: %s\n", sizeof(sample_t) == sizeof(float) ? "single (float)" : "double");
+
+    if (errors) {
+        double *reference = malloc(sizeof(double) * SPECTRUM_SIZE(FFT_MAX));
+
+        printf("%-28s %12s %12s %12s\n", "kernel", "max. error", "RMS error", "bound");
+        check_window(&ctx, reference);
+        check_mix(&ctx, reference);
+        check_lfe();
+        check_spectral(&ctx, reference);
+        check_meter(&ctx);
+        free(reference);
+    } else {
+        printf("%-28s %20s %14s%s\n", "kernel", "time", "bandwidth", baseline_count ? "    change" : "");
+
+        bench_time_domain(&ctx);
+        bench_resample(&ctx);
+        bench_spectral(&ctx);
+        bench_vocoder(&ctx);
+        bench_convolve(&ctx);
+        bench_analysis(&ctx);
+    }
+
+    if (save_file != NULL)
+        save_results(save_file);
+
+    at_free_buffer(ctx.td);
+    at_free_buffer(ctx.fd);
+    free(ctx.multi);
+    free(ctx.source);
+    free(ctx.out);
+    free(ctx.gain);
+    free(ctx.sign);
+    free(ctx.lfe_tail);
+    at_window_free_cache();
+
+    if (regressions > 0) {
+        printf("%d kernel(s) slower than baseline by more than %.1f %%.\n", regressions, threshold);
+        return 2;
+    }
+
+    if (inaccurate > 0) {
+        printf("%d kernel(s) with error above bound.\n", inaccurate);
+        return 3;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -21,13 +21,50 @@
 #include <math.h>
 #include "common.h"
 
-double *init_buffer_dbl(size_t size) {
-    double *ptr = (double *) malloc(sizeof(*ptr) * size);
+// count of allocations, used to verify that processing loop does not allocate
+static unsigned long alloc_count = 0;
+
+void *at_malloc(size_t size) {
+    void *ptr = malloc(size);
 
     if (ptr == NULL) {
         fprintf(stdout, "\nError: malloc failed: %s\n", strerror(errno));
         exit(1);
     }
+
+    __atomic_add_fetch(&alloc_count, 1, __ATOMIC_RELAXED);
+
+    return ptr;
+}
+
+void *at_malloc_aligned(size_t alignment, size_t size) {
+    void *ptr = NULL;
+    int error = posix_memalign(&ptr, alignment, size);
+
+    if (error != 0) {
+        fprintf(stdout, "\nError: posix_memalign failed: %s\n", strerror(error));
+        exit(1);
+    }
+
+    __atomic_add_fetch(&alloc_count, 1, __ATOMIC_RELAXED);
+
+    return ptr;
+}
+
+unsigned long at_get_alloc_count(void) {
+    return __atomic_load_n(&alloc_count, __ATOMIC_RELAXED);
+}
+
+double *init_buffer_dbl(size_t size) {
+    double *ptr = (double *) at_malloc(sizeof(*ptr) * size);
+    /* initialize array to zero */
+    memset((void *) ptr, 0, sizeof(*ptr) * size);
+
+    return (ptr);
+}
+
+sample_t *init_buffer_sample(size_t size) {
+    sample_t *ptr = (sample_t *) at_malloc(sizeof(*ptr) * size);
     /* initialize array to zero */
     memset((void *) ptr, 0, sizeof(*ptr) * size);
 
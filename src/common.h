@@ -44,9 +44,34 @@
 #include <stdbool.h>
 #include <stdlib.h>
 
+/* Precision of audio samples and FFT, selected at build time. With AT_SINGLE_PRECISION
+ * samples are read, processed and written as float and FFTW single precision API is used.
+ */
+#ifdef AT_SINGLE_PRECISION
+typedef float sample_t;
+#    define sf_readf_sample     sf_readf_float
+#    define sf_writef_sample    sf_writef_float
+#else
+typedef double sample_t;
+#    define sf_readf_sample     sf_readf_double
+#    define sf_writef_sample    sf_writef_double
+#endif
+
+/* allocate memory, exit on failure; every call increments allocation counter */
+extern void *at_malloc(size_t size);
+
+/* allocate memory aligned to given power of two, exit on failure */
+extern void *at_malloc_aligned(size_t alignment, size_t size);
+
+/* count of allocations done by at_malloc() and at_malloc_aligned() so far */
+extern unsigned long at_get_alloc_count(void);
+
 /* create dynamic double array */
 extern double *init_buffer_dbl(size_t size);
 
+/* create dynamic array of samples */
+extern sample_t *init_buffer_sample(size_t size);
+
 /* print time based on samples played */
 char *show_time(int samplerate, int samples);
 
@@ -0,0 +1,175 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sndfile.h>
+#include "convolve.h"
+#include "interleave.h"
+#include "spectrum.h"
+
+// spectrum of channel 'c' in slot 'slot' of filter or delay line
+static inline sample_t *spectrum_at(const at_convolver_t *conv, sample_t *base, size_t slot, int c) {
+    return base + (slot * conv->channels + c) * SPECTRUM_SIZE(conv->fft_size);
+}
+
+int at_convolver_init(at_convolver_t *conv, sample_t *const *filter, int filter_channels, size_t length,
+                      int channels, size_t block, int samplerate) {
+    size_t fft_size = 1;
+
+    if (filter_channels != 1 && filter_channels < channels)
+        return -1;
+
+    memset(conv, 0, sizeof(*conv));
+
+    // circular convolution of '2 * block' samples keeps the last 'block' samples free of aliasing
+    while (fft_size < 2 * block)
+        fft_size *= 2;
+
+    conv->channels = channels;
+    conv->block = block;
+    conv->fft_size = fft_size;
+    conv->partitions = MAX((length + block - 1) / block, 1);
+
+    conv->filter = init_buffer_sample(conv->partitions * channels * SPECTRUM_SIZE(fft_size));
+    conv->delay_line = init_buffer_sample(conv->partitions * channels * SPECTRUM_SIZE(fft_size));
+
+    for (int c = 0; c < channels; c++)
+        conv->history[c] = init_buffer_sample(fft_size);
+
+    conv->td = at_allocate_buffer_stride(channels, fft_size, fft_size, samplerate);
+    conv->fd = at_allocate_buffer_stride(channels, fft_size, SPECTRUM_SIZE(fft_size), samplerate);
+    conv->batch = at_fftw_plan_batch(conv->td, conv->fd);
+
+    // spectra of zero padded partitions
+    for (size_t p = 0; p < conv->partitions; p++) {
+        size_t start = p * block, count = MIN(length - start, block);
+
+        for (int c = 0; c < channels; c++) {
+            memcpy(conv->td->channel[c], filter[filter_channels == 1 ? 0 : c] + start, sizeof(sample_t) * count);
+            memset(conv->td->channel[c] + count, 0, sizeof(sample_t) * (fft_size - count));
+        }
+
+        at_compute_fft_batch(conv->batch);
+
+        for (int c = 0; c < channels; c++)
+            memcpy(spectrum_at(conv, conv->filter, p, c), conv->fd->channel[c],
+                   sizeof(sample_t) * SPECTRUM_SIZE(fft_size));
+    }
+
+    return 0;
+}
+
+void at_convolver_load(at_convolver_t *conv, const char *path, int channels, size_t block, int samplerate) {
+    sample_t *filter[MAX_CHANNELS] = {NULL};
+    SF_INFO info;
+    SNDFILE *file;
+
+    memset(&info, 0, sizeof(info));
+
+    if ((file = sf_open(path, SFM_READ, &info)) == NULL) {
+        fprintf(stderr, "Error: Unable to open impulse response '%s': %s\n", path, sf_strerror(NULL));
+        exit(1);
+    }
+
+    if (info.frames <= 0 || info.channels > MAX_CHANNELS || (info.channels != 1 && info.channels < channels)) {
+        fprintf(stderr, "Error: Impulse response '%s' has to be non-empty with one channel or %d channels.\n",
+                path, channels);
+        exit(1);
+    }
+
+    if (info.samplerate != samplerate) {
+        fprintf(stderr, "Error: Sample rate of impulse response '%s' (%d Hz) differs from input (%d Hz).\n",
+                path, info.samplerate, samplerate);
+        exit(1);
+    }
+
+    sample_t *multi_data = init_buffer_sample((size_t) info.frames * info.channels);
+    size_t length = (size_t) sf_readf_sample(file, multi_data, info.frames);
+
+    sf_close(file);
+
+    for (int c = 0; c < info.channels; c++)
+        filter[c] = init_buffer_sample(MAX(length, 1));
+    at_deinterleave(multi_data, filter, info.channels, length);
+
+    at_convolver_init(conv, filter, info.channels, length, channels, block, samplerate);
+
+    free(multi_data);
+    for (int c = 0; c < info.channels; c++)
+        free(filter[c]);
+}
+
+void at_convolver_process(at_convolver_t *conv, sample_t *const *channel) {
+    size_t fft_size = conv->fft_size, block = conv->block;
+
+    // newest block is appended to input history, which is transformed whole
+    for (int c = 0; c < conv->channels; c++) {
+        sample_t *history = conv->history[c];
+
+        memmove(history, history + block, sizeof(sample_t) * (fft_size - block));
+        memcpy(history + fft_size - block, channel[c], sizeof(sample_t) * block);
+        memcpy(conv->td->channel[c], history, sizeof(sample_t) * fft_size);
+    }
+
+    at_compute_fft_batch(conv->batch);
+
+    // partition 'p' is multiplied with spectrum of block received 'p' blocks ago
+    conv->current = (conv->current + 1) % conv->partitions;
+
+    for (int c = 0; c < conv->channels; c++) {
+        sample_t *sum = conv->fd->channel[c];
+        size_t size = SPECTRUM_SIZE(fft_size);
+
+        // output spectrum is accumulated in place of input one
+        memcpy(spectrum_at(conv, conv->delay_line, conv->current, c), sum, sizeof(sample_t) * size);
+        memset(sum, 0, sizeof(sample_t) * size);
+
+        for (size_t p = 0, slot = conv->current; p < conv->partitions; p++) {
+            at_spectrum_multiply_add(spectrum_at(conv, conv->delay_line, slot, c),
+                                     spectrum_at(conv, conv->filter, p, c), (int) fft_size, sum);
+            slot = slot == 0 ? conv->partitions - 1 : slot - 1;
+        }
+    }
+
+    at_compute_ifft_batch(conv->batch);
+
+    // only the last 'block' samples of circular convolution are equal to linear one
+    for (int c = 0; c < conv->channels; c++)
+        memcpy(channel[c], conv->td->channel[c] + fft_size - block, sizeof(sample_t) * block);
+}
+
+void at_convolver_reset(at_convolver_t *conv) {
+    for (int c = 0; c < conv->channels; c++)
+        memset(conv->history[c], 0, sizeof(sample_t) * conv->fft_size);
+
+    memset(conv->delay_line, 0, sizeof(sample_t) * conv->partitions * conv->channels * SPECTRUM_SIZE(conv->fft_size));
+    conv->current = 0;
+}
+
+void at_convolver_free(at_convolver_t *conv) {
+    at_fftw_free_batch(conv->batch);
+    at_free_buffer(conv->td);
+    at_free_buffer(conv->fd);
+    free(conv->filter);
+    free(conv->delay_line);
+
+    for (int c = 0; c < conv->channels; c++)
+        free(conv->history[c]);
+}
@@ -0,0 +1,68 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CONVOLVE_H_
+#define CONVOLVE_H_
+
+#include <stddef.h>
+#include "common.h"
+#include "dsp.h"
+#include "fft.h"
+
+/* Uniformly partitioned overlap-save convolution with long FIR filters, e.g. impulse responses
+ * of rooms. Filter is split into partitions of 'block' samples, spectra of partitions are
+ * computed once. Each block of input is transformed together with preceding input, its spectrum
+ * is kept in a frequency-domain delay line and output spectrum is the sum of products of
+ * partitions with spectra of the same count of recent blocks. Cost per sample is one FFT pair
+ * of '2 * block' samples and one complex multiply-add per partition and bin, instead of
+ * a multiply-add per filter tap. Output of a block is ready as soon as the block is complete,
+ * so latency is one partition. Transforms are independent of FFT_MAX.
+ */
+
+typedef struct at_convolver_t {
+    int channels;                       // count of filtered channels
+    size_t block;                       // size of partitions and input blocks
+    size_t fft_size;                    // power of two >= '2 * block'
+    size_t partitions;                  // count of partitions of filter
+    size_t current;                     // slot of delay line holding spectrum of the newest block
+    sample_t *filter;                   // spectra of partitions of each channel
+    sample_t *delay_line;               // spectra of recent input blocks of each channel
+    sample_t *history[MAX_CHANNELS];    // last 'fft_size' input samples of each channel
+    audio_container_t *td;              // time domain data of batched transform
+    audio_container_t *fd;              // spectra of batched transform
+    at_fft_batch_t *batch;
+} at_convolver_t;
+
+/* Prepare convolution of 'channels' channels in blocks of 'block' samples with filter of 'length'
+ * taps; filter of channel 'i' is 'filter[i]', or 'filter[0]' for all channels if 'filter_channels'
+ * is 1. Returns -1 if there are too few filters. */
+int at_convolver_init(at_convolver_t *conv, sample_t *const *filter, int filter_channels, size_t length,
+                      int channels, size_t block, int samplerate);
+
+/* Prepare convolution with impulse response loaded from audio file 'path'; the file has one channel
+ * or a channel for each of 'channels' and its sample rate is 'samplerate'. Exits on failure. */
+void at_convolver_load(at_convolver_t *conv, const char *path, int channels, size_t block, int samplerate);
+
+/* filter next 'block' samples of each channel in place */
+void at_convolver_process(at_convolver_t *conv, sample_t *const *channel);
+
+/* forget previous input, so that following block starts a new input */
+void at_convolver_reset(at_convolver_t *conv);
+
+void at_convolver_free(at_convolver_t *conv);
+
+#endif /* CONVOLVE_H_ */
@@ -19,24 +19,1033 @@
 #include <string.h>
 #include <math.h>
 #include <errno.h>
+#include <pthread.h>
 #include "dsp.h"
 #include "common.h"
 #include "audiotools.h"
 #include "pa_play.h"
+#include "window.h"
+#include "stage.h"
+#include "pool.h"
+#include "arena.h"
+#include "interleave.h"
+#include "ring.h"
+#include "stats.h"
+#include "pcm_map.h"
+#include "writer.h"
+#include "resample.h"
+#include "vocoder.h"
+#include "convolve.h"
+#include "mix.h"
+#include "analysis.h"
+
+// buffers are kept between processed files, so batch workers do not allocate per file
+static at_arena_t session_arena;
+
+// parameters shared by processing stages
+typedef struct stage_params_t {
+    const at_mix_t *mix;       // matrix mixing input channels into output ones
+    at_lfe_t *lfe;            // state of LFE low-pass filter
+    size_t window_size;        // size of a frame
+    const sample_t *window;    // table of window function
+    double volume;            // volume setting
+    at_vocoder_t *vocoder;     // phase vocoder changing tempo, NULL if tempo is kept
+    size_t hop;                // count of input samples between current and previous frame
+    at_analysis_t *analysis;   // analysis of output, NULL if disabled
+} stage_params_t;
+
+// time domain stage: input channels are mixed into output ones, LFE created by mixing is low-pass filtered
+static void stage_mix(audio_container_t *container, void *user_data) {
+    stage_params_t *params = user_data;
+
+    at_mix_process(params->mix, container);
+    if (params->mix->lfe >= 0)
+        at_create_lfe(container->channel[params->mix->lfe], params->lfe);
+}
+
+// time domain stage: volume change
+static void stage_gain(audio_container_t *container, void *user_data) {
+    stage_params_t *params = user_data;
+    at_audio_gain(container, params->volume);
+}
+
+// time domain stage: window function
+static void stage_window(audio_container_t *container, void *user_data) {
+    stage_params_t *params = user_data;
+
+    for (int i = 0; i < container->used_channels; i++)
+        at_window_multiply(container->channel[i], params->window, params->window_size);
+}
+
+// frequency domain stage: spectrum is left untouched
+static void stage_passthrough(audio_container_t *container, void *user_data) {
+}
+
+// frequency domain stage: phases are advanced by synthesis hop instead of analysis one
+static void stage_vocoder(audio_container_t *container, void *user_data) {
+    stage_params_t *params = user_data;
+    at_vocoder_process(params->vocoder, container, params->hop);
+}
+
+// frequency domain stage: spectra of output channels are analysed, they are left untouched
+static void stage_analysis(audio_container_t *container, void *user_data) {
+    stage_params_t *params = user_data;
+    at_analysis_spectrum(params->analysis, container);
+}
+
+// time domain stage: synthesis window of phase vocoder
+static void stage_synthesis(audio_container_t *container, void *user_data) {
+    stage_params_t *params = user_data;
+    at_vocoder_synthesis(params->vocoder, container);
+}
+
+// all buffers of processing loop, carved from a single arena
+typedef struct processor_buffers_t {
+    sample_t *multi_data;               // interleaved frame of input audio
+    void *out_data;                     // output converted into sample format of output
+    sample_t *lfe_tail;                 // filtered end of previous frame of LFE channel
+    audio_container_t td;               // separated channels in time domain, padded to FFT size
+    audio_container_t fd;               // separated channels in frequency domain
+    audio_container_t old;              // tails of previous frames summed for add-and-overlap
+    sample_t *scratch[MAX_THREADS];     // FFT scratch buffer of each worker thread
+    sample_t *resampled;                // separated channels of resampled output
+    void *input_slots;                  // slots of pipeline rings
+    void *output_slots;
+} processor_buffers_t;
+
+// parameters determining size of processor buffers
+typedef struct processor_layout_t {
+    size_t window_size;
+    size_t noverlap;
+    size_t nslide;
+    size_t out_frames;                  // max. count of output frames of a frame or of flush, 'nslide' unless resampled
+    size_t fft_size;
+    double tempo;                       // change of tempo by phase vocoder, 1.0 for no change
+    const char *impulse_response;       // file of impulse response convolved with output channels, may be NULL
+    int channels;                       // max. count of input and output channels
+    int in_channels;
+    int out_channels;
+    int samplerate;
+    int threads;                        // count of FFT worker threads
+    bool fft;                           // frequency domain processing is needed
+    bool pulse;                         // output is played via PA server
+    bool resample;                      // output is resampled to another rate
+    int depth;                          // count of slots in each pipeline ring, 0 for serial processing
+} processor_layout_t;
+
+// block of interleaved frames passed between pipeline threads
+typedef struct pipeline_block_t {
+    sf_count_t frames;                  // count of valid frames, 0 marks end of input
+    sample_t samples[];
+} pipeline_block_t;
+
+/* Decoding of input, processing of frames and writing of output. With pipeline depth
+ * greater than zero, reader and writer run on own threads and pass blocks of frames
+ * to the processing thread via SPSC rings, otherwise all is done serially.
+ */
+typedef struct pipeline_t {
+    at_ring_t input;                    // decoded frames, reader -> processor
+    at_ring_t output;                   // processed frames, processor -> writer
+    bool threaded;
+    pthread_t reader;
+    pthread_t writer;
+
+    SNDFILE *infile;
+    const at_pcm_map_t *map;            // mapped PCM input read instead of 'infile', may be NULL
+    sf_count_t position;                // next frame of mapped input
+    const sample_t *pushed;             // frames pushed into stream, read instead of 'infile' if not NULL
+    sf_count_t pushed_frames;           // count of pushed frames not read yet
+    SNDFILE *outfile;
+    at_pulse_t *pulse;
+    at_writer_t converter;              // conversion of output into sample format of file or PA server
+    at_resampler_t *resampler;          // conversion of output to another sample rate, may be NULL
+    sample_t *resampled[MAX_CHANNELS];  // output of resampler
+    void *out_data;                     // converted output of serial pipeline
+    int in_channels;
+    int out_samples;                    // count of samples per output frame
+    size_t window_size;
+    size_t nslide;
+    double tempo;                       // input is read with hop of phase vocoder
+    at_analysis_t *analysis;            // loudness and peaks of output, NULL if disabled
+
+    // timing counters of pipeline stages
+    int read_stat;
+    int write_stat;
+    int input_wait_stat;                // processing waits for reader
+    int output_wait_stat;               // processing waits for writer
+    int separate_stat;
+    int overlap_add_stat;
+    int convolve_stat;
+    int resample_stat;
+    int meter_stat;
+    int convert_stat;
+    int frame_stat;                     // whole processing of a frame
+} pipeline_t;
+
+// size of ring slot holding given count of samples
+static size_t pipeline_slot_size(size_t samples) {
+    size_t size = sizeof(pipeline_block_t) + sizeof(sample_t) * samples;
+
+    return (size + ARENA_ALIGNMENT - 1) & ~(size_t) (ARENA_ALIGNMENT - 1);
+}
+
+/* Place all buffers into arena. Called twice, first with measuring arena to get the total
+ * size and then with real one, so the loop itself never allocates. */
+static void layout_buffers(at_arena_t *arena, processor_buffers_t *buf, const processor_layout_t *layout) {
+    memset(buf, 0, sizeof(*buf));
+
+    buf->multi_data = at_arena_alloc(arena, sizeof(sample_t) * layout->window_size * layout->channels);
+    // frames of variable hop keep the whole previous frame of LFE channel
+    buf->lfe_tail = at_arena_alloc(arena, sizeof(sample_t) * (layout->tempo != 1.0 ? layout->window_size
+                                                                                    : MAX(layout->noverlap, 1)));
+    buf->out_data = at_arena_alloc(arena, sizeof(sample_t) * layout->out_frames * layout->out_channels);
+
+    /* input channels are mixed in place into output ones, frame has buffers for both of them;
+     * stages following mixing process only output channels */
+    at_init_buffer(&buf->td, at_arena_alloc(arena, sizeof(sample_t) * layout->fft_size * layout->channels),
+                   layout->channels, layout->window_size, layout->fft_size, layout->samplerate);
+    buf->td.used_channels = layout->out_channels;
+    at_init_buffer(&buf->old, at_arena_alloc(arena, sizeof(sample_t) * MAX(layout->noverlap, 1) *
+                                                    layout->out_channels),
+                   layout->out_channels, layout->noverlap, MAX(layout->noverlap, 1), layout->samplerate);
+
+    if (layout->fft) {
+        size_t spectrum_size = SPECTRUM_SIZE(layout->fft_size);
+
+        at_init_buffer(&buf->fd, at_arena_alloc(arena, sizeof(sample_t) * spectrum_size * layout->out_channels),
+                       layout->out_channels, layout->fft_size, spectrum_size, layout->samplerate);
+
+        for (int i = 0; i < layout->threads && layout->threads > 1; i++)
+            buf->scratch[i] = at_arena_alloc(arena, sizeof(sample_t) * FFT_SCRATCH_SIZE(layout->fft_size));
+    }
+
+    if (layout->resample)
+        buf->resampled = at_arena_alloc(arena, sizeof(sample_t) * layout->out_frames * layout->out_channels);
+
+    if (layout->depth > 0) {
+        buf->input_slots = at_arena_alloc(arena, layout->depth *
+                                                 pipeline_slot_size(layout->window_size * layout->in_channels));
+        buf->output_slots = at_arena_alloc(arena, layout->depth *
+                                                  pipeline_slot_size(layout->out_frames * layout->channels));
+    }
+}
+
+// write converted frames into output file or play them via PA server
+static void sink_write(pipeline_t *p, const void *data, sf_count_t frames) {
+    AT_STATS_BEGIN(start);
+
+    // check if output file was specified
+    if (p->outfile != NULL)
+        at_writer_write(&p->converter, p->outfile, data, frames);
+    else
+        /* play content of buffer via PA server, writer converts it into float */
+        at_pulse_write(p->pulse, data, (size_t) frames * p->out_samples);
+    AT_STATS_END(p->write_stat, start);
+}
+
+// read frames from input file, or convert them from mapped input
+static sf_count_t source_read(pipeline_t *p, sample_t *data, sf_count_t frames) {
+    sf_count_t count;
+
+    AT_STATS_BEGIN(start);
+    if (p->map != NULL) {
+        count = at_pcm_map_read(p->map, p->position, data, frames);
+        p->position += count;
+    }
+    else if (p->pushed != NULL) {
+        count = MIN(frames, p->pushed_frames);
+        memcpy(data, p->pushed, sizeof(*data) * count * p->in_channels);
+        p->pushed += count * p->in_channels;
+        p->pushed_frames -= count;
+    }
+    else
+        count = sf_readf_sample(p->infile, data, frames);
+    AT_STATS_END(p->read_stat, start);
+
+    return count;
+}
+
+/* reader thread: first frame is read whole, then only its non-overlapping part; hops are
+ * computed the same way as by processing thread */
+static void *pipeline_reader(void *arg) {
+    pipeline_t *p = arg;
+    sf_count_t frames = (sf_count_t) p->window_size;
+    sf_count_t count;
+    double hop_error = 0;
+
+    do {
+        pipeline_block_t *block = at_ring_acquire_write(&p->input);
+        count = block->frames = source_read(p, block->samples, frames);
+        at_ring_commit_write(&p->input);
+        frames = (sf_count_t) at_vocoder_hop(p->tempo, p->nslide, &hop_error);
+    } while (count > 0);
+
+    return NULL;
+}
+
+// writer thread: output blocks are written until end marker
+static void *pipeline_writer(void *arg) {
+    pipeline_t *p = arg;
+
+    while (true) {
+        pipeline_block_t *block = at_ring_acquire_read(&p->output);
+
+        if (block->frames == 0) {
+            at_ring_release_read(&p->output);
+            break;
+        }
+
+        sink_write(p, block->samples, block->frames);
+        at_ring_release_read(&p->output);
+    }
+
+    return NULL;
+}
+
+static void pipeline_start(pipeline_t *p, const processor_buffers_t *buf, const processor_layout_t *layout) {
+    p->threaded = layout->depth > 0;
+    if (!p->threaded)
+        return;
+
+    at_ring_init(&p->input, buf->input_slots, (size_t) layout->depth,
+                 pipeline_slot_size(layout->window_size * layout->in_channels));
+    at_ring_init(&p->output, buf->output_slots, (size_t) layout->depth,
+                 pipeline_slot_size(layout->out_frames * layout->channels));
+
+    // mapped input is converted by processing thread, it needs no reader
+    if ((p->map == NULL && pthread_create(&p->reader, NULL, pipeline_reader, p) != 0) ||
+        pthread_create(&p->writer, NULL, pipeline_writer, p) != 0) {
+        fprintf(stderr, "Error: Unable to start pipeline thread.\n");
+        exit(1);
+    }
+}
+
+// read given count of frames into 'data'; returns count of frames really read
+static sf_count_t pipeline_read(pipeline_t *p, sample_t *data, sf_count_t frames) {
+    if (!p->threaded || p->map != NULL)
+        return source_read(p, data, frames);
+
+    AT_STATS_BEGIN(start);
+    pipeline_block_t *block = at_ring_acquire_read(&p->input);
+    AT_STATS_END(p->input_wait_stat, start);
+    sf_count_t count = block->frames;
+
+    if (count > 0)
+        memcpy(data, block->samples, sizeof(*data) * count * p->in_channels);
+    at_ring_release_read(&p->input);
+
+    return count;
+}
+
+/* Convert frames of channel buffers at final rate straight into sample format of output and
+ * write them, or pass them to writer thread. Dither of frame depends only on its 'position'. */
+static void pipeline_output(pipeline_t *p, sample_t *const *channels, sf_count_t frames, sf_count_t position) {
+    void *data = p->out_data;
+    pipeline_block_t *block = NULL;
+
+    // output is measured at its final rate, before conversion
+    if (p->analysis != NULL) {
+        AT_STATS_BEGIN(meter_start);
+        at_analysis_samples(p->analysis, channels, (size_t) frames);
+        AT_STATS_END(p->meter_stat, meter_start);
+    }
+
+    // output of analysis is neither written nor played
+    if (p->outfile == NULL && p->pulse == NULL)
+        return;
+
+    if (p->threaded) {
+        AT_STATS_BEGIN(start);
+        block = at_ring_acquire_write(&p->output);
+        AT_STATS_END(p->output_wait_stat, start);
+        block->frames = frames;
+        data = block->samples;
+    }
+
+    AT_STATS_BEGIN(convert_start);
+    at_writer_seed(&p->converter, (uint64_t) position);
+    at_writer_convert(&p->converter, data, channels, (size_t) frames);
+    AT_STATS_END(p->convert_stat, convert_start);
+
+    if (block != NULL)
+        at_ring_commit_write(&p->output);
+    else
+        sink_write(p, data, frames);
+}
+
+// write processed frames of channel buffers, output is resampled before conversion
+static void pipeline_write(pipeline_t *p, sample_t *const *channels, sf_count_t frames, sf_count_t position) {
+    // resampler keeps its state across frames
+    if (p->resampler != NULL) {
+        AT_STATS_BEGIN(resample_start);
+        frames = (sf_count_t) at_resampler_process(p->resampler, channels, (size_t) frames, p->resampled);
+        channels = p->resampled;
+        AT_STATS_END(p->resample_stat, resample_start);
+    }
+
+    pipeline_output(p, channels, frames, position);
+}
+
+// write output still held by resampler at end of input
+static void pipeline_flush(pipeline_t *p, sf_count_t position) {
+    if (p->resampler == NULL)
+        return;
+
+    AT_STATS_BEGIN(resample_start);
+    sf_count_t frames = (sf_count_t) at_resampler_flush(p->resampler, p->resampled);
+    AT_STATS_END(p->resample_stat, resample_start);
+
+    if (frames > 0)
+        pipeline_output(p, p->resampled, frames, position);
+}
+
+// wait until all output is written and stop pipeline threads
+static void pipeline_finish(pipeline_t *p) {
+    if (!p->threaded)
+        return;
+
+    pipeline_block_t *block = at_ring_acquire_write(&p->output);
+    block->frames = 0;
+    at_ring_commit_write(&p->output);
+
+    if (p->map == NULL)
+        pthread_join(p->reader, NULL);
+    pthread_join(p->writer, NULL);
+
+    at_ring_destroy(&p->input);
+    at_ring_destroy(&p->output);
+}
+
+// frames of one processing thread: buffers, processing graph and state of LFE filter
+typedef struct frame_processor_t {
+    processor_layout_t layout;
+    processor_buffers_t buf;
+    stage_params_t params;
+    at_mix_t mix;
+    at_lfe_t lfe;
+    at_vocoder_t vocoder;
+    at_stage_graph_t graph;
+    at_pool_t *pool;                    // per-channel transforms on worker threads, may be NULL
+    at_fft_batch_t *fft_batch;          // batched transform of all channels, may be NULL
+    at_convolver_t *convolver;          // convolution of output channels with impulse response, may be NULL
+    bool planar;                        // frames are converted straight into channel buffers
+    audio_container_t out;              // channel buffers of processed frame in order of output
+} frame_processor_t;
+
+// build processing graph of frames
+static void frame_processor_graph(frame_processor_t *proc, int in_channels, size_t window_size, double tempo) {
+    // matrix of user replaces default mixing of input layout into output one
+    if (at_mix_init(&proc->mix, in_channels, at_get_out_channels(), at_get_lfe_only_setting()) < 0 &&
+        at_get_mix_matrix() == NULL) {
+        fprintf(stderr, "Error: No default mixing of %d into %d channels, set a matrix by --mix-matrix.\n",
+                in_channels, at_get_out_channels());
+        exit(1);
+    }
+    if (at_get_mix_matrix() != NULL)
+        at_mix_load(&proc->mix, at_get_mix_matrix());
+
+    proc->params.mix = &proc->mix;
+    proc->params.lfe = &proc->lfe;
+    proc->params.window_size = window_size;
+    proc->params.volume = at_get_volume();
+
+    // window table is computed before processing loop
+    proc->params.window = at_window_get(at_get_window_type(), window_size, at_get_kaiser_beta());
+
+    at_stage_graph_init(&proc->graph);
+
+    // input channels are mixed into channels of output layout in a single pass
+    at_stage_graph_add(&proc->graph, "mix", AT_STAGE_TIME_DOMAIN, stage_mix, &proc->params);
+
+    // if volume change was set, apply new volume setting
+    if (proc->params.volume != 1.0)
+        at_stage_graph_add(&proc->graph, "gain", AT_STAGE_TIME_DOMAIN, stage_gain, &proc->params);
+
+    // apply window function to data
+    at_stage_graph_add(&proc->graph, "window", AT_STAGE_TIME_DOMAIN, stage_window, &proc->params);
+
+    // identity spectral stage keeps the FFT/IFFT round trip of frames
+    if (at_get_spectral_passthrough())
+        at_stage_graph_add(&proc->graph, "passthrough", AT_STAGE_FREQ_DOMAIN, stage_passthrough, &proc->params);
+
+    // phase vocoder changes tempo, its frames are weighted by synthesis window before overlap-add
+    if (tempo != 1.0)
+        at_stage_graph_add(&proc->graph, "vocoder", AT_STAGE_FREQ_DOMAIN, stage_vocoder, &proc->params);
+
+    // spectra are only read by analysis, frames without spectral processing skip IFFT
+    if (proc->params.analysis != NULL)
+        at_stage_graph_add(&proc->graph, "analysis", AT_STAGE_FREQ_OBSERVE, stage_analysis, &proc->params);
+
+    if (tempo != 1.0)
+        at_stage_graph_add(&proc->graph, "synthesis", AT_STAGE_TIME_DOMAIN, stage_synthesis, &proc->params);
+}
+
+// place buffers into arena, which is reused if it is large enough, and prepare LFE filter and transforms
+static void frame_processor_init(frame_processor_t *proc, at_arena_t *arena, const processor_layout_t *layout) {
+    at_arena_t measure;
+
+    proc->layout = *layout;
+
+    at_arena_init_measure(&measure);
+    layout_buffers(&measure, &proc->buf, layout);
+
+    if (arena->size < measure.used) {
+        at_arena_free(arena);
+        at_arena_init(arena, measure.used);
+    }
+    else
+        at_arena_reset(arena);
+    layout_buffers(arena, &proc->buf, layout);
+
+    // streaming low-pass filter for LFE channel, its state is carried over frames
+    at_lfe_init(&proc->lfe, layout->samplerate, layout->window_size, layout->noverlap, proc->buf.lfe_tail);
+
+    // analysis hop of phase vocoder varies, frames are overlap-added with 'nslide'
+    proc->params.vocoder = NULL;
+    proc->params.hop = layout->nslide;
+    if (layout->tempo != 1.0) {
+        at_vocoder_init(&proc->vocoder, layout->tempo, layout->window_size, (int) layout->fft_size, layout->nslide,
+                        proc->params.window, layout->out_channels);
+        proc->params.vocoder = &proc->vocoder;
+    }
+
+    // spread per-channel transforms over worker threads, or transform all channels by one batched plan
+    proc->pool = NULL;
+    proc->fft_batch = NULL;
+    if (layout->fft) {
+        if (layout->threads > 1) {
+            // worker threads share global plans of FFT library
+            at_fftw_init((int) layout->fft_size);
+            proc->pool = at_pool_create(layout->threads);
+            at_stage_graph_set_pool(&proc->graph, proc->pool, proc->buf.scratch);
+        }
+        else {
+            proc->fft_batch = at_fftw_plan_batch(&proc->buf.td, &proc->buf.fd);
+            at_stage_graph_set_batch(&proc->graph, proc->fft_batch);
+        }
+    }
+
+    // partitions of impulse response are as long as output of a frame
+    proc->convolver = NULL;
+    if (layout->impulse_response != NULL) {
+        proc->convolver = at_malloc(sizeof(*proc->convolver));
+        at_convolver_load(proc->convolver, layout->impulse_response, layout->out_channels, layout->nslide,
+                          layout->samplerate);
+    }
+}
+
+static void frame_processor_free(frame_processor_t *proc) {
+    if (proc->params.vocoder != NULL)
+        at_vocoder_free(proc->params.vocoder);
+    at_stage_graph_free(&proc->graph);
+    at_pool_free(proc->pool);
+    at_fftw_free_batch(proc->fft_batch);
+
+    if (proc->convolver != NULL) {
+        at_convolver_free(proc->convolver);
+        free(proc->convolver);
+    }
+}
+
+/* Read next frame into interleaved buffer; the first frame is read whole, following ones
+ * only their non-overlapping part of 'hop' frames. Frames of mapped input are converted
+ * straight into channel buffers instead. Frames behind the end of input are zero. Returns
+ * count of frames really read. */
+static sf_count_t frame_processor_read(frame_processor_t *proc, pipeline_t *p, bool first, size_t hop) {
+    const processor_layout_t *layout = &proc->layout;
+    sample_t *multi_data = proc->buf.multi_data;
+    size_t window_size = layout->window_size;
+    size_t keep = first ? 0 : window_size - hop;      // frames shared with previous frame
+    int channels = layout->in_channels;
+    sf_count_t count;
+
+    // overlap of frames read by phase vocoder varies, LFE filter keeps the whole previous frame
+    proc->params.hop = hop;
+    if (proc->params.vocoder != NULL)
+        at_lfe_set_overlap(&proc->lfe, keep);
+
+    if (p->map != NULL) {
+        sf_count_t start = p->position - (sf_count_t) keep;
+        sf_count_t end = MIN(start + (sf_count_t) window_size, MAX(p->map->frames, start));
+        size_t available = (size_t) (end - start);
+
+        AT_STATS_BEGIN(start_time);
+        at_pcm_map_deinterleave(p->map, start, proc->buf.td.channel, available);
+        for (int i = 0; i < channels && available < window_size; i++)
+            memset(proc->buf.td.channel[i] + available, 0, sizeof(sample_t) * (window_size - available));
+        AT_STATS_END(p->read_stat, start_time);
+
+        count = MAX(end - p->position, 0);
+        p->position = start + (sf_count_t) window_size;
+        proc->planar = true;
+        return count;
+    }
+
+    // overlap of previous frame is moved to the beginning, the rest is read
+    memmove(multi_data, multi_data + (window_size - keep) * channels, sizeof(*multi_data) * keep * channels);
+    count = pipeline_read(p, multi_data + keep * channels, (sf_count_t) (window_size - keep));
+    memset(multi_data + (keep + count) * channels, 0, sizeof(*multi_data) * (window_size - keep - count) * channels);
+
+    return count;
+}
+
+// separate channels of interleaved frame, unless it was converted straight into channel buffers
+static void frame_processor_separate(frame_processor_t *proc) {
+    if (!proc->planar)
+        at_separate_channels(proc->buf.multi_data, &proc->buf.td, proc->layout.in_channels);
+}
+
+// process frame, 'nslide' output frames are left at the beginning of channel buffers of 'proc->out'
+static void frame_processor_run(frame_processor_t *proc, const pipeline_t *p) {
+    const processor_layout_t *layout = &proc->layout;
+    audio_container_t *audio_data_td = &proc->buf.td;
+    audio_container_t *audio_data_old = &proc->buf.old;
+    size_t noverlap = layout->noverlap, nslide = layout->nslide;
+
+    // separate channels to at_container struct
+    AT_STATS_BEGIN(separate_start);
+    frame_processor_separate(proc);
+    AT_STATS_END(p->separate_stat, separate_start);
+
+    // run processing stages; FFT and IFFT are done only for frequency domain stages
+    at_stage_graph_run(&proc->graph, audio_data_td, &proc->buf.fd, layout->window_size);
+
+    AT_STATS_BEGIN(overlap_start);
+    for (int i = 0; i < audio_data_td->used_channels; i++) {
+        sample_t *frame = audio_data_td->channel[i], *tail = audio_data_old->channel[i];
+        size_t shared = noverlap > nslide ? noverlap - nslide : 0;
+
+        // output part of frame gets tails of all previous frames overlapping it
+        for (size_t j = 0; j < MIN(nslide, noverlap); j++)
+            frame[j] += tail[j];
+
+        // tails are shifted by a hop, the rest of frame is added to them
+        for (size_t j = 0; j < shared; j++)
+            tail[j] = tail[j + nslide] + frame[j + nslide];
+        for (size_t j = shared; j < noverlap; j++)
+            tail[j] = frame[j + nslide];
+    }
+    AT_STATS_END(p->overlap_add_stat, overlap_start);
+
+    // channels of frame are in order of output since mixing, writer interleaves them
+    proc->out = *audio_data_td;
+
+    // output of frame is the next block of convolution
+    if (proc->convolver != NULL) {
+        AT_STATS_BEGIN(convolve_start);
+        at_convolver_process(proc->convolver, proc->out.channel);
+        AT_STATS_END(p->convolve_stat, convolve_start);
+    }
+}
+
+/* Segment-parallel processing of a single seekable file. Frames are grouped into segments
+ * of SEGMENT_FRAMES frames, which are taken in order by worker threads, each with its own
+ * input handle, buffers and FFT plan. Overlap-add joins only frames sharing some samples,
+ * so state of a segment is restored by processing at least SEGMENT_WARMUP frames before it;
+ * their output is dropped. State of LFE filter depends on all previous input, it is computed
+ * by a scanner thread running only mixing and LFE filter ahead of workers. Processed segments
+ * are kept in a window of slots and written into output in order by the calling thread, so
+ * output is identical to serial processing.
+ */
+
+#define SEGMENT_FRAMES    256                   // count of frames of a segment
+#define SEGMENT_WARMUP    2                     // min. count of frames processed before a segment to restore its state
+
+// output of a segment waiting to be written
+typedef struct segment_slot_t {
+    int segment;                        // segment stored in slot, -1 if slot is free
+    bool done;                          // segment was processed
+    sf_count_t frames;                  // count of output frames in buffer
+    unsigned char *data;                // frames converted into sample format of output
+} segment_slot_t;
+
+typedef struct segment_job_t {
+    const char *path;                   // input is opened again by each thread
+    const at_pcm_map_t *map;            // mapped input shared by all threads, may be NULL
+    SNDFILE *outfile;
+    at_writer_t writer;                 // sample format of output shared by writers of threads
+    processor_layout_t layout;
+    int segments;                       // count of segments
+    int warmup;                         // count of frames processed before a segment
+    int slot_count;
+    segment_slot_t *slots;
+    sf_count_t slot_frames;             // capacity of a slot in frames
+
+    bool lfe_scan;                      // LFE filter is active, its state is passed to segments
+    at_lfe_t *lfe_states;               // state of LFE filter before warm-up of each segment
+    sample_t *lfe_tails;                // filtered overlap kept by each of states
+
+    // progress, guarded by lock
+    int next;                           // next segment to be taken by a worker
+    int scanned;                        // count of segments with known state of LFE filter
+    int written;                        // count of segments written into output
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+} segment_job_t;
+
+typedef struct segment_worker_t {
+    segment_job_t *job;
+    frame_processor_t proc;
+    at_arena_t arena;
+    pipeline_t pipeline;                // serial reading of own input handle and conversion of output
+    pthread_t thread;
+} segment_worker_t;
+
+// first frame processed for segment, including warm-up
+static sf_count_t segment_warmup_frame(const segment_job_t *job, int segment) {
+    return MAX((sf_count_t) segment * SEGMENT_FRAMES - job->warmup, 0);
+}
+
+static SNDFILE *segment_open(const char *path) {
+    SF_INFO info;
+    SNDFILE *file;
+
+    memset(&info, 0, sizeof(info));
+
+    if ((file = sf_open(path, SFM_READ, &info)) == NULL) {
+        fprintf(stderr, "Error: Unable to open input file '%s': %s\n", path, sf_strerror(NULL));
+        exit(1);
+    }
+
+    return file;
+}
+
+// scanner thread: mixing and LFE filter run over input, state is stored before warm-up of each segment
+static void *segment_scanner(void *arg) {
+    segment_worker_t *w = arg;
+    segment_job_t *job = w->job;
+    frame_processor_t *proc = &w->proc;
+    size_t noverlap = job->layout.noverlap;
+
+    for (sf_count_t frame = 0; ; frame++) {
+        int segment = job->scanned;
+
+        if (segment_warmup_frame(job, segment) == frame) {
+            job->lfe_states[segment] = proc->lfe;
+            memcpy(job->lfe_tails + segment * noverlap, proc->lfe.tail, sizeof(sample_t) * noverlap);
+
+            pthread_mutex_lock(&job->lock);
+            job->scanned++;
+            pthread_cond_broadcast(&job->changed);
+            pthread_mutex_unlock(&job->lock);
+
+            if (job->scanned == job->segments)
+                break;
+        }
+
+        frame_processor_read(proc, &w->pipeline, frame == 0, job->layout.nslide);
+        frame_processor_separate(proc);
+        stage_mix(&proc->buf.td, &proc->params);
+    }
+
+    return NULL;
+}
+
+// pass output of segment to writer; if slot is full, worker waits for its turn and writes it itself
+static void segment_output(segment_worker_t *w, int segment, segment_slot_t *slot, sf_count_t frame) {
+    segment_job_t *job = w->job;
+    size_t frame_size = at_writer_sample_size(job->writer.format) * job->layout.out_channels;
+
+    if (slot->frames + (sf_count_t) job->layout.nslide > job->slot_frames) {
+        pthread_mutex_lock(&job->lock);
+        while (job->written < segment)
+            pthread_cond_wait(&job->changed, &job->lock);
+        pthread_mutex_unlock(&job->lock);
+
+        at_writer_write(&job->writer, job->outfile, slot->data, slot->frames);
+        slot->frames = 0;
+    }
+
+    // dither is seeded by position of frame, as in serial processing
+    at_writer_seed(&w->pipeline.converter, (uint64_t) frame);
+    at_writer_convert(&w->pipeline.converter, slot->data + slot->frames * frame_size, w->proc.out.channel,
+                      job->layout.nslide);
+    slot->frames += (sf_count_t) job->layout.nslide;
+}
+
+static void segment_process(segment_worker_t *w, int segment, segment_slot_t *slot) {
+    segment_job_t *job = w->job;
+    frame_processor_t *proc = &w->proc;
+    processor_buffers_t *buf = &proc->buf;
+    const processor_layout_t *layout = &job->layout;
+    sf_count_t first = (sf_count_t) segment * SEGMENT_FRAMES;
+    sf_count_t start = segment_warmup_frame(job, segment);
+    bool last = segment == job->segments - 1;
+
+    // overlap-add is restored by warm-up frames
+    memset(buf->old.data, 0, sizeof(sample_t) * buf->old.stride * buf->old.used_channels);
+
+    if (start == 0 || !job->lfe_scan)
+        at_lfe_init(&proc->lfe, layout->samplerate, layout->window_size, layout->noverlap, buf->lfe_tail);
+    else {
+        proc->lfe = job->lfe_states[segment];
+        proc->lfe.tail = buf->lfe_tail;
+        memcpy(buf->lfe_tail, job->lfe_tails + segment * layout->noverlap, sizeof(sample_t) * layout->noverlap);
+    }
+
+    if (w->pipeline.map != NULL)
+        w->pipeline.position = start * (sf_count_t) layout->nslide;
+    else if (sf_seek(w->pipeline.infile, start * (sf_count_t) layout->nslide, SEEK_SET) < 0) {
+        fprintf(stderr, "Error: Unable to seek in input file '%s'.\n", job->path);
+        exit(1);
+    }
+
+    // last segment runs until the end of input, as serial processing does
+    for (sf_count_t frame = start; last || frame < first + SEGMENT_FRAMES; frame++) {
+        sf_count_t count = frame_processor_read(proc, &w->pipeline, frame == start, layout->nslide);
+
+        frame_processor_run(proc, &w->pipeline);
+
+        if (frame >= first)
+            segment_output(w, segment, slot, frame);
+
+        if (count <= 0)
+            break;
+    }
+}
+
+// worker thread: segments are taken in order, each of them waits for free slot and state of LFE filter
+static void *segment_worker(void *arg) {
+    segment_worker_t *w = arg;
+    segment_job_t *job = w->job;
+
+    while (true) {
+        pthread_mutex_lock(&job->lock);
+        int segment = job->next++;
+        segment_slot_t *slot = &job->slots[segment % job->slot_count];
+
+        while (segment < job->segments &&
+               (job->written <= segment - job->slot_count || (job->lfe_scan && job->scanned <= segment)))
+            pthread_cond_wait(&job->changed, &job->lock);
+
+        if (segment >= job->segments) {
+            pthread_mutex_unlock(&job->lock);
+            break;
+        }
+
+        slot->segment = segment;
+        slot->done = false;
+        slot->frames = 0;
+        pthread_mutex_unlock(&job->lock);
+
+        segment_process(w, segment, slot);
+
+        pthread_mutex_lock(&job->lock);
+        slot->done = true;
+        pthread_cond_broadcast(&job->changed);
+        pthread_mutex_unlock(&job->lock);
+    }
+
+    return NULL;
+}
+
+// set up frame processor of worker or scanner with own input handle or position in mapped input
+static void segment_worker_init(segment_worker_t *w, segment_job_t *job, bool scanner) {
+    processor_layout_t layout = job->layout;
+
+    memset(w, 0, sizeof(*w));
+    w->job = job;
+
+    frame_processor_graph(&w->proc, layout.in_channels, layout.window_size, layout.tempo);
+    if (scanner)
+        layout.fft = false;
+    frame_processor_init(&w->proc, &w->arena, &layout);
+
+    w->pipeline.map = job->map;
+    if (job->map == NULL)
+        w->pipeline.infile = segment_open(job->path);
+    w->pipeline.in_channels = layout.in_channels;
+    at_writer_init(&w->pipeline.converter, job->writer.format, layout.out_channels, job->writer.dither);
+    w->pipeline.read_stat = -1;
+    w->pipeline.separate_stat = -1;
+    w->pipeline.overlap_add_stat = -1;
+    w->pipeline.convolve_stat = -1;
+    w->pipeline.resample_stat = -1;
+    w->pipeline.convert_stat = -1;
+}
+
+static void segment_worker_free(segment_worker_t *w) {
+    if (w->pipeline.infile != NULL)
+        sf_close(w->pipeline.infile);
+    frame_processor_free(&w->proc);
+    at_arena_free(&w->arena);
+}
+
+/* Process 'frames' frames of input by 'threads' workers, output is converted into format
+ * of 'writer', which also gets counts of clipped samples. Returns false if input is too
+ * short to be split. */
+static bool segment_processor(SNDFILE *outfile, at_writer_t *writer, const at_pcm_map_t *map,
+                              const processor_layout_t *layout, sf_count_t frames, int threads) {
+    segment_job_t job;
+    int segments = (int) (frames / SEGMENT_FRAMES);
+
+    // the last segment takes the rest of input, it is never shorter than others
+    if (segments < 2)
+        return false;
+
+    threads = MIN(threads, segments);
+
+    memset(&job, 0, sizeof(job));
+    job.path = at_get_in_file();
+    job.map = map;
+    job.outfile = outfile;
+    job.writer = *writer;
+    job.layout = *layout;
+    job.segments = segments;
+    job.warmup = (int) MAX((layout->noverlap + layout->nslide - 1) / layout->nslide, SEGMENT_WARMUP);
+    job.slot_count = 2 * threads;
+    job.slot_frames = SEGMENT_FRAMES * (sf_count_t) layout->nslide;
+    job.slots = at_malloc(sizeof(*job.slots) * job.slot_count);
+
+    job.scanned = 1;
+
+    for (int i = 0; i < job.slot_count; i++) {
+        job.slots[i].segment = -1;
+        job.slots[i].data = at_malloc((size_t) job.slot_frames * layout->out_channels *
+                                      at_writer_sample_size(writer->format));
+    }
+
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.changed, NULL);
+
+    // workers are set up before threads start
+    segment_worker_t *workers = at_malloc(sizeof(*workers) * (threads + 1));
+    segment_worker_t *scanner = &workers[threads];
+
+    for (int i = 0; i < threads; i++)
+        segment_worker_init(&workers[i], &job, false);
+
+    // LFE filter runs only if mixing creates LFE channel
+    job.lfe_scan = workers[0].proc.mix.lfe >= 0;
+
+    if (job.lfe_scan) {
+        job.lfe_states = at_malloc(sizeof(*job.lfe_states) * segments);
+        job.lfe_tails = init_buffer_sample(layout->noverlap * segments);
+        segment_worker_init(scanner, &job, true);
+
+        if (pthread_create(&scanner->thread, NULL, segment_scanner, scanner) != 0) {
+            fprintf(stderr, "Error: Unable to start segment thread.\n");
+            exit(1);
+        }
+    }
+
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&workers[i].thread, NULL, segment_worker, &workers[i]) != 0) {
+            fprintf(stderr, "Error: Unable to start segment thread.\n");
+            exit(1);
+        }
+    }
+
+    // segments are written in order as soon as they are processed
+    sf_count_t frames_written = 0;
+
+    for (int segment = 0; segment < segments; segment++) {
+        segment_slot_t *slot = &job.slots[segment % job.slot_count];
+
+        pthread_mutex_lock(&job.lock);
+        while (slot->segment != segment || !slot->done)
+            pthread_cond_wait(&job.changed, &job.lock);
+        pthread_mutex_unlock(&job.lock);
+
+        at_writer_write(writer, outfile, slot->data, slot->frames);
+        frames_written += slot->frames;
+
+        pthread_mutex_lock(&job.lock);
+        slot->segment = -1;
+        job.written++;
+        pthread_cond_broadcast(&job.changed);
+        pthread_mutex_unlock(&job.lock);
+
+        printf("Time: %s", show_time(layout->samplerate, (int) frames_written));
+        puts("\033[1A");
+    }
+
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        writer->samples += workers[i].pipeline.converter.samples;
+        writer->clipped += workers[i].pipeline.converter.clipped;
+        segment_worker_free(&workers[i]);
+    }
+
+    if (job.lfe_scan) {
+        pthread_join(scanner->thread, NULL);
+        segment_worker_free(scanner);
+        free(job.lfe_states);
+        free(job.lfe_tails);
+    }
+
+    for (int i = 0; i < job.slot_count; i++)
+        free(job.slots[i].data);
+    free(job.slots);
+    free(workers);
+
+    pthread_mutex_destroy(&job.lock);
+    pthread_cond_destroy(&job.changed);
+
+    // insert new line
+    puts("\n");
+
+    return true;
+}
+
+// map input file if it is a PCM file and libsndfile agrees on its format; NULL otherwise
+static at_pcm_map_t *input_map_open(const SF_INFO *info) {
+    const char *path = at_get_in_file();
+    at_pcm_map_t *map;
+
+    if (!at_get_mmap_input() || path == NULL || strcmp(path, "-") == 0 || (map = at_pcm_map_open(path)) == NULL)
+        return NULL;
+
+    if (map->channels != info->channels || map->samplerate != info->samplerate || map->frames != info->frames) {
+        at_pcm_map_close(map);
+        return NULL;
+    }
+
+    return map;
+}
+
+// report samples saturated by conversion into output format
+static void print_clipping(const at_writer_t *writer) {
+    if (writer->clipped > 0)
+        printf("Warning: %llu of %llu output samples clipped (%.4f %%).\n", (unsigned long long) writer->clipped,
+               (unsigned long long) writer->samples, 100.0 * writer->clipped / writer->samples);
+}
+
+/* Rate of resampled output; native rate of PA sink is used only for playback.
+ * Returns 0 if output is not resampled. */
+static int output_resample_rate(int output_samplerate) {
+    int rate = at_get_resample_rate();
+
+    if (rate == RESAMPLE_NATIVE) {
+        if (at_get_out_file() != NULL) {
+            puts("Native sample rate is known only for playback, output is not resampled.");
+            return 0;
+        }
+
+        if ((rate = at_pulse_native_rate()) <= 0) {
+            puts("Unable to get native sample rate of PulseAudio sink, output is not resampled.");
+            return 0;
+        }
+
+        printf("Native sample rate of PulseAudio sink: %d Hz\n", rate);
+    }
+
+    return rate == output_samplerate ? 0 : rate;
+}
 
 sf_count_t at_audio_processor(SNDFILE *infile, SNDFILE *outfile) {
-    sf_count_t count = 0, frames_read = 0;
+    sf_count_t count = 0, frames_read = 0, frame = 0;
     SF_INFO info;
-    pa_simple *pa_server = NULL;
+    at_pulse_t *pulse = NULL;
     size_t noverlap, nslide;
-    double *multi_data, *prev_multi_data;
     size_t window_size = 0;
     int fft_size = 0;
-    int pa_error;
-    float *pulse_data = NULL;
 
     sf_command(infile, SFC_GET_CURRENT_SF_INFO, &info, sizeof(info));
 
+    // uncompressed PCM input is converted straight from mapped file, bypassing libsndfile
+    at_pcm_map_t *map = input_map_open(&info);
+
     // compute correction in output sampling frequency
     int input_samplerate = info.samplerate;
     int output_samplerate = (int) (floor(info.samplerate * at_get_playback_speed()));
@@ -51,166 +1060,472 @@ sf_count_t at_audio_processor(SNDFILE *infile, SNDFILE *outfile) {
     noverlap = (size_t) floor(window_size * at_get_overlap() / 100);
     nslide = window_size - noverlap;
 
-    multi_data = init_buffer_dbl(window_size * max_channel_count);
-    prev_multi_data = init_buffer_dbl(noverlap * max_channel_count);
+    // output is resampled to requested rate, or to native rate of PA sink during playback
+    int resample_rate = output_resample_rate(output_samplerate);
+    at_resampler_t resampler;
+
+    if (resample_rate > 0 && at_resampler_init(&resampler, output_samplerate, resample_rate, at_get_out_channels(),
+                                               at_get_resample_quality(), nslide) < 0)
+        resample_rate = 0;
+
+    // output of a frame, or of resampler flushed at end of input
+    size_t out_frames = nslide;
+
+    if (resample_rate > 0)
+        out_frames = at_resampler_max_output(&resampler, MAX(nslide, (size_t) resampler.taps / 2));
+
+    // size all buffers of processing session at once and place them into a single arena
+    processor_layout_t layout = {
+            .window_size = window_size,
+            .noverlap = noverlap,
+            .nslide = nslide,
+            .out_frames = out_frames,
+            .fft_size = (size_t) fft_size,
+            .tempo = at_get_tempo(),
+            .impulse_response = at_get_impulse_response(),
+            .channels = max_channel_count,
+            .out_channels = at_get_out_channels(),
+            .samplerate = input_samplerate,
+            .threads = at_get_threads(),
+            .pulse = at_get_out_file() == NULL && !at_get_analyze(),
+            .resample = resample_rate > 0,
+            .in_channels = info.channels,
+            .depth = at_get_pipeline_depth()
+    };
+    frame_processor_t proc;
+    pipeline_t pipeline;
+
+    memset(&proc, 0, sizeof(proc));
+    memset(&pipeline, 0, sizeof(pipeline));
+
+    // output is converted into sample format of output file, PA server gets float samples
+    at_writer_format_t out_format = AT_WRITER_FLOAT;
+
+    if (outfile != NULL) {
+        SF_INFO out_info;
+
+        sf_command(outfile, SFC_GET_CURRENT_SF_INFO, &out_info, sizeof(out_info));
+        out_format = at_writer_format(out_info.format);
+    }
 
-    // output file not specified, initialize sound server
-    if (at_get_out_file() == NULL) {
-        pa_server = at_pulse_init(at_get_out_channels(), output_samplerate);
-        pulse_data = malloc(sizeof(*pulse_data) * nslide * max_channel_count);
-        if (pulse_data == NULL) {
-            puts("malloc() failed. Exiting.");
-            exit(1);
+    at_writer_init(&pipeline.converter, out_format, layout.out_channels, at_get_dither());
+
+    // output written into file is processed by segments in parallel
+    if (at_get_segments() > 1 && !layout.pulse && (info.seekable || map != NULL)) {
+        if (resample_rate > 0)
+            puts("Segment-parallel processing does not support resampling, processing serially.");
+        else if (layout.tempo != 1.0)
+            puts("Segment-parallel processing does not support change of tempo, processing serially.");
+        else if (layout.impulse_response != NULL)
+            puts("Segment-parallel processing does not support convolution, processing serially.");
+        else if (at_get_analyze())
+            puts("Segment-parallel processing does not support analysis, processing serially.");
+        else {
+            processor_layout_t segment_layout = layout;
+            sf_count_t frames = 2 + (MAX(info.frames - (sf_count_t) window_size, 0) + nslide - 1) / nslide;
+
+            if (info.frames <= 0)
+                exit(1);
+
+            // graph of each segment is built only to find out if it needs FFT
+            frame_processor_graph(&proc, info.channels, window_size, layout.tempo);
+            segment_layout.fft = at_stage_graph_needs_fft(&proc.graph);
+            segment_layout.threads = 1;
+            segment_layout.depth = 0;
+            at_stage_graph_free(&proc.graph);
+
+            at_stats_enable(false);
+            if (segment_processor(outfile, &pipeline.converter, map, &segment_layout, frames, at_get_segments())) {
+                print_clipping(&pipeline.converter);
+                at_pcm_map_close(map);
+                return 0;
+            }
         }
     }
 
-    // initialize FFT library
-    at_fftw_init(fft_size);
+    // timing counters are registered in order of processing
+    at_stats_enable(at_get_stats());
+    pipeline.read_stat = at_stats_register("read");
+    pipeline.input_wait_stat = at_stats_register("input wait");
+    pipeline.separate_stat = at_stats_register("separate");
 
-    // internal representation for separated audio channels in time domain
-    audio_container_t *audio_data_td = at_allocate_buffer(at_get_out_channels(), window_size, input_samplerate);
+    // spectra of frames are analysed by a stage of processing graph
+    at_analysis_t analysis;
 
-    // internal representation for separated audio channels in frequency domain
-    audio_container_t *audio_data_fft = at_allocate_buffer(at_get_out_channels(), (size_t) fft_size, input_samplerate);
+    proc.params.analysis = at_get_analyze() ? &analysis : NULL;
 
-    // internal representation for data required for add-and-overlap method of audio reconstruction
-    audio_container_t *audio_data_old = at_allocate_buffer(at_get_out_channels(), nslide, input_samplerate);
+    // build processing graph
+    frame_processor_graph(&proc, info.channels, window_size, layout.tempo);
+
+    pipeline.overlap_add_stat = at_stats_register("overlap-add");
+    pipeline.convolve_stat = layout.impulse_response != NULL ? at_stats_register("convolve") : -1;
+    pipeline.resample_stat = resample_rate > 0 ? at_stats_register("resample") : -1;
+    pipeline.meter_stat = proc.params.analysis != NULL ? at_stats_register("meter") : -1;
+    pipeline.convert_stat = at_stats_register("convert");
+    pipeline.output_wait_stat = at_stats_register("output wait");
+    pipeline.write_stat = at_stats_register("write");
+    pipeline.frame_stat = at_stats_register("frame");
+
+    layout.fft = at_stage_graph_needs_fft(&proc.graph);
+    frame_processor_init(&proc, &session_arena, &layout);
+
+    // output is measured at rate of resampled output, frequencies of spectra are given by output rate
+    if (proc.params.analysis != NULL)
+        at_analysis_init(&analysis, layout.out_channels, at_mix_layout(layout.out_channels, at_get_lfe_only_setting()),
+                         resample_rate > 0 ? resample_rate : output_samplerate, fft_size, output_samplerate,
+                         proc.params.window, window_size);
+
+    // output file not specified, initialize sound server
+    if (layout.pulse)
+        pulse = at_pulse_open(at_get_out_channels(), resample_rate > 0 ? resample_rate : output_samplerate);
+
+    // decoding and output overlap with processing of frames
+    pipeline.infile = infile;
+    pipeline.map = map;
+    pipeline.outfile = at_get_out_file() ? outfile : NULL;
+    pipeline.pulse = pulse;
+    pipeline.out_data = proc.buf.out_data;
+    if (resample_rate > 0) {
+        pipeline.resampler = &resampler;
+        for (int i = 0; i < layout.out_channels; i++)
+            pipeline.resampled[i] = proc.buf.resampled + i * layout.out_frames;
+    }
+    pipeline.in_channels = info.channels;
+    pipeline.out_samples = at_get_out_channels();
+    pipeline.window_size = window_size;
+    pipeline.nslide = nslide;
+    pipeline.tempo = layout.tempo;
+    pipeline.analysis = proc.params.analysis;
+    pipeline_start(&pipeline, &proc.buf, &layout);
+
+#ifdef AT_STATS
+    // during playback, time spent on a frame is shown as a share of its duration
+    bool show_load = at_stats_enabled() && pulse != NULL;
+    double frame_period = 1e9 * nslide / input_samplerate;
+    uint64_t frame_time = 0;
+    uint64_t frames_processed = 0;
+    uint64_t wall_start = at_stats_now();
+#endif
+
+#ifdef AT_DEBUG_ALLOC
+    unsigned long alloc_count = at_get_alloc_count();
+#endif
 
     /* Implementation of Add-And-Overlap method for joining of adjacent audio frames;
      * overlap of frames is specified as a parameter in range <0 - 99>, default value
      * is overlap equal to 50 percent.
      */
 
+    // input of phase vocoder is read with analysis hop, output is overlap-added with 'nslide'
+    double hop_error = 0;
+
     do {
-        if (frames_read == 0) {
-            if ((count = sf_readf_double(infile, multi_data, (sf_count_t) window_size)) <= 0)
-                exit(1);
-            memcpy((void *) prev_multi_data, (void *) (multi_data + nslide * info.channels),
-                   sizeof(*multi_data) * noverlap * info.channels);
-        }
-        else {
-            count = sf_readf_double(infile, (multi_data + noverlap * info.channels), (sf_count_t) nslide);
-            memcpy((void *) multi_data, (void *) prev_multi_data, sizeof(*prev_multi_data) * noverlap * info.channels);
-            memcpy((void *) prev_multi_data, (void *) (multi_data + nslide * info.channels),
-                   sizeof(*multi_data) * noverlap * info.channels);
-        }
+        size_t hop = frames_read == 0 ? window_size : at_vocoder_hop(layout.tempo, nslide, &hop_error);
+
+        if ((count = frame_processor_read(&proc, &pipeline, frames_read == 0, hop)) <= 0 && frames_read == 0)
+            exit(1);
 
         frames_read += count;
 
         // print time into console
-        printf("Time: %s", show_time(input_samplerate, (int) frames_read));
+#ifdef AT_STATS
+        if (show_load)
+            printf("Time: %s  DSP load: %5.1f %%", show_time(input_samplerate, (int) frames_read),
+                   100.0 * frame_time / frame_period);
+        else
+#endif
+            printf("Time: %s", show_time(input_samplerate, (int) frames_read));
         puts("\033[1A");
 
-        // separate channels to at_container struct
-        at_separate_channels(multi_data, audio_data_td, info.channels);
-
-        // basic channel interleaving to create multichannel matrix
-        at_interleave_audio(audio_data_td, info.channels, fft_size);
+        AT_STATS_BEGIN(frame_start);
 
-        // if volume change was set, apply new volume setting
-        if (at_get_volume() != 1.0)
-            at_audio_gain(audio_data_td, at_get_volume());
+        frame_processor_run(&proc, &pipeline);
 
-        // apply window function to data
-        apply_window(audio_data_td, window_size);
+#ifdef AT_STATS
+        frame_time = at_stats_end(pipeline.frame_stat, frame_start);
+        frames_processed++;
+#endif
 
-        // FFT transform
-        for (int i = 0; i < MAX_CHANNELS; i++)
-            at_compute_fft(audio_data_td->channel[i], window_size, audio_data_fft->channel[i]);
+        // write output, or pass it to writer thread
+        pipeline_write(&pipeline, proc.out.channel, (sf_count_t) nslide, frame++);
+    } while (count > 0);
 
-        // inverse FFT transform
-        for (int i = 0; i < MAX_CHANNELS; i++) {
-            at_compute_ifft(audio_data_fft->channel[i], window_size, audio_data_td->channel[i]);
+    pipeline_flush(&pipeline, frame);
+    pipeline_finish(&pipeline);
 
-            // overlap
-            for (int j = 0; j < nslide; j++) {
-                audio_data_td->channel[i][j] += audio_data_old->channel[i][j];
-                audio_data_old->channel[i][j] = audio_data_td->channel[i][j + noverlap];
+#ifdef AT_STATS
+    uint64_t wall_time = at_stats_now() - wall_start;
+#endif
 
-            }
-        }
+#ifdef AT_DEBUG_ALLOC
+    if (at_get_alloc_count() != alloc_count)
+        fprintf(stderr, "Warning: %lu allocations done in processing loop.\n", at_get_alloc_count() - alloc_count);
+#endif
 
+    /* Make sure that every single sample was played */
+    if (pulse != NULL)
+        at_pulse_drain(pulse);
 
-        // combine channels from at_container struct
-        at_combine_channels(multi_data, audio_data_td, at_get_out_channels());
+    // insert new line
+    puts("\n");
 
-        // check if output file was specified
-        if (at_get_out_file())
-            sf_writef_double(outfile, multi_data, (sf_count_t) nslide);
-        else {
-            // convert data from double into float
-            for (int i = 0; i < nslide * max_channel_count; i++) {
-                pulse_data[i] = (float) multi_data[i];
-            }
+    print_clipping(&pipeline.converter);
 
-            /* play content of buffer via PA server */
-            if (pa_simple_write(pa_server, pulse_data, sizeof(float) * nslide * max_channel_count, &pa_error) < 0) {
-                fprintf(stderr, __FILE__": pa_simple_write() failed: %s\n", pa_strerror(pa_error));
-                exit(1);
-            }
+#ifdef AT_STATS
+    if (at_stats_enabled()) {
+        at_stats_session_t session = {
+                .frames = frames_processed,
+                .samples = (uint64_t) frames_read,
+                .samplerate = input_samplerate,
+                .frame_step = nslide,
+                .wall_time = wall_time
+        };
 
-        }
-    } while (count > 0);
+        at_stats_print(stdout, &session);
 
-    /* Make sure that every single sample was played */
-    if (pa_server != NULL && pa_simple_drain(pa_server, &pa_error) < 0) {
-        fprintf(stderr, __FILE__": pa_simple_drain() failed: %s\n", pa_strerror(pa_error));
-        exit(1);
+        if (at_get_stats_json() != NULL)
+            at_stats_write_json(at_get_stats_json(), &session);
     }
+#endif
 
-    // insert new line
-    puts("\n");
+    if (proc.params.analysis != NULL) {
+        at_analysis_print(stdout, &analysis);
+
+        if (at_get_analysis_json() != NULL)
+            at_analysis_write_json(at_get_analysis_json(), &analysis, at_get_in_file());
+        at_analysis_free(&analysis);
+    }
 
     // free memory
-    free(multi_data);
-    free(prev_multi_data);
-    at_free_buffer(audio_data_td);
-    at_free_buffer(audio_data_old);
-    at_free_buffer(audio_data_fft);
-    sf_close(outfile);
-    sf_close(infile);
-    at_fftw_free();
+    frame_processor_free(&proc);
+    if (resample_rate > 0)
+        at_resampler_free(&resampler);
 
-    if (pa_server != NULL) {
-        pa_simple_free(pa_server);
-    }
+    at_pulse_close(pulse);
+    at_pcm_map_close(map);
+
+    return count;
+
+}
+
+/* Stream of frames pushed by caller, processed by a single thread; it owns its buffers and
+ * batched plans, so streams are independent of each other and of the command line tool.
+ * Input is staged until a whole frame is available, each frame gives 'nslide' output frames.
+ */
+struct at_stream_t {
+    frame_processor_t proc;
+    pipeline_t pipeline;                // reads pushed input, converts output into samples
+    at_arena_t arena;
+    sample_t *staging;                  // interleaved input of incomplete frame
+    size_t staged;                      // count of frames in staging buffer
+    sf_count_t frame;                   // count of processed frames
+};
+
+// count of input frames completing next frame; the first frame is read whole
+static size_t stream_need(const at_stream_t *stream) {
+    return stream->frame == 0 ? stream->proc.layout.window_size : stream->proc.layout.nslide;
+}
 
-    if (pulse_data != NULL)
-        free(pulse_data);
+// process next frame of pushed input, 'nslide' output frames are stored into 'out'
+static sf_count_t stream_frame(at_stream_t *stream, sample_t *out) {
+    frame_processor_t *proc = &stream->proc;
+    pipeline_t *p = &stream->pipeline;
+    sf_count_t count = frame_processor_read(proc, p, stream->frame == 0, proc->layout.nslide);
+
+    frame_processor_run(proc, p);
+    at_writer_convert(&p->converter, out, proc->out.channel, proc->layout.nslide);
+    stream->frame++;
 
     return count;
+}
 
+// restore initial state of stream, so it can process another input
+static void stream_reset(at_stream_t *stream) {
+    frame_processor_t *proc = &stream->proc;
+    const processor_layout_t *layout = &proc->layout;
+
+    memset(proc->buf.old.data, 0, sizeof(sample_t) * proc->buf.old.stride * proc->buf.old.used_channels);
+    at_lfe_init(&proc->lfe, layout->samplerate, layout->window_size, layout->noverlap, proc->buf.lfe_tail);
+    if (proc->params.vocoder != NULL)
+        at_vocoder_reset(proc->params.vocoder);
+    if (proc->convolver != NULL)
+        at_convolver_reset(proc->convolver);
+    stream->staged = 0;
+    stream->frame = 0;
 }
 
-audio_container_t *at_allocate_buffer(int channels, size_t size, int samplerate) {
-    if (size <= 0) {
-        puts("Size of audio buffer not defined, exiting.");
-        exit(1);
-    }
+at_stream_t *at_stream_create(int channels, int samplerate) {
+    at_stream_t *stream = at_malloc(sizeof(*stream));
+    pipeline_t *p = &stream->pipeline;
+    size_t window_size = 0;
+    int fft_size = 0;
+
+    memset(stream, 0, sizeof(*stream));
+
+    // frames are sized the same way as frames of processed files
+    at_calc_window_and_fft_size(&window_size, &fft_size, at_get_frame_duration(), samplerate);
+
+    size_t noverlap = (size_t) floor(window_size * at_get_overlap() / 100);
+
+    // stream is processed by calling thread only, transforms use batched plans of stream
+    processor_layout_t layout = {
+            .window_size = window_size,
+            .noverlap = noverlap,
+            .nslide = window_size - noverlap,
+            .out_frames = window_size - noverlap,
+            .fft_size = (size_t) fft_size,
+            .tempo = 1.0,
+            .impulse_response = at_get_impulse_response(),
+            .channels = MAX(channels, at_get_out_channels()),
+            .out_channels = at_get_out_channels(),
+            .samplerate = samplerate,
+            .threads = 1,
+            .pulse = false,
+            .in_channels = channels,
+            .depth = 0
+    };
+
+    frame_processor_graph(&stream->proc, channels, window_size, 1.0);
+    layout.fft = at_stage_graph_needs_fft(&stream->proc.graph);
+    frame_processor_init(&stream->proc, &stream->arena, &layout);
+
+    stream->staging = init_buffer_sample(window_size * channels);
+
+    p->pushed = stream->staging;
+    p->in_channels = channels;
+    p->out_samples = layout.out_channels;
+    p->window_size = window_size;
+    p->nslide = layout.nslide;
+    at_writer_init(&p->converter, AT_WRITER_SAMPLE, layout.out_channels, false);
+
+    // timing counters are not shared by streams
+    p->read_stat = p->write_stat = p->input_wait_stat = p->output_wait_stat = -1;
+    p->separate_stat = p->overlap_add_stat = p->convolve_stat = p->resample_stat = p->convert_stat = -1;
+    p->frame_stat = -1;
+
+    return stream;
+}
 
-    audio_container_t *buffer = malloc(sizeof(*buffer) * size);
+size_t at_stream_process(at_stream_t *stream, const sample_t *in, size_t frames, sample_t *out) {
+    pipeline_t *p = &stream->pipeline;
+    int channels = p->in_channels;
+    size_t written = 0;
 
-    if (buffer == NULL) {
-        fprintf(stdout, "\nError: malloc() failed: %s\n", strerror(errno));
-        exit(1);
+    while (frames > 0) {
+        size_t need = stream_need(stream);
+        size_t take = MIN(frames, need - stream->staged);
+
+        // whole frame is read straight from caller's buffer, otherwise it is collected in staging buffer
+        if (stream->staged == 0 && take == need)
+            p->pushed = in;
+        else {
+            memcpy(stream->staging + stream->staged * channels, in, sizeof(*in) * take * channels);
+            stream->staged += take;
+
+            if (stream->staged < need)
+                break;
+
+            p->pushed = stream->staging;
+            stream->staged = 0;
+        }
+
+        p->pushed_frames = (sf_count_t) need;
+        in += take * channels;
+        frames -= take;
+
+        stream_frame(stream, out + written * p->out_samples);
+        written += p->nslide;
     }
 
+    return written;
+}
+
+size_t at_stream_flush(at_stream_t *stream, sample_t *out) {
+    pipeline_t *p = &stream->pipeline;
+    size_t written = 0;
+
+    // there is no input to finish
+    if (stream->frame == 0 && stream->staged == 0)
+        return 0;
+
+    // frames are processed until end of input, as for files
+    p->pushed = stream->staging;
+    p->pushed_frames = (sf_count_t) stream->staged;
+
+    while (stream_frame(stream, out + written * p->out_samples) > 0)
+        written += p->nslide;
+    written += p->nslide;
+
+    stream_reset(stream);
+
+    return written;
+}
+
+size_t at_stream_max_output(const at_stream_t *stream, size_t frames) {
+    size_t available = stream->staged + frames, need = stream_need(stream), nslide = stream->proc.layout.nslide;
+
+    if (available < need)
+        return 0;
+
+    return (1 + (available - need) / nslide) * nslide;
+}
+
+size_t at_stream_frame_step(const at_stream_t *stream) {
+    return stream->proc.layout.nslide;
+}
+
+void at_stream_free(at_stream_t *stream) {
+    if (stream == NULL)
+        return;
+
+    frame_processor_free(&stream->proc);
+    at_arena_free(&stream->arena);
+    free(stream->staging);
+    free(stream);
+}
+
+void at_audio_session_free(void) {
+    at_fftw_free();
+    at_window_free_cache();
+    at_arena_free(&session_arena);
+}
+
+void at_init_buffer(audio_container_t *buffer, sample_t *data, int channels, size_t size, size_t stride,
+                    int samplerate) {
     memset(buffer, 0, sizeof(*buffer));
 
     buffer->length = size;
+    buffer->stride = stride;
     buffer->used_channels = channels;
     buffer->samplerate = samplerate;
 
-    for (int i = 0; i < MAX_CHANNELS; ++i) {
-        buffer->channel[i] = init_buffer_dbl(size);
+    // all channels share one block, so they can be processed by a single batched FFT
+    buffer->data = data;
+
+    for (int i = 0; i < channels && data != NULL; ++i) {
+        buffer->channel[i] = data + i * stride;
     }
+}
+
+audio_container_t *at_allocate_buffer(int channels, size_t size, int samplerate) {
+    return at_allocate_buffer_stride(channels, size, size, samplerate);
+}
+
+audio_container_t *at_allocate_buffer_stride(int channels, size_t size, size_t stride, int samplerate) {
+    if (size <= 0 || stride < size) {
+        puts("Size of audio buffer not defined, exiting.");
+        exit(1);
+    }
+
+    audio_container_t *buffer = at_malloc(sizeof(*buffer));
+
+    at_init_buffer(buffer, init_buffer_sample(stride * channels), channels, size, stride, samplerate);
 
     return buffer;
 }
 
 int at_free_buffer(audio_container_t *buffer) {
-    for (int i = 0; i < MAX_CHANNELS; ++i)
-        free(buffer->channel[i]);
+    free(buffer->data);
 
     free(buffer);
 
@@ -218,113 +1533,35 @@ int at_free_buffer(audio_container_t *buffer) {
 }
 
 /* separate_channels */
-int at_separate_channels(double *multi_data, audio_container_t *container, int input_channels) {
+int at_separate_channels(sample_t *multi_data, audio_container_t *container, int input_channels) {
     if (input_channels > MAX_CHANNELS) {
-        puts("Processing of multichannel audio with more that 6 channels is not supported.");
+        printf("Processing of multichannel audio with more than %d channels is not supported.\n", MAX_CHANNELS);
         exit(1);
     }
 
-    int i, j;
-
-    for (i = 0; i < input_channels; i++) {
-        for (j = 0; j < container->length; j++) {
-            container->channel[i][j] = multi_data[j * input_channels + i];
-        }
-    }
+    at_deinterleave(multi_data, container->channel, input_channels, container->length);
 
     return 0;
 }
 
 /* combine_channels */
-int at_combine_channels(double *multi_data, audio_container_t *container, int output_channels) {
+int at_combine_channels(sample_t *multi_data, audio_container_t *container, int output_channels) {
     if (output_channels > MAX_CHANNELS) {
-        puts("Processing of multichannel audio with more that 6 channels is not supported.");
+        printf("Processing of multichannel audio with more than %d channels is not supported.\n", MAX_CHANNELS);
         exit(1);
     }
 
-    double *tmp = NULL;
-
-    // if LFE only is enabled, map LFE to FL channel (first available)
-    if (at_get_lfe_only_setting() == true) {
-        tmp = container->channel[FL];
-        container->channel[FL] = container->channel[LFE];
-        container->channel[LFE] = tmp;
-    }
-
-    // fix proper storage of 4-channel audio to be 2F/2R format
-    if (output_channels == 4) {
-        tmp = container->channel[C];
-        container->channel[C] = container->channel[SL];
-        container->channel[SL] = tmp;
-        tmp = container->channel[LFE];
-        container->channel[LFE] = container->channel[SR];
-        container->channel[SR] = tmp;
-    }
-
-    // fix proper storage of 5-channel audio to be 3F/2R format
-    if (output_channels == 5) {
-        tmp = container->channel[LFE];
-        container->channel[LFE] = container->channel[SL];
-        container->channel[SL] = tmp;
-    }
-
-
-    int i, j;
-
-    for (i = 0; i < output_channels; i++) {
-        for (j = 0; j < container->length; j++) {
-            multi_data[j * output_channels + i] = container->channel[i][j];
-        }
-    }
+    at_interleave(multi_data, container->channel, output_channels, container->length);
 
     return 0;
 }
 
-// simple audio upmix
-void at_interleave_audio(audio_container_t *container, int input_channels, int fft_size) {
-    // input is mono file, copy left channel to right
-    if (input_channels == 1) {
-        memcpy(container->channel[FR], container->channel[FL], container->length);
-        input_channels++;
-    }
-
-    /* input is stereo or quadraphonic file (FL, FR, SL, SR), create center
-     * channel with combination of left and right channel; decrease
-     * volume by 50 percent */
-    if (input_channels == 2 || input_channels == 4) {
-        for (int i = 0; i < container->length; i++) {
-            container->channel[C][i] = (container->channel[FL][i] + container->channel[FR][i]) / 4.0;
-        }
-        if (input_channels == 2)
-            input_channels++;
-    }
-
-    /* input is 3-channel file (FL, FR, C); create 5-channel file with SL and SR channels */
-    if (input_channels == 3) {
-        for (int i = 0; i < container->length; i++) {
-            container->channel[SL][i] = container->channel[FL][i] * 0.2;
-            container->channel[SR][i] = container->channel[FR][i] * 0.2;
-        }
-        input_channels += 2;
-    }
-
-    /* create mono file from all these channels and save this into LFE buffer */
-    if (input_channels == 5) {
-        for (int i = 0; i < container->length; i++) {
-            container->channel[LFE][i] = (container->channel[FL][i] + container->channel[FR][i] +
-                                          container->channel[C][i] + container->channel[SL][i] +
-                                          container->channel[SR][i]) / 5.0;
-        }
-        at_create_lfe(container, container->samplerate, fft_size);
-    }
-}
-
 /* multiply audio_container data with some gain */
 void at_audio_gain(audio_container_t *container, double gain) {
     // if volume settings were set
     if (gain != 1.0) {
 
-        for (int ch = 0; ch < 6; ch++)
+        for (int ch = 0; ch < container->used_channels; ch++)
             for (int i = 0; i < container->length; i++)
                 container->channel[ch][i] *= gain;
     }
@@ -333,46 +1570,77 @@ void at_audio_gain(audio_container_t *container, double gain) {
 
 /* apply_window */
 int apply_window(audio_container_t *container, size_t datalen) {
+    // window table is computed only once for given type and length
+    const sample_t *window = at_window_get(at_get_window_type(), datalen, at_get_kaiser_beta());
 
-    for (int i = 0; i < MAX_CHANNELS; i++) {
-        for (size_t j = 0; j < datalen; j++) {
-            container->channel[i][j] *= (j <= datalen - 1) ?
-                                        0.54 - 0.46 * cos(2 * M_PI * j / (datalen - 1)) : 0;
-        }
-    }
+    for (int i = 0; i < container->used_channels; i++)
+        at_window_multiply(container->channel[i], window, datalen);
 
     return 0;
 }
 
-// create LFE channel
-void at_create_lfe(audio_container_t *container, int sampling_freq, int fft_size) {
-    // create temporary variables
-    double *buffer = init_buffer_dbl((size_t) fft_size);
-    double *y_ps = init_buffer_dbl((size_t) fft_size / 2 + 1); /* power spectrum */
-    double *y_phase = init_buffer_dbl((size_t) fft_size / 2 + 1); /* phase */
+void at_lfe_init(at_lfe_t *lfe, int samplerate, size_t frame_length, size_t overlap, sample_t *tail) {
+    memset(lfe, 0, sizeof(*lfe));
 
-    // FFT
-    at_compute_fft(container->channel[LFE], container->length, buffer);
+    lfe->decimation = at_get_lfe_decimation();
+    lfe->frame_length = frame_length;
+    lfe->overlap = overlap;
+    lfe->retain = overlap;
+    lfe->tail = tail;
 
-    calc_magnitude(buffer, fft_size, y_ps);
+    if (frame_length <= overlap) {
+        puts("Overlap of frames is too large for LFE filter. Exiting.");
+        exit(1);
+    }
 
-    calc_phase(buffer, fft_size, y_phase);
+    // filter runs at decimated rate, LFE band is only a fraction of audio band
+    if (at_iir_linkwitz_riley_lowpass(&lfe->filter, at_get_lfe_cutoff(), at_get_lfe_slope(),
+                                      (double) samplerate / lfe->decimation) < 0) {
+        fprintf(stderr, "Error: Unsupported slope of LFE filter %d dB/oct.\n", at_get_lfe_slope());
+        exit(1);
+    }
+}
 
-    // calculate cut-off sample
-    int n_freq = (int) ceil((2 * CUTOFF_FREQ * ((fft_size / 2.0) - 1) / sampling_freq));
+void at_lfe_set_overlap(at_lfe_t *lfe, size_t overlap) {
+    lfe->overlap = overlap;
+    lfe->retain = lfe->frame_length - 1;
+}
 
-    for (int i = n_freq; i < fft_size / 2 + 1; i++)
-        y_ps[i] = 0;
+/* Filter single sample at decimated rate: block of 'decimation' samples is averaged,
+ * filtered and filter output is linearly interpolated back to full rate.
+ */
+static double lfe_decimated_sample(at_lfe_t *lfe, double x) {
+    lfe->accumulator += x;
+
+    if (++lfe->phase == lfe->decimation) {
+        lfe->prev = lfe->next;
+        lfe->next = at_iir_process_sample(&lfe->filter, lfe->accumulator / lfe->decimation);
+        lfe->accumulator = 0;
+        lfe->phase = 0;
+    }
 
-    // recreate frequency spectrum from magnitude and phase
-    calc_fft_complex_data(y_ps, y_phase, fft_size, buffer);
+    return lfe->prev + (lfe->next - lfe->prev) * (lfe->phase + 1) / lfe->decimation;
+}
 
-    // IFFT
-    at_compute_ifft(buffer, container->length, container->channel[LFE]);
+// create LFE channel
+void at_create_lfe(sample_t *data, at_lfe_t *lfe) {
+    size_t start = 0;
+
+    /* beginning of a frame was already filtered as the end of previous frame;
+     * every input sample passes through the filter exactly once */
+    if (lfe->started) {
+        memcpy(data, lfe->tail + lfe->retain - lfe->overlap, sizeof(*data) * lfe->overlap);
+        start = lfe->overlap;
+    }
 
-    // cleanup
-    free(buffer);
-    free(y_ps);
-    free(y_phase);
+    if (lfe->decimation == 1)
+        at_iir_process(&lfe->filter, data + start, lfe->frame_length - start);
+    else {
+        for (size_t i = start; i < lfe->frame_length; i++)
+            data[i] = (sample_t) lfe_decimated_sample(lfe, data[i]);
+    }
 
+    // keep filtered end of frame, the next frame starts by it
+    memcpy(lfe->tail, data + lfe->frame_length - lfe->retain, sizeof(*data) * lfe->retain);
+    lfe->started = true;
 }
@@ -19,15 +19,19 @@
 #define DSP_H_
 
 #include <sndfile.h>
+#include "common.h"
 #include "fft.h"
+#include "filter.h"
 
 #ifndef M_PI
 #    define M_PI 3.14159265358979323846
 #endif
 
-#define MAX_CHANNELS      6                    // maximum count of channels for input/output audio
+#define MAX_CHANNELS      12                   // maximum count of channels for input/output audio (7.1.4)
 
-#define CUTOFF_FREQ        120                    // defined cutoff frequency for simple low-pass filter for LFE
+#define CUTOFF_FREQ        120                    // default cutoff frequency of low-pass filter for LFE
+#define LFE_SLOPE         24                    // default slope of LFE filter in dB/oct (Linkwitz-Riley 4th order)
+#define MAX_LFE_DECIMATION 32                   // maximum decimation factor of LFE filter
 
 
 enum channel_map {
@@ -35,31 +39,81 @@ enum channel_map {
     FR = 1,        // Front-Right
     C = 2,        // Center
     LFE = 3,    // Low-Frequency Effects Channel
-    SL = 4,        // Surround-Left
-    SR = 5        // Surround-Right
+    SL = 4,        // Surround-Left (rear of 7.1)
+    SR = 5,        // Surround-Right (rear of 7.1)
+    SSL = 6,    // Side-Surround-Left
+    SSR = 7,    // Side-Surround-Right
+    TFL = 8,    // Top-Front-Left
+    TFR = 9,    // Top-Front-Right
+    TBL = 10,    // Top-Back-Left
+    TBR = 11    // Top-Back-Right
 };
 
 typedef struct audio_container_t {
-    double *channel[MAX_CHANNELS];    // data samples for each channel
+    sample_t *channel[MAX_CHANNELS];    // data samples for each channel
+    sample_t *data;                    // contiguous block holding all channels
     size_t length;                    // size of an array
-    int used_channels;                // number of actually used arrays for storing channels
+    size_t stride;                    // distance between beginnings of adjacent channels in 'data'
+    int used_channels;                // number of channels processed by stages, first ones of 'channel'
     int samplerate;                    // sample rate
 } audio_container_t;
 
+/* streaming low-pass filter creating LFE channel; state is carried over adjacent frames */
+typedef struct at_lfe_t {
+    at_iir_cascade_t filter;        // Linkwitz-Riley low-pass
+    int decimation;                 // filter runs at samplerate / decimation
+    int phase;                      // position within decimation block
+    double accumulator;             // sum of input samples of current decimation block
+    double prev, next;              // last two filter outputs, interpolated to full rate
+    size_t frame_length;            // length of a frame
+    size_t overlap;                 // count of samples shared by adjacent frames
+    size_t retain;                  // count of filtered samples kept from previous frame, at least 'overlap'
+    sample_t *tail;                 // filtered end of previous frame
+    bool started;                   // first frame was already processed
+} at_lfe_t;
+
 extern sf_count_t at_audio_processor(SNDFILE *infile, SNDFILE *outfile);
 
+/* release FFT plans, window tables and buffers kept by processor for following files */
+void at_audio_session_free(void);
+
+/* Stream of interleaved frames pushed by caller, see session.h. Settings are taken from getters,
+ * both at creation and during processing. */
+typedef struct at_stream_t at_stream_t;
+
+/* create stream of input audio with given count of channels and sample rate */
+at_stream_t *at_stream_create(int channels, int samplerate);
+
+/* push 'frames' frames of input; output frames are stored into 'out', returns their count */
+size_t at_stream_process(at_stream_t *stream, const sample_t *in, size_t frames, sample_t *out);
+
+/* process the rest of input, as if input ended; stream is reset to its initial state afterwards */
+size_t at_stream_flush(at_stream_t *stream, sample_t *out);
+
+/* count of output frames given by pushing of 'frames' frames */
+size_t at_stream_max_output(const at_stream_t *stream, size_t frames);
+
+/* count of output frames given by a processed frame; flush gives up to two of them */
+size_t at_stream_frame_step(const at_stream_t *stream);
+
+void at_stream_free(at_stream_t *stream);
+
+/* initialize buffer of 'channels' channels over memory block 'data' of at least 'stride * channels' samples */
+extern void at_init_buffer(audio_container_t *buffer, sample_t *data, int channels, size_t size, size_t stride,
+                           int samplerate);
+
 extern audio_container_t *at_allocate_buffer(int channels, size_t size, int samplerate);
 
+/* allocate buffer with channels placed 'stride' samples apart; samples past 'size' are zero padding */
+extern audio_container_t *at_allocate_buffer_stride(int channels, size_t size, size_t stride, int samplerate);
+
 extern int at_free_buffer(audio_container_t *buffer);
 
 /* separate_channels */
-int at_separate_channels(double *multi_data, audio_container_t *container, int input_channels);
+int at_separate_channels(sample_t *multi_data, audio_container_t *container, int input_channels);
 
 /* combine_channels_double */
-int at_combine_channels(double *multi_data, audio_container_t *container, int output_channels);
-
-/* simple audio upmix */
-void at_interleave_audio(audio_container_t *container, int input_channels, int fft_size);
+int at_combine_channels(sample_t *multi_data, audio_container_t *container, int output_channels);
 
 /* multiply audio_container data with some gain */
 void at_audio_gain(audio_container_t *container, double gain);
@@ -67,7 +121,15 @@ void at_audio_gain(audio_container_t *container, double gain);
 /* apply_window */
 int apply_window(audio_container_t *container, size_t datalen);
 
-/* create LFE channel */
-void at_create_lfe(audio_container_t *container, int sampling_freq, int fft_size);
+/* initialize LFE filter for frames of given length overlapping by 'overlap' samples;
+ * 'tail' is storage for at least 'overlap' samples owned by caller */
+void at_lfe_init(at_lfe_t *lfe, int samplerate, size_t frame_length, size_t overlap, sample_t *tail);
+
+/* set overlap of the following frame for frames read with variable hop; the whole frame
+ * except its first sample is kept then, so 'tail' has to hold 'frame_length - 1' samples */
+void at_lfe_set_overlap(at_lfe_t *lfe, size_t overlap);
+
+/* create LFE channel by low-pass filtering of LFE channel of a frame, given by its samples */
+void at_create_lfe(sample_t *data, at_lfe_t *lfe);
 
 #endif /* DSP_H_ */
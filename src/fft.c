@@ -15,47 +15,114 @@
 ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include <fftw3.h>
 #include <stdlib.h>
+#include <strings.h>
+#include <pthread.h>
 #include "fft.h"
+#include "wisdom.h"
 #include "audiotools.h"
 
 // pointer to a block in memory where FFT transformation will be done
-static double *buffer = NULL;
+static sample_t *buffer = NULL;
 
 // FFT plan
-static fftw_plan fft_forw;
+static FFTW(plan) fft_forw;
 
 // IFFT plan
-static fftw_plan fft_back;
+static FFTW(plan) fft_back;
 
 // size of a FFT
 static int fft_size = 0;
 
+/* FFTW planner and wisdom are shared by all sessions of a process and they are not thread safe,
+ * creation and destruction of plans is serialized; execution of plans needs no locking */
+static pthread_mutex_t planner_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *plan_effort_names[] = {
+        [AT_PLAN_ESTIMATE] = "estimate",
+        [AT_PLAN_MEASURE]  = "measure",
+        [AT_PLAN_PATIENT]  = "patient"
+};
+
+int at_plan_effort_parse(const char *name, at_plan_effort_t *effort) {
+    for (int i = 0; i < ARRAY_LEN(plan_effort_names); i++) {
+        if (strcasecmp(name, plan_effort_names[i]) == 0) {
+            *effort = (at_plan_effort_t) i;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+const char *at_plan_effort_name(at_plan_effort_t effort) {
+    return plan_effort_names[effort];
+}
+
+// translate planner effort into FFTW planner flags
+static unsigned plan_flags(at_plan_effort_t effort) {
+    switch (effort) {
+        case AT_PLAN_ESTIMATE:
+            return FFTW_ESTIMATE;
+        case AT_PLAN_PATIENT:
+            return FFTW_PATIENT;
+        case AT_PLAN_MEASURE:
+        default:
+            return FFTW_MEASURE;
+    }
+}
+
 // initialize FFTW library
 int at_fftw_init(int size) {
     if (size == 0) {
         puts("FFT size is invalid. Exiting.");
         exit(1);
     }
+
+    // plans of previous file are reused for the whole session
+    if (buffer != NULL && size == fft_size)
+        return 0;
+
+    at_fftw_free();
     fft_size = size;
 
-    buffer = init_buffer_dbl((size_t) fft_size);
-    if (buffer == NULL) {
-        puts("Unable to create a FFT plan. Exiting.");
-        exit(1);
-    }
-    fft_forw = fftw_plan_r2r_1d(fft_size, buffer, buffer, FFTW_R2HC, FFTW_MEASURE);
-    fft_back = fftw_plan_r2r_1d(fft_size, buffer, buffer, FFTW_HC2R, FFTW_MEASURE);
+    // plans are executed on scratch buffers of worker threads too, they need to share alignment
+    buffer = at_fftw_alloc_scratch();
+
+    // previously measured plans are reused from wisdom cache
+    unsigned flags = plan_flags(at_get_plan_effort());
+
+    pthread_mutex_lock(&planner_lock);
+    at_wisdom_import(at_get_wisdom_file());
+
+    // time domain data at the beginning of buffer, its spectrum behind it
+    sample_t *spectrum = buffer + fft_size;
+    FFTW(iodim) dim = {.n = fft_size, .is = 1, .os = 1};
+
+    fft_forw = FFTW(plan_guru_split_dft_r2c)(1, &dim, 0, NULL, buffer, spectrum, spectrum + SPECTRUM_IMAG(fft_size),
+                                             flags);
+    fft_back = FFTW(plan_guru_split_dft_c2r)(1, &dim, 0, NULL, spectrum, spectrum + SPECTRUM_IMAG(fft_size), buffer,
+                                             flags);
+
+    at_wisdom_export(at_get_wisdom_file());
+    pthread_mutex_unlock(&planner_lock);
 
     return 0;
 }
 
 // free FFTW allocated memory
 int at_fftw_free(void) {
-    free(buffer);
-    fftw_destroy_plan(fft_forw);
-    fftw_destroy_plan(fft_back);
+    // FFT was not initialized
+    if (buffer == NULL)
+        return 0;
+
+    FFTW(free)(buffer);
+    buffer = NULL;
+
+    pthread_mutex_lock(&planner_lock);
+    FFTW(destroy_plan)(fft_forw);
+    FFTW(destroy_plan)(fft_back);
+    pthread_mutex_unlock(&planner_lock);
 
     return 0;
 }
@@ -65,39 +132,146 @@ int at_fftw_get_size(void) {
     return fft_size;
 }
 
+// allocate scratch buffer for FFT transforms, aligned for FFTW
+sample_t *at_fftw_alloc_scratch(void) {
+    sample_t *scratch = FFTW(malloc)(sizeof(*scratch) * FFT_SCRATCH_SIZE(fft_size));
+
+    if (scratch == NULL) {
+        puts("Unable to allocate FFT buffer. Exiting.");
+        exit(1);
+    }
+    memset(scratch, 0, sizeof(*scratch) * FFT_SCRATCH_SIZE(fft_size));
+
+    return scratch;
+}
+
+// free scratch buffer for FFT transforms
+void at_fftw_free_scratch(sample_t *scratch) {
+    FFTW(free)(scratch);
+}
+
 // calculate forward FFT transform
-int at_compute_fft(double *time_data_in, size_t window_size, double *fft_data_out) {
+int at_compute_fft(sample_t *time_data_in, size_t window_size, sample_t *fft_data_out) {
+    return at_compute_fft_r(time_data_in, window_size, fft_data_out, buffer);
+}
+
+// calculate inverse FFT transform
+int at_compute_ifft(sample_t *fft_data_in, size_t window_size, sample_t *time_data_out) {
+    return at_compute_ifft_r(fft_data_in, window_size, time_data_out, buffer);
+}
+
+// calculate forward FFT transform in caller's scratch buffer
+int at_compute_fft_r(sample_t *time_data_in, size_t window_size, sample_t *fft_data_out, sample_t *scratch) {
     // initialize FFT array to zero values
-    memset(buffer, 0, sizeof(*buffer) * fft_size);
+    memset(scratch, 0, sizeof(*scratch) * fft_size);
 
     // copy time domain data into FFT buffer
-    memcpy(buffer, time_data_in, sizeof(*buffer) * window_size);
-
-    // FFT
-    fftw_execute(fft_forw);
+    memcpy(scratch, time_data_in, sizeof(*scratch) * window_size);
 
-    // copy FFT data from buffer into destination array
-    memcpy(fft_data_out, buffer, sizeof(*buffer) * fft_size);
+    // FFT straight into destination; new-array execute interface lets more threads share one plan
+    FFTW(execute_split_dft_r2c)(fft_forw, scratch, fft_data_out, fft_data_out + SPECTRUM_IMAG(fft_size));
 
     return 0;
 }
 
-// calculate inverse FFT transform
-int at_compute_ifft(double *fft_data_in, size_t window_size, double *time_data_out) {
-    // copy FFT data back into buffer
-    memcpy(buffer, fft_data_in, sizeof(*buffer) * fft_size);
+// calculate inverse FFT transform in caller's scratch buffer
+int at_compute_ifft_r(sample_t *fft_data_in, size_t window_size, sample_t *time_data_out, sample_t *scratch) {
+    sample_t *spectrum = scratch + fft_size;
+
+    // copy FFT data into buffer, inverse transform overwrites its input
+    memcpy(spectrum, fft_data_in, sizeof(*scratch) * SPECTRUM_SIZE(fft_size));
 
     // proceed with inverse FFT transform
-    fftw_execute(fft_back);
+    FFTW(execute_split_dft_c2r)(fft_back, spectrum, spectrum + SPECTRUM_IMAG(fft_size), scratch);
 
     // copy time domain data into destination array and normalize FFT
     for (int i = 0; i < window_size; i++)
-        time_data_out[i] = check_nan(buffer[i] / (double) fft_size);
+        time_data_out[i] = check_nan(scratch[i] / (double) fft_size);
 
     return 0;
 }
 
 
+at_fft_batch_t *at_fftw_plan_batch(audio_container_t *td, audio_container_t *fd) {
+    // size of batched transform is given by containers, it is independent of global plans
+    int size = (int) fd->length;
+
+    if (td->stride < size || fd->stride < SPECTRUM_SIZE(size)) {
+        puts("Buffer is too small for batched FFT. Exiting.");
+        exit(1);
+    }
+
+    if (td->used_channels != fd->used_channels) {
+        puts("Buffers of batched FFT differ in count of channels. Exiting.");
+        exit(1);
+    }
+
+    at_fft_batch_t *batch = at_malloc(sizeof(*batch));
+
+    // one transform of each used channel block, spectra are stored in split layout
+    FFTW(iodim) dim = {.n = size, .is = 1, .os = 1};
+    FFTW(iodim) forw_channels = {.n = td->used_channels, .is = (int) td->stride, .os = (int) fd->stride};
+    FFTW(iodim) back_channels = {.n = td->used_channels, .is = (int) fd->stride, .os = (int) td->stride};
+    unsigned flags = plan_flags(at_get_plan_effort());
+
+    batch->td = td;
+    batch->fd = fd;
+    batch->size = size;
+
+    pthread_mutex_lock(&planner_lock);
+    at_wisdom_import(at_get_wisdom_file());
+
+    batch->forw = FFTW(plan_guru_split_dft_r2c)(1, &dim, 1, &forw_channels, td->data,
+                                                fd->data, fd->data + SPECTRUM_IMAG(size), flags);
+    batch->back = FFTW(plan_guru_split_dft_c2r)(1, &dim, 1, &back_channels,
+                                                fd->data, fd->data + SPECTRUM_IMAG(size), td->data, flags);
+
+    at_wisdom_export(at_get_wisdom_file());
+    pthread_mutex_unlock(&planner_lock);
+
+    if (batch->forw == NULL || batch->back == NULL) {
+        puts("Unable to create a FFT plan. Exiting.");
+        exit(1);
+    }
+
+    // planner may have overwritten the arrays, zero padding of time domain data is required
+    memset(td->data, 0, sizeof(*td->data) * td->stride * td->used_channels);
+    memset(fd->data, 0, sizeof(*fd->data) * fd->stride * fd->used_channels);
+
+    return batch;
+}
+
+void at_compute_fft_batch(at_fft_batch_t *batch) {
+    FFTW(execute)(batch->forw);
+}
+
+void at_compute_ifft_batch(at_fft_batch_t *batch) {
+    audio_container_t *td = batch->td;
+
+    FFTW(execute)(batch->back);
+
+    // normalize FFT and restore zero padding overwritten by the transform
+    for (int i = 0; i < td->used_channels; i++) {
+        sample_t *data = td->channel[i];
+
+        for (size_t j = 0; j < td->length; j++)
+            data[j] = check_nan(data[j] / (double) batch->size);
+
+        memset(data + td->length, 0, sizeof(*data) * (batch->size - td->length));
+    }
+}
+
+void at_fftw_free_batch(at_fft_batch_t *batch) {
+    if (batch == NULL)
+        return;
+
+    pthread_mutex_lock(&planner_lock);
+    FFTW(destroy_plan)(batch->forw);
+    FFTW(destroy_plan)(batch->back);
+    pthread_mutex_unlock(&planner_lock);
+    free(batch);
+}
+
 /* Calculate window size and optimal FFT size; FFT size needs to be <= than FFT_MAX (2048 samples)
  * In a case that calculated FFT size is greater than 2048, frame_duration is decreased, until
  * this criteria is met.
@@ -131,91 +305,3 @@ int at_calc_window_and_fft_size(size_t *wsize, int *fft_len, int frame_dur, int
 
     return 0;
 }
-
-/* calc_magnitude */
-void calc_magnitude(const double *freq, int fft_size, double *magnitude) {
-    int i;
-
-    for (i = 0; i <= fft_size / 2; i++) {
-        if (i == 0 || (i == fft_size / 2 && (fft_size % 2 == 0))) /* fft_size is even */
-            magnitude[i] = sqrt(freq[i] * freq[i]);
-        else
-            magnitude[i] = sqrt(freq[i] * freq[i] + freq[fft_size - i] * freq[fft_size - i]);
-    }
-
-    return;
-}
-
-/* calc_phase */
-void calc_phase(const double *freq, int fft_size, double *phase) {
-    int i;
-
-    for (i = 0; i <= fft_size / 2; i++) {
-        if (i == 0 || (i == fft_size / 2 && (fft_size % 2 == 0))) /* fft_size is even */
-            phase[i] = complex_argument(freq[i], 0.0);
-        else
-            phase[i] = complex_argument(freq[i], freq[fft_size - i]);
-    }
-    return;
-}
-
-/* calc_power_spectrum */
-double calc_power_spectrum(const double *magnitude, int fft_size, double *power_spectrum) {
-    double norm_ps = 0;
-    int i;
-
-    for (i = 0; i <= fft_size / 2; i++) {
-        power_spectrum[i] = magnitude[i] * magnitude[i];
-        norm_ps += power_spectrum[i];
-    }
-
-    return norm_ps;
-}
-
-/* calc_fft_complex_data */
-void calc_fft_complex_data(const double *magnitude, const double *phase, int fft_size, double *freq) {
-    int i;
-
-    for (i = 0; i <= fft_size / 2; i++) {
-        if (i == 0 || (i == fft_size / 2 && (fft_size % 2 == 0))) /* fft_size is even */
-            freq[i] = magnitude[i];
-        else {
-            freq[i] = magnitude[i] * cos(phase[i]);
-            freq[fft_size - i] = magnitude[i] * sin(phase[i]);
-        }
-    }
-
-    return;
-}
-
-/* multiply_fft_spec_with_gain */
-void multiply_fft_spec_with_gain(const double *gain, int fft_size, double *freq) {
-    int i;
-
-    for (i = 0; i <= fft_size / 2; i++) {
-        if (i == 0 || (i == fft_size / 2 && (fft_size % 2 == 0))) /* fft_size is even */
-            freq[i] *= gain[i];
-        else {
-            freq[i] *= gain[i];
-            freq[fft_size - i] *= gain[i];
-        }
-    }
-
-    return;
-}
-
-/* complex argument of FFT spectrum */
-double complex_argument(const double real, const double imag) {
-    if (real > 0)
-        return (atan(imag / real));
-    if ((real < 0) && (imag >= 0))
-        return (atan(imag / real) + M_PI);
-    if ((real < 0) && (imag < 0))
-        return (atan(imag / real) - M_PI);
-    if ((real == 0) && (imag > 0))
-        return (M_PI / 2);
-    if ((real == 0) && (imag < 0))
-        return (-M_PI / 2);
-
-    return 0;
-}
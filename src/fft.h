@@ -20,6 +20,15 @@
 
 #include <math.h>
 #include <string.h>
+#include <fftw3.h>
+#include "common.h"
+
+// FFTW API matching precision of samples
+#ifdef AT_SINGLE_PRECISION
+#    define FFTW(name)  fftwf_ ## name
+#else
+#    define FFTW(name)  fftw_ ## name
+#endif
 
 #define FFT_MAX           2048              // maximum size of FFT transform
 #define WINDOW_MAX        FFT_MAX/2         // maximum size of window
@@ -28,13 +37,38 @@
 
 #define WINDOW_SIZE(x, y)                 ((size_t) (floor(((x) * (y) / 1000))))
 
+/* Spectra are kept in split layout of r2c transform: real parts of SPECTRUM_BINS(n) bins are
+ * followed by imaginary parts starting at SPECTRUM_IMAG(n), so that both arrays of spectra of
+ * power of two transforms are aligned for SIMD loads. Imaginary parts of DC and Nyquist bins
+ * are zero. A spectrum takes SPECTRUM_SIZE(n) samples. */
+#define SPECTRUM_BINS(n)                  ((n) / 2 + 1)
+#define SPECTRUM_IMAG(n)                  ((n) / 2 + 8)
+#define SPECTRUM_SIZE(n)                  ((n) + 16)
+
+// scratch buffer of a transform holds time domain data followed by spectrum
+#define FFT_SCRATCH_SIZE(n)               ((n) + SPECTRUM_SIZE(n))
+
+// effort spent by FFTW planner on searching for the fastest plan
+typedef enum at_plan_effort_t {
+    AT_PLAN_ESTIMATE = 0,
+    AT_PLAN_MEASURE,
+    AT_PLAN_PATIENT
+} at_plan_effort_t;
+
+/* translate planner effort name given on command line; returns -1 for unknown name */
+int at_plan_effort_parse(const char *name, at_plan_effort_t *effort);
+
+/* name of planner effort */
+const char *at_plan_effort_name(at_plan_effort_t effort);
+
 /* Calculate window size and optimal FFT size; FFT size needs to be <= than FFT_MAX (2048 samples)
  * In a case that calculated FFT size is greater than 2048, frame_duration is decreased, until
  * this criteria is met.
  */
 extern int at_calc_window_and_fft_size(size_t *wsize, int *fft_len, int frame_dur, int srate);
 
-// initialize FFTW library
+/* initialize FFTW library; FFTW wisdom is loaded from cache before planning
+ * and stored back if planner learned something new */
 extern int at_fftw_init(int size);
 
 // free FFTW allocated memory
@@ -43,29 +77,52 @@ extern int at_fftw_free(void);
 // get size of a FFT
 int at_fftw_get_size(void);
 
-// calculate forward FFT transform
-int at_compute_fft(double *time_data_in, size_t window_size, double *fft_data_out);
+// calculate forward FFT transform, spectrum is stored in split layout
+int at_compute_fft(sample_t *time_data_in, size_t window_size, sample_t *fft_data_out);
 
 // calculate inverse FFT transform
-int at_compute_ifft(double *fft_data_in, size_t window_size, double *time_data_out);
+int at_compute_ifft(sample_t *fft_data_in, size_t window_size, sample_t *time_data_out);
 
-/* calc_magnitude */
-void calc_magnitude(const double *freq, int fft_size, double *magnitude);
+// allocate scratch buffer for FFT transforms, aligned for FFTW
+sample_t *at_fftw_alloc_scratch(void);
 
-/* calc_phase */
-void calc_phase(const double *freq, int fft_size, double *phase);
+// free scratch buffer for FFT transforms
+void at_fftw_free_scratch(sample_t *scratch);
 
-/* calc_power_spectrum */
-double calc_power_spectrum(const double *magnitude, int fft_size, double *power_spectrum);
+/* Reentrant variants of at_compute_fft() and at_compute_ifft(), each thread has to pass its own
+ * scratch buffer allocated by at_fftw_alloc_scratch(). Results are bit-identical to serial ones.
+ */
+int at_compute_fft_r(sample_t *time_data_in, size_t window_size, sample_t *fft_data_out, sample_t *scratch);
+
+int at_compute_ifft_r(sample_t *fft_data_in, size_t window_size, sample_t *time_data_out, sample_t *scratch);
+
+struct audio_container_t;
+
+// batched transform of all channels of a container
+typedef struct at_fft_batch_t {
+    FFTW(plan) forw;                    // time domain -> spectrum
+    FFTW(plan) back;                    // spectrum -> time domain
+    struct audio_container_t *td;      // time domain data, channel stride >= FFT size
+    struct audio_container_t *fd;      // spectra, channel stride >= FFT size
+    int size;                           // size of FFT
+} at_fft_batch_t;
+
+/* Plan batched transforms between channel blocks of 'td' and 'fd' (see at_allocate_buffer_stride()).
+ * FFT size is given by length of 'fd', its channel stride has to be at least SPECTRUM_SIZE() of it.
+ * Time domain channels hold 'td->length' samples followed by zero padding up to FFT size, so FFTW
+ * reads and writes container data directly without intermediate copies. Content of both containers is cleared by planning. Batched plans do not use global plans of
+ * at_fftw_init(), they may be created from more threads at once.
+ */
+at_fft_batch_t *at_fftw_plan_batch(struct audio_container_t *td, struct audio_container_t *fd);
 
-/* calc_fft_complex_data */
-void calc_fft_complex_data(const double *magnitude, const double *phase, int fft_size, double *freq);
+// forward FFT of all channels of 'td' into 'fd'
+void at_compute_fft_batch(at_fft_batch_t *batch);
 
-/* multiply_fft_spec_with_gain */
-void multiply_fft_spec_with_gain(const double *gain, int fft_size, double *freq);
+// inverse FFT of all channels of 'fd' into 'td', normalized; spectra in 'fd' are destroyed
+void at_compute_ifft_batch(at_fft_batch_t *batch);
 
-/* complex argument of FFT spectrum */
-double complex_argument(const double real, const double imag);
+// destroy batched plans
+void at_fftw_free_batch(at_fft_batch_t *batch);
 
 
 #endif /* FFT_H_ */
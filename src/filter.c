@@ -0,0 +1,148 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include <math.h>
+#include "filter.h"
+
+#ifndef M_PI
+#    define M_PI 3.14159265358979323846
+#endif
+
+// first order low-pass section, bilinear transform of H(s) = 1 / (s + 1)
+static void design_first_order(at_biquad_t *bq, double w0) {
+    double k = tan(w0 / 2);
+
+    memset(bq, 0, sizeof(*bq));
+    bq->b0 = k / (1 + k);
+    bq->b1 = bq->b0;
+    bq->a1 = (k - 1) / (k + 1);
+}
+
+// second order low-pass section with quality factor q (RBJ audio EQ cookbook)
+static void design_second_order(at_biquad_t *bq, double w0, double q) {
+    double alpha = sin(w0) / (2 * q);
+    double a0 = 1 + alpha;
+
+    memset(bq, 0, sizeof(*bq));
+    bq->b0 = (1 - cos(w0)) / 2 / a0;
+    bq->b1 = (1 - cos(w0)) / a0;
+    bq->b2 = bq->b0;
+    bq->a1 = -2 * cos(w0) / a0;
+    bq->a2 = (1 - alpha) / a0;
+}
+
+/* Linkwitz-Riley filter of order 2N is a cascade of two identical Butterworth filters
+ * of order N, so the magnitude response at cutoff frequency is -6 dB.
+ */
+int at_iir_linkwitz_riley_lowpass(at_iir_cascade_t *filter, double cutoff, int slope, double samplerate) {
+    if (slope < 12 || slope > 96 || slope % 12 != 0)
+        return -1;
+
+    int order = slope / 12;        // order of each Butterworth filter
+    double w0 = 2 * M_PI * cutoff / samplerate;
+
+    memset(filter, 0, sizeof(*filter));
+
+    for (int pass = 0; pass < 2; pass++) {
+        // pairs of complex conjugate poles, pole 'k' lies at angle (2k - 1) pi / 2N from imaginary axis
+        for (int k = 1; k <= order / 2; k++) {
+            double q = 1.0 / (2 * sin((2 * k - 1) * M_PI / (2 * order)));
+            design_second_order(&filter->section[filter->sections++], w0, q);
+        }
+
+        // real pole of odd order
+        if (order % 2 != 0)
+            design_first_order(&filter->section[filter->sections++], w0);
+    }
+
+    return 0;
+}
+
+/* K-weighting of ITU-R BS.1770: high shelf modelling acoustic effect of head (+4 dB above
+ * 1.7 kHz) followed by high-pass RLB filter. Analog prototypes are fitted to coefficients
+ * given by the recommendation for 48 kHz, so that the filter is valid for any sample rate.
+ */
+void at_iir_k_weighting(at_iir_cascade_t *filter, double samplerate) {
+    double k, vh, vb, a0;
+
+    memset(filter, 0, sizeof(*filter));
+    filter->sections = 2;
+
+    // high shelf
+    k = tan(M_PI * 1681.974450955533 / samplerate);
+    vh = pow(10, 3.999843853973347 / 20);
+    vb = pow(vh, 0.4996667741545416);
+    a0 = 1 + k / 0.7071752369554196 + k * k;
+
+    filter->section[0].b0 = (vh + vb * k / 0.7071752369554196 + k * k) / a0;
+    filter->section[0].b1 = 2 * (k * k - vh) / a0;
+    filter->section[0].b2 = (vh - vb * k / 0.7071752369554196 + k * k) / a0;
+    filter->section[0].a1 = 2 * (k * k - 1) / a0;
+    filter->section[0].a2 = (1 - k / 0.7071752369554196 + k * k) / a0;
+
+    // high-pass
+    k = tan(M_PI * 38.13547087602444 / samplerate);
+    a0 = 1 + k / 0.5003270373238773 + k * k;
+
+    filter->section[1].b0 = 1;
+    filter->section[1].b1 = -2;
+    filter->section[1].b2 = 1;
+    filter->section[1].a1 = 2 * (k * k - 1) / a0;
+    filter->section[1].a2 = (1 - k / 0.5003270373238773 + k * k) / a0;
+}
+
+void at_iir_reset(at_iir_cascade_t *filter) {
+    for (int i = 0; i < filter->sections; i++) {
+        filter->section[i].z1 = 0;
+        filter->section[i].z2 = 0;
+    }
+}
+
+double at_iir_process_sample(at_iir_cascade_t *filter, double x) {
+    for (int i = 0; i < filter->sections; i++) {
+        at_biquad_t *bq = &filter->section[i];
+        double y = bq->b0 * x + bq->z1;
+
+        bq->z1 = bq->b1 * x - bq->a1 * y + bq->z2;
+        bq->z2 = bq->b2 * x - bq->a2 * y;
+        x = y;
+    }
+
+    return x;
+}
+
+void at_iir_process(at_iir_cascade_t *filter, sample_t *data, size_t length) {
+    // each section runs over whole block, its state stays in registers
+    for (int i = 0; i < filter->sections; i++) {
+        at_biquad_t *bq = &filter->section[i];
+        double b0 = bq->b0, b1 = bq->b1, b2 = bq->b2, a1 = bq->a1, a2 = bq->a2;
+        double z1 = bq->z1, z2 = bq->z2;
+
+        for (size_t j = 0; j < length; j++) {
+            double x = data[j];
+            double y = b0 * x + z1;
+
+            z1 = b1 * x - a1 * y + z2;
+            z2 = b2 * x - a2 * y;
+            data[j] = (sample_t) y;
+        }
+
+        bq->z1 = z1;
+        bq->z2 = z2;
+    }
+}
@@ -0,0 +1,59 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FILTER_H_
+#define FILTER_H_
+
+#include <stddef.h>
+#include "common.h"
+
+#define MAX_BIQUADS       8                    // maximum count of second order sections in a cascade
+
+/* Second order IIR section in transposed direct form II; state is kept
+ * in double precision even in single precision build, because poles of
+ * low-pass filters with low cutoff frequency lie very close to unit circle.
+ */
+typedef struct at_biquad_t {
+    double b0, b1, b2;        // numerator coefficients
+    double a1, a2;            // denominator coefficients, a0 is normalized to 1
+    double z1, z2;            // filter state
+} at_biquad_t;
+
+/* cascade of second order sections, state is carried over between calls */
+typedef struct at_iir_cascade_t {
+    at_biquad_t section[MAX_BIQUADS];
+    int sections;
+} at_iir_cascade_t;
+
+/* Design Linkwitz-Riley low-pass filter with given cutoff frequency and slope in dB per
+ * octave; slope has to be a multiple of 12 in range <12 - 96>. Returns -1 for invalid slope.
+ */
+int at_iir_linkwitz_riley_lowpass(at_iir_cascade_t *filter, double cutoff, int slope, double samplerate);
+
+/* Design K-weighting filter of ITU-R BS.1770 used by loudness measurement for given sample rate */
+void at_iir_k_weighting(at_iir_cascade_t *filter, double samplerate);
+
+/* reset state of all sections */
+void at_iir_reset(at_iir_cascade_t *filter);
+
+/* filter a block of samples in place */
+void at_iir_process(at_iir_cascade_t *filter, sample_t *data, size_t length);
+
+/* filter single sample */
+double at_iir_process_sample(at_iir_cascade_t *filter, double x);
+
+#endif /* FILTER_H_ */
@@ -0,0 +1,371 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include "interleave.h"
+
+#if !defined(AT_NO_SIMD) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#    define AT_SIMD_X86
+#    include <immintrin.h>
+#endif
+
+#define ALWAYS_INLINE static inline __attribute__((always_inline))
+
+/* Call kernel with channel count known at compile time, so that a specialised
+ * version is generated for each common layout. */
+#define SPECIALISE(kernel, a, b, channels, frames)          \
+    switch (channels) {                                     \
+        case 2: kernel(a, b, 2, frames); break;             \
+        case 3: kernel(a, b, 3, frames); break;             \
+        case 4: kernel(a, b, 4, frames); break;             \
+        case 5: kernel(a, b, 5, frames); break;             \
+        case 6: kernel(a, b, 6, frames); break;             \
+        case 7: kernel(a, b, 7, frames); break;             \
+        case 8: kernel(a, b, 8, frames); break;             \
+        default: kernel(a, b, channels, frames); break;     \
+    }
+
+/* scalar kernels, used for tails of frames and as a fallback */
+
+ALWAYS_INLINE void deinterleave_scalar(const sample_t *restrict in, sample_t *const *out, const int channels,
+                                       size_t start, size_t frames) {
+    for (size_t j = start; j < frames; j++)
+        for (int c = 0; c < channels; c++)
+            out[c][j] = in[j * channels + c];
+}
+
+ALWAYS_INLINE void interleave_scalar(sample_t *restrict out, sample_t *const *in, const int channels,
+                                     size_t start, size_t frames) {
+    for (size_t j = start; j < frames; j++)
+        for (int c = 0; c < channels; c++)
+            out[j * channels + c] = in[c][j];
+}
+
+#if defined(AT_SIMD_X86) && defined(AT_SINGLE_PRECISION)
+
+/* SSE kernels: blocks of 4 frames, 4 channels are transposed at once */
+
+ALWAYS_INLINE void deinterleave_kernel(const float *restrict in, float *const *out, const int channels,
+                                       size_t frames) {
+    size_t j;
+
+    for (j = 0; j + 4 <= frames; j += 4) {
+        const float *row = in + j * channels;
+        int c = 0;
+
+        for (; c + 4 <= channels; c += 4) {
+            __m128 r0 = _mm_loadu_ps(row + c);
+            __m128 r1 = _mm_loadu_ps(row + channels + c);
+            __m128 r2 = _mm_loadu_ps(row + 2 * channels + c);
+            __m128 r3 = _mm_loadu_ps(row + 3 * channels + c);
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+            _mm_storeu_ps(out[c] + j, r0);
+            _mm_storeu_ps(out[c + 1] + j, r1);
+            _mm_storeu_ps(out[c + 2] + j, r2);
+            _mm_storeu_ps(out[c + 3] + j, r3);
+        }
+
+        for (; c + 2 <= channels; c += 2) {
+            // a = (c, c + 1) of frames 0 and 1, b = the same of frames 2 and 3
+            __m128 a = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), (const __m64 *) (row + c)),
+                                    (const __m64 *) (row + channels + c));
+            __m128 b = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), (const __m64 *) (row + 2 * channels + c)),
+                                    (const __m64 *) (row + 3 * channels + c));
+            _mm_storeu_ps(out[c] + j, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+            _mm_storeu_ps(out[c + 1] + j, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+        }
+
+        if (c < channels)
+            _mm_storeu_ps(out[c] + j, _mm_setr_ps(row[c], row[channels + c], row[2 * channels + c],
+                                                  row[3 * channels + c]));
+    }
+
+    deinterleave_scalar(in, out, channels, j, frames);
+}
+
+ALWAYS_INLINE void interleave_kernel(float *restrict out, float *const *in, const int channels, size_t frames) {
+    size_t j;
+
+    for (j = 0; j + 4 <= frames; j += 4) {
+        float *row = out + j * channels;
+        int c = 0;
+
+        for (; c + 4 <= channels; c += 4) {
+            __m128 r0 = _mm_loadu_ps(in[c] + j);
+            __m128 r1 = _mm_loadu_ps(in[c + 1] + j);
+            __m128 r2 = _mm_loadu_ps(in[c + 2] + j);
+            __m128 r3 = _mm_loadu_ps(in[c + 3] + j);
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+            _mm_storeu_ps(row + c, r0);
+            _mm_storeu_ps(row + channels + c, r1);
+            _mm_storeu_ps(row + 2 * channels + c, r2);
+            _mm_storeu_ps(row + 3 * channels + c, r3);
+        }
+
+        for (; c + 2 <= channels; c += 2) {
+            __m128 a = _mm_loadu_ps(in[c] + j);
+            __m128 b = _mm_loadu_ps(in[c + 1] + j);
+            __m128 lo = _mm_unpacklo_ps(a, b);
+            __m128 hi = _mm_unpackhi_ps(a, b);
+            _mm_storel_pi((__m64 *) (row + c), lo);
+            _mm_storeh_pi((__m64 *) (row + channels + c), lo);
+            _mm_storel_pi((__m64 *) (row + 2 * channels + c), hi);
+            _mm_storeh_pi((__m64 *) (row + 3 * channels + c), hi);
+        }
+
+        for (; c < channels; c++) {
+            row[c] = in[c][j];
+            row[channels + c] = in[c][j + 1];
+            row[2 * channels + c] = in[c][j + 2];
+            row[3 * channels + c] = in[c][j + 3];
+        }
+    }
+
+    interleave_scalar(out, in, channels, j, frames);
+}
+
+static void deinterleave_simd(const sample_t *restrict in, sample_t *const *out, int channels, size_t frames) {
+    SPECIALISE(deinterleave_kernel, in, out, channels, frames);
+}
+
+static void interleave_simd(sample_t *restrict out, sample_t *const *in, int channels, size_t frames) {
+    SPECIALISE(interleave_kernel, out, in, channels, frames);
+}
+
+#elif defined(AT_SIMD_X86)
+
+/* SSE2 kernels: blocks of 2 frames, pairs of channels are transposed at once */
+
+ALWAYS_INLINE void deinterleave_kernel(const double *restrict in, double *const *out, const int channels,
+                                       size_t frames) {
+    size_t j;
+
+    for (j = 0; j + 2 <= frames; j += 2) {
+        const double *row = in + j * channels;
+        int c = 0;
+
+        for (; c + 2 <= channels; c += 2) {
+            __m128d a = _mm_loadu_pd(row + c);
+            __m128d b = _mm_loadu_pd(row + channels + c);
+            _mm_storeu_pd(out[c] + j, _mm_unpacklo_pd(a, b));
+            _mm_storeu_pd(out[c + 1] + j, _mm_unpackhi_pd(a, b));
+        }
+
+        if (c < channels)
+            _mm_storeu_pd(out[c] + j, _mm_set_pd(row[channels + c], row[c]));
+    }
+
+    deinterleave_scalar(in, out, channels, j, frames);
+}
+
+ALWAYS_INLINE void interleave_kernel(double *restrict out, double *const *in, const int channels, size_t frames) {
+    size_t j;
+
+    for (j = 0; j + 2 <= frames; j += 2) {
+        double *row = out + j * channels;
+        int c = 0;
+
+        for (; c + 2 <= channels; c += 2) {
+            __m128d a = _mm_loadu_pd(in[c] + j);
+            __m128d b = _mm_loadu_pd(in[c + 1] + j);
+            _mm_storeu_pd(row + c, _mm_unpacklo_pd(a, b));
+            _mm_storeu_pd(row + channels + c, _mm_unpackhi_pd(a, b));
+        }
+
+        if (c < channels) {
+            row[c] = in[c][j];
+            row[channels + c] = in[c][j + 1];
+        }
+    }
+
+    interleave_scalar(out, in, channels, j, frames);
+}
+
+/* AVX2 kernels: blocks of 4 frames, 4 channels are transposed at once,
+ * remaining pairs of channels use SSE2 transposes */
+
+#define AVX2 __attribute__((target("avx2")))
+
+ALWAYS_INLINE AVX2 void transpose4_pd(__m256d *r0, __m256d *r1, __m256d *r2, __m256d *r3) {
+    __m256d t0 = _mm256_unpacklo_pd(*r0, *r1);     // r0[0] r1[0] r0[2] r1[2]
+    __m256d t1 = _mm256_unpackhi_pd(*r0, *r1);     // r0[1] r1[1] r0[3] r1[3]
+    __m256d t2 = _mm256_unpacklo_pd(*r2, *r3);     // r2[0] r3[0] r2[2] r3[2]
+    __m256d t3 = _mm256_unpackhi_pd(*r2, *r3);     // r2[1] r3[1] r2[3] r3[3]
+
+    *r0 = _mm256_permute2f128_pd(t0, t2, 0x20);
+    *r1 = _mm256_permute2f128_pd(t1, t3, 0x20);
+    *r2 = _mm256_permute2f128_pd(t0, t2, 0x31);
+    *r3 = _mm256_permute2f128_pd(t1, t3, 0x31);
+}
+
+ALWAYS_INLINE AVX2 void deinterleave_kernel_avx2(const double *restrict in, double *const *out,
+                                                 const int channels, size_t frames) {
+    size_t j;
+
+    for (j = 0; j + 4 <= frames; j += 4) {
+        const double *row = in + j * channels;
+        int c = 0;
+
+        for (; c + 4 <= channels; c += 4) {
+            __m256d r0 = _mm256_loadu_pd(row + c);
+            __m256d r1 = _mm256_loadu_pd(row + channels + c);
+            __m256d r2 = _mm256_loadu_pd(row + 2 * channels + c);
+            __m256d r3 = _mm256_loadu_pd(row + 3 * channels + c);
+            transpose4_pd(&r0, &r1, &r2, &r3);
+            _mm256_storeu_pd(out[c] + j, r0);
+            _mm256_storeu_pd(out[c + 1] + j, r1);
+            _mm256_storeu_pd(out[c + 2] + j, r2);
+            _mm256_storeu_pd(out[c + 3] + j, r3);
+        }
+
+        for (; c + 2 <= channels; c += 2) {
+            for (int k = 0; k < 4; k += 2) {
+                __m128d a = _mm_loadu_pd(row + k * channels + c);
+                __m128d b = _mm_loadu_pd(row + (k + 1) * channels + c);
+                _mm_storeu_pd(out[c] + j + k, _mm_unpacklo_pd(a, b));
+                _mm_storeu_pd(out[c + 1] + j + k, _mm_unpackhi_pd(a, b));
+            }
+        }
+
+        if (c < channels)
+            _mm256_storeu_pd(out[c] + j, _mm256_set_pd(row[3 * channels + c], row[2 * channels + c],
+                                                       row[channels + c], row[c]));
+    }
+
+    deinterleave_scalar(in, out, channels, j, frames);
+}
+
+ALWAYS_INLINE AVX2 void interleave_kernel_avx2(double *restrict out, double *const *in, const int channels,
+                                               size_t frames) {
+    size_t j;
+
+    for (j = 0; j + 4 <= frames; j += 4) {
+        double *row = out + j * channels;
+        int c = 0;
+
+        for (; c + 4 <= channels; c += 4) {
+            __m256d r0 = _mm256_loadu_pd(in[c] + j);
+            __m256d r1 = _mm256_loadu_pd(in[c + 1] + j);
+            __m256d r2 = _mm256_loadu_pd(in[c + 2] + j);
+            __m256d r3 = _mm256_loadu_pd(in[c + 3] + j);
+            transpose4_pd(&r0, &r1, &r2, &r3);
+            _mm256_storeu_pd(row + c, r0);
+            _mm256_storeu_pd(row + channels + c, r1);
+            _mm256_storeu_pd(row + 2 * channels + c, r2);
+            _mm256_storeu_pd(row + 3 * channels + c, r3);
+        }
+
+        for (; c + 2 <= channels; c += 2) {
+            for (int k = 0; k < 4; k += 2) {
+                __m128d a = _mm_loadu_pd(in[c] + j + k);
+                __m128d b = _mm_loadu_pd(in[c + 1] + j + k);
+                _mm_storeu_pd(row + k * channels + c, _mm_unpacklo_pd(a, b));
+                _mm_storeu_pd(row + (k + 1) * channels + c, _mm_unpackhi_pd(a, b));
+            }
+        }
+
+        for (; c < channels; c++) {
+            row[c] = in[c][j];
+            row[channels + c] = in[c][j + 1];
+            row[2 * channels + c] = in[c][j + 2];
+            row[3 * channels + c] = in[c][j + 3];
+        }
+    }
+
+    interleave_scalar(out, in, channels, j, frames);
+}
+
+static AVX2 void deinterleave_avx2(const sample_t *restrict in, sample_t *const *out, int channels,
+                                   size_t frames) {
+    SPECIALISE(deinterleave_kernel_avx2, in, out, channels, frames);
+}
+
+static AVX2 void interleave_avx2(sample_t *restrict out, sample_t *const *in, int channels, size_t frames) {
+    SPECIALISE(interleave_kernel_avx2, out, in, channels, frames);
+}
+
+static void deinterleave_simd(const sample_t *restrict in, sample_t *const *out, int channels, size_t frames) {
+    if (__builtin_cpu_supports("avx2"))
+        deinterleave_avx2(in, out, channels, frames);
+    else
+        SPECIALISE(deinterleave_kernel, in, out, channels, frames);
+}
+
+static void interleave_simd(sample_t *restrict out, sample_t *const *in, int channels, size_t frames) {
+    if (__builtin_cpu_supports("avx2"))
+        interleave_avx2(out, in, channels, frames);
+    else
+        SPECIALISE(interleave_kernel, out, in, channels, frames);
+}
+
+#else
+
+/* scalar fallback, specialised kernels are left to auto-vectorization of compiler */
+
+ALWAYS_INLINE void deinterleave_kernel(const sample_t *restrict in, sample_t *const *out, const int channels,
+                                       size_t frames) {
+    deinterleave_scalar(in, out, channels, 0, frames);
+}
+
+ALWAYS_INLINE void interleave_kernel(sample_t *restrict out, sample_t *const *in, const int channels,
+                                     size_t frames) {
+    interleave_scalar(out, in, channels, 0, frames);
+}
+
+static void deinterleave_simd(const sample_t *restrict in, sample_t *const *out, int channels, size_t frames) {
+    SPECIALISE(deinterleave_kernel, in, out, channels, frames);
+}
+
+static void interleave_simd(sample_t *restrict out, sample_t *const *in, int channels, size_t frames) {
+    SPECIALISE(interleave_kernel, out, in, channels, frames);
+}
+
+#endif
+
+void at_deinterleave(const sample_t *restrict in, sample_t *const *out, int channels, size_t frames) {
+    // mono data are not interleaved at all
+    if (channels == 1)
+        memcpy(out[0], in, sizeof(*in) * frames);
+    else
+        deinterleave_simd(in, out, channels, frames);
+}
+
+void at_interleave(sample_t *restrict out, sample_t *const *in, int channels, size_t frames) {
+    if (channels == 1)
+        memcpy(out, in[0], sizeof(*out) * frames);
+    else
+        interleave_simd(out, in, channels, frames);
+}
+
+void at_convert_to_float(float *restrict out, const sample_t *restrict in, size_t count) {
+#ifdef AT_SINGLE_PRECISION
+    memcpy(out, in, sizeof(*out) * count);
+#else
+    size_t i = 0;
+
+#ifdef AT_SIMD_X86
+    for (; i + 4 <= count; i += 4) {
+        __m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(in + i));
+        __m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(in + i + 2));
+        _mm_storeu_ps(out + i, _mm_movelh_ps(lo, hi));
+    }
+#endif
+
+    for (; i < count; i++)
+        out[i] = (float) in[i];
+#endif
+}
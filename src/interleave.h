@@ -0,0 +1,39 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef INTERLEAVE_H_
+#define INTERLEAVE_H_
+
+#include <stddef.h>
+#include "common.h"
+
+/* Conversion between interleaved frames and separate channel buffers. Kernels for 1 to 8
+ * channels are specialised and on x86 use SSE2 (AVX2 when supported by CPU) transposes,
+ * so interleaved data are walked only once. Other platforms use scalar fallback, which
+ * can also be forced by building with AT_NO_SIMD defined.
+ */
+
+/* split 'frames' interleaved frames of 'in' into separate channel buffers 'out' */
+void at_deinterleave(const sample_t *restrict in, sample_t *const *out, int channels, size_t frames);
+
+/* join separate channel buffers 'in' into 'frames' interleaved frames of 'out' */
+void at_interleave(sample_t *restrict out, sample_t *const *in, int channels, size_t frames);
+
+/* convert samples into float format, e.g. for PA server */
+void at_convert_to_float(float *restrict out, const sample_t *restrict in, size_t count);
+
+#endif /* INTERLEAVE_H_ */
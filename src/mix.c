@@ -0,0 +1,413 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include "mix.h"
+
+#if !defined(AT_NO_SIMD) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#    define AT_SIMD_X86
+#    include <immintrin.h>
+#endif
+
+#define ALWAYS_INLINE static inline __attribute__((always_inline))
+
+#define CENTER_GAIN       0.25                  // center created from each front channel
+#define SURROUND_GAIN     0.2                   // surround channel created from front channel of the same side
+#define SIDE_GAIN         M_SQRT1_2             // side channel created from surround channel of the same side
+#define FOLD_GAIN         M_SQRT1_2             // channel missing in output folded into lower one (-3 dB)
+
+#if MAX_CHANNELS != 12
+#    error "Layouts and kernel tables of mixing are written for 12 channels."
+#endif
+
+// positions of channels of each layout, indexed by count of channels; counts without a layout are NULL
+static const int *const layouts[MAX_CHANNELS + 1] = {
+        [1] = (const int[]) {FL},
+        [2] = (const int[]) {FL, FR},
+        [3] = (const int[]) {FL, FR, C},
+        [4] = (const int[]) {FL, FR, SL, SR},
+        [5] = (const int[]) {FL, FR, C, SL, SR},
+        [6] = (const int[]) {FL, FR, C, LFE, SL, SR},
+        [8] = (const int[]) {FL, FR, C, LFE, SL, SR, SSL, SSR},
+        [12] = (const int[]) {FL, FR, C, LFE, SL, SR, SSL, SSR, TFL, TFR, TBL, TBR}
+};
+
+// layout of LFE only output
+static const int lfe_layout[] = {LFE};
+
+/* scalar kernel, used for tails of frames and as a fallback; all input samples of a frame
+ * are read before its output samples are stored, so channels are mixed in place */
+
+ALWAYS_INLINE void mix_scalar(sample_t *const *channel, const sample_t *matrix, const int in, const int out,
+                              size_t start, size_t frames) {
+    for (size_t j = start; j < frames; j++) {
+        sample_t x[MAX_CHANNELS];
+
+        for (int c = 0; c < in; c++)
+            x[c] = channel[c][j];
+
+        for (int o = 0; o < out; o++) {
+            sample_t y = 0;
+
+            for (int c = 0; c < in; c++)
+                y += matrix[o * in + c] * x[c];
+            channel[o][j] = y;
+        }
+    }
+}
+
+ALWAYS_INLINE void mix_plain(sample_t *const *channel, const sample_t *matrix, const int in, const int out,
+                             size_t frames) {
+    mix_scalar(channel, matrix, in, out, 0, frames);
+}
+
+#ifdef AT_SIMD_X86
+
+/* Vector primitives of each instruction set; the kernel is written once in MIX_KERNEL()
+ * and instantiated for SSE2 and AVX2/FMA. */
+
+#ifdef AT_SINGLE_PRECISION
+typedef __m128 vec_sse;
+typedef __m256 vec_avx2;
+#    define WIDTH_sse           4
+#    define WIDTH_avx2          8
+#    define SSE(op)             _mm_##op##_ps
+#    define AVX(op)             _mm256_##op##_ps
+#else
+typedef __m128d vec_sse;
+typedef __m256d vec_avx2;
+#    define WIDTH_sse           2
+#    define WIDTH_avx2          4
+#    define SSE(op)             _mm_##op##_pd
+#    define AVX(op)             _mm256_##op##_pd
+#endif
+
+#define load_sse(p)             SSE(loadu)(p)
+#define store_sse(p, v)         SSE(storeu)(p, v)
+#define set1_sse(x)             SSE(set1)(x)
+#define mul_sse(a, b)           SSE(mul)(a, b)
+#define fmadd_sse(a, b, c)      SSE(add)(SSE(mul)(a, b), c)
+
+#define load_avx2(p)            AVX(loadu)(p)
+#define store_avx2(p, v)        AVX(storeu)(p, v)
+#define set1_avx2(x)            AVX(set1)(x)
+#define mul_avx2(a, b)          AVX(mul)(a, b)
+#define fmadd_avx2(a, b, c)     AVX(fmadd)(a, b, c)
+
+#define AVX2 __attribute__((target("avx2,fma")))
+
+/* Vectors of samples of all input channels are loaded, then each output vector is summed
+ * from them by broadcast coefficients. Counts of channels are constants of each specialised
+ * kernel, so loops over channels are unrolled and vectors stay in registers. */
+#define MIX_KERNEL(isa, attr)                                                                                 \
+ALWAYS_INLINE attr void mix_##isa(sample_t *const *channel, const sample_t *matrix, const int in,             \
+                                  const int out, size_t frames) {                                             \
+    vec_##isa coef[MAX_CHANNELS * MAX_CHANNELS];                                                              \
+    size_t j;                                                                                                 \
+                                                                                                              \
+    for (int k = 0; k < in * out; k++)                                                                        \
+        coef[k] = set1_##isa(matrix[k]);                                                                      \
+                                                                                                              \
+    for (j = 0; j + WIDTH_##isa <= frames; j += WIDTH_##isa) {                                                \
+        vec_##isa x[MAX_CHANNELS];                                                                            \
+                                                                                                              \
+        for (int c = 0; c < in; c++)                                                                          \
+            x[c] = load_##isa(channel[c] + j);                                                                \
+                                                                                                              \
+        for (int o = 0; o < out; o++) {                                                                       \
+            vec_##isa y = mul_##isa(coef[o * in], x[0]);                                                      \
+                                                                                                              \
+            for (int c = 1; c < in; c++)                                                                      \
+                y = fmadd_##isa(coef[o * in + c], x[c], y);                                                   \
+            store_##isa(channel[o] + j, y);                                                                   \
+        }                                                                                                     \
+    }                                                                                                         \
+                                                                                                              \
+    mix_scalar(channel, matrix, in, out, j, frames);                                                          \
+}
+
+MIX_KERNEL(sse, )
+MIX_KERNEL(avx2, AVX2)
+
+#endif
+
+/* Kernels specialised for each pair of counts of input and output channels of layouts up to
+ * 7.1 and of 7.1.4, kept in tables indexed by both counts; other counts, which are mixed only
+ * by matrix of user, share a kernel looping over counts given at run time */
+
+#define MIX_SPECIALISE(isa, attr, in, out)                                                                    \
+static attr void mix_##isa##_##in##x##out(sample_t *const *channel, const sample_t *matrix, int in_channels,  \
+                                          int out_channels, size_t frames) {                                  \
+    (void) in_channels;                                                                                       \
+    (void) out_channels;                                                                                      \
+    mix_##isa(channel, matrix, in, out, frames);                                                              \
+}
+
+#define MIX_GENERIC(isa, attr)                                                                                \
+static attr void mix_##isa##_any(sample_t *const *channel, const sample_t *matrix, int in_channels,           \
+                                 int out_channels, size_t frames) {                                           \
+    mix_##isa(channel, matrix, in_channels, out_channels, frames);                                            \
+}
+
+#define MIX_SPECIALISE_OUT(isa, attr, in)                                                                     \
+    MIX_SPECIALISE(isa, attr, in, 1) MIX_SPECIALISE(isa, attr, in, 2) MIX_SPECIALISE(isa, attr, in, 3)        \
+    MIX_SPECIALISE(isa, attr, in, 4) MIX_SPECIALISE(isa, attr, in, 5) MIX_SPECIALISE(isa, attr, in, 6)        \
+    MIX_SPECIALISE(isa, attr, in, 7) MIX_SPECIALISE(isa, attr, in, 8) MIX_SPECIALISE(isa, attr, in, 12)
+
+#define MIX_SPECIALISE_ALL(isa, attr)                                                                         \
+    MIX_SPECIALISE_OUT(isa, attr, 1) MIX_SPECIALISE_OUT(isa, attr, 2) MIX_SPECIALISE_OUT(isa, attr, 3)        \
+    MIX_SPECIALISE_OUT(isa, attr, 4) MIX_SPECIALISE_OUT(isa, attr, 5) MIX_SPECIALISE_OUT(isa, attr, 6)        \
+    MIX_SPECIALISE_OUT(isa, attr, 7) MIX_SPECIALISE_OUT(isa, attr, 8) MIX_SPECIALISE_OUT(isa, attr, 12)       \
+    MIX_GENERIC(isa, attr)
+
+#define MIX_ROW(isa, in)                                                                                      \
+    {mix_##isa##_##in##x1, mix_##isa##_##in##x2, mix_##isa##_##in##x3, mix_##isa##_##in##x4,                  \
+     mix_##isa##_##in##x5, mix_##isa##_##in##x6, mix_##isa##_##in##x7, mix_##isa##_##in##x8,                  \
+     mix_##isa##_any, mix_##isa##_any, mix_##isa##_any, mix_##isa##_##in##x12}
+
+#define MIX_ROW_ANY(isa)                                                                                      \
+    {mix_##isa##_any, mix_##isa##_any, mix_##isa##_any, mix_##isa##_any, mix_##isa##_any, mix_##isa##_any,    \
+     mix_##isa##_any, mix_##isa##_any, mix_##isa##_any, mix_##isa##_any, mix_##isa##_any, mix_##isa##_any}
+
+#define MIX_TABLE(isa)                                                                                        \
+    {MIX_ROW(isa, 1), MIX_ROW(isa, 2), MIX_ROW(isa, 3), MIX_ROW(isa, 4), MIX_ROW(isa, 5), MIX_ROW(isa, 6),    \
+     MIX_ROW(isa, 7), MIX_ROW(isa, 8), MIX_ROW_ANY(isa), MIX_ROW_ANY(isa), MIX_ROW_ANY(isa), MIX_ROW(isa, 12)}
+
+#ifdef AT_SIMD_X86
+
+MIX_SPECIALISE_ALL(sse, )
+MIX_SPECIALISE_ALL(avx2, AVX2)
+
+static const at_mix_kernel_t kernels_sse[MAX_CHANNELS][MAX_CHANNELS] = MIX_TABLE(sse);
+static const at_mix_kernel_t kernels_avx2[MAX_CHANNELS][MAX_CHANNELS] = MIX_TABLE(avx2);
+
+#else
+
+MIX_SPECIALISE_ALL(plain, )
+
+static const at_mix_kernel_t kernels_plain[MAX_CHANNELS][MAX_CHANNELS] = MIX_TABLE(plain);
+
+#endif
+
+// select kernel for counts of channels of matrix, none is needed for identity
+static void mix_select_kernel(at_mix_t *mix) {
+    int in = mix->in_channels, out = mix->out_channels;
+    bool identity = in == out;
+
+    for (int o = 0; o < out; o++)
+        for (int c = 0; c < in; c++)
+            identity = identity && mix->matrix[o * in + c] == (o == c ? 1 : 0);
+
+    if (identity)
+        mix->kernel = NULL;
+    else {
+#ifdef AT_SIMD_X86
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+            mix->kernel = kernels_avx2[in - 1][out - 1];
+        else
+            mix->kernel = kernels_sse[in - 1][out - 1];
+#else
+        mix->kernel = kernels_plain[in - 1][out - 1];
+#endif
+    }
+}
+
+// add row of coefficients multiplied by gain to another one
+static void row_add(double *row, const double *from, double gain) {
+    for (int c = 0; c < MAX_CHANNELS; c++)
+        row[c] += gain * from[c];
+}
+
+// fold channel of input missing in output into lower channel of the same side
+static void fold(double rows[][MAX_CHANNELS], const bool *present, const bool *kept, int from, int to) {
+    if (present[from] && !kept[from])
+        row_add(rows[to], rows[from], FOLD_GAIN);
+}
+
+const int *at_mix_layout(int channels, bool lfe_only) {
+    if (lfe_only)
+        return lfe_layout;
+
+    return channels >= 1 && channels <= MAX_CHANNELS ? layouts[channels] : NULL;
+}
+
+/* Default matrix is derived from rows of all positions, each of them with a coefficient
+ * for every input channel. Positions of input get their channels; missing ones are created
+ * as in the original upmix: right channel of mono input is a copy of the left one, center
+ * is a quarter of the sum of front channels, surround channels are 20 % of front ones, side
+ * channels of 7.1 are surround ones at -3 dB, top channels stay silent and LFE is the mean
+ * of all other positions of 5.1. Channels of input which output does not have are folded
+ * at -3 dB down to front channels: top channels into front and surround ones, side channels
+ * into surround ones (LFE is dropped); mono output is the mean of front channels folded so. */
+int at_mix_init(at_mix_t *mix, int in_channels, int out_channels, bool lfe_only) {
+    const int *in_layout = at_mix_layout(in_channels, false);
+    const int *out_layout = at_mix_layout(out_channels, lfe_only);
+    double rows[MAX_CHANNELS][MAX_CHANNELS];
+    bool present[MAX_CHANNELS] = {false};   // position is a channel of input
+    bool kept[MAX_CHANNELS] = {false};      // position is a channel of output
+
+    if (in_channels < 1 || in_channels > MAX_CHANNELS || out_channels < 1 || out_channels > MAX_CHANNELS) {
+        printf("Processing of multichannel audio with more than %d channels is not supported.\n", MAX_CHANNELS);
+        exit(1);
+    }
+
+    mix->in_channels = in_channels;
+    mix->out_channels = out_channels;
+    mix->lfe = -1;
+
+    // channels without known positions are passed through, or have to be mixed by matrix of user
+    if (in_layout == NULL || out_layout == NULL) {
+        memset(mix->matrix, 0, sizeof(mix->matrix));
+        for (int c = 0; c < MIN(in_channels, out_channels); c++)
+            mix->matrix[c * in_channels + c] = 1;
+
+        mix_select_kernel(mix);
+        return in_channels == out_channels ? 0 : -1;
+    }
+
+    memset(rows, 0, sizeof(rows));
+    for (int c = 0; c < in_channels; c++) {
+        rows[in_layout[c]][c] = 1.0;
+        present[in_layout[c]] = true;
+    }
+    for (int o = 0; o < out_channels; o++)
+        kept[out_layout[o]] = true;
+
+    // missing positions are created from front channels
+    if (!present[FR])
+        row_add(rows[FR], rows[FL], 1.0);
+    if (!present[C]) {
+        row_add(rows[C], rows[FL], CENTER_GAIN);
+        row_add(rows[C], rows[FR], CENTER_GAIN);
+    }
+    if (!present[SL])
+        row_add(rows[SL], rows[FL], SURROUND_GAIN);
+    if (!present[SR])
+        row_add(rows[SR], rows[FR], SURROUND_GAIN);
+    if (!present[SSL])
+        row_add(rows[SSL], rows[SL], SIDE_GAIN);
+    if (!present[SSR])
+        row_add(rows[SSR], rows[SR], SIDE_GAIN);
+    if (!present[LFE]) {
+        row_add(rows[LFE], rows[FL], 1.0 / 5);
+        row_add(rows[LFE], rows[FR], 1.0 / 5);
+        row_add(rows[LFE], rows[C], 1.0 / 5);
+        row_add(rows[LFE], rows[SL], 1.0 / 5);
+        row_add(rows[LFE], rows[SR], 1.0 / 5);
+    }
+
+    // channels of input missing in output are folded into front channels
+    if (kept[FL]) {
+        fold(rows, present, kept, TFL, FL);
+        fold(rows, present, kept, TFR, FR);
+        fold(rows, present, kept, TBL, SL);
+        fold(rows, present, kept, TBR, SR);
+        fold(rows, present, kept, SSL, SL);
+        fold(rows, present, kept, SSR, SR);
+
+        if (present[C] && !kept[C]) {
+            row_add(rows[FL], rows[C], FOLD_GAIN);
+            row_add(rows[FR], rows[C], FOLD_GAIN);
+        }
+        fold(rows, present, kept, SL, FL);
+        fold(rows, present, kept, SR, FR);
+        if (present[FR] && !kept[FR]) {
+            row_add(rows[FL], rows[FR], 1.0);
+            for (int c = 0; c < MAX_CHANNELS; c++)
+                rows[FL][c] *= 0.5;
+        }
+    }
+
+    for (int o = 0; o < out_channels; o++) {
+        for (int c = 0; c < in_channels; c++)
+            mix->matrix[o * in_channels + c] = (sample_t) rows[out_layout[o]][c];
+
+        // LFE created from other channels is low-pass filtered
+        if (out_layout[o] == LFE && !present[LFE])
+            mix->lfe = o;
+    }
+
+    mix_select_kernel(mix);
+    return 0;
+}
+
+void at_mix_load(at_mix_t *mix, const char *path) {
+    int in = mix->in_channels, out = mix->out_channels;
+    int rows = 0;
+    char line[1024];
+    FILE *file;
+
+    if ((file = fopen(path, "r")) == NULL) {
+        fprintf(stderr, "Error: Unable to open mixing matrix '%s'.\n", path);
+        exit(1);
+    }
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char *p = line, *end;
+        int count = 0;
+
+        // comment is skipped, commas separate coefficients as spaces do
+        line[strcspn(line, "#")] = '\0';
+        for (char *s = line; *s != '\0'; s++)
+            if (*s == ',')
+                *s = ' ';
+
+        for (double value = strtod(p, &end); end != p; value = strtod(p, &end)) {
+            if (rows < out && count < in)
+                mix->matrix[rows * in + count] = (sample_t) value;
+            count++;
+            p = end;
+        }
+
+        while (isspace((unsigned char) *p))
+            p++;
+
+        if (*p != '\0') {
+            fprintf(stderr, "Error: Invalid coefficient '%s' in mixing matrix '%s'.\n", strtok(p, " \t\r\n"),
+                    path);
+            exit(1);
+        }
+
+        if (count == 0)
+            continue;
+
+        if (count != in) {
+            fprintf(stderr, "Error: Row %d of mixing matrix '%s' has %d coefficients, input has %d channels.\n",
+                    rows + 1, path, count, in);
+            exit(1);
+        }
+        rows++;
+    }
+
+    fclose(file);
+
+    if (rows != out) {
+        fprintf(stderr, "Error: Mixing matrix '%s' has %d rows, output has %d channels.\n", path, rows, out);
+        exit(1);
+    }
+
+    mix_select_kernel(mix);
+}
+
+void at_mix_process(const at_mix_t *mix, audio_container_t *container) {
+    if (mix->kernel != NULL)
+        mix->kernel(container->channel, mix->matrix, mix->in_channels, mix->out_channels, container->length);
+}
@@ -0,0 +1,64 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MIX_H_
+#define MIX_H_
+
+#include <stdbool.h>
+#include "common.h"
+#include "dsp.h"
+
+/* Mixing of input channels into output channels by a coefficient matrix. Each output
+ * channel is a weighted sum of all input channels; a frame is mixed in place in a single
+ * pass: input channels are taken from the first buffers of a container and output channels
+ * replace them in order of output layout. A kernel specialised for the pair of channel
+ * counts is selected when the matrix is set up.
+ *
+ * Layout of N channels is given by its count: 1 = FL (mono), 2 = FL FR, 3 = FL FR C,
+ * 4 = FL FR SL SR, 5 = FL FR C SL SR, 6 = FL FR C LFE SL SR, 8 = 6 + SSL SSR (7.1),
+ * 12 = 8 + TFL TFR TBL TBR (7.1.4). Output of LFE only is a single LFE channel. Other
+ * counts have no layout, they are mixed only by matrix of user.
+ */
+
+typedef void (*at_mix_kernel_t)(sample_t *const *channel, const sample_t *matrix, int in_channels, int out_channels,
+                                size_t frames);
+
+typedef struct at_mix_t {
+    int in_channels;
+    int out_channels;
+    sample_t matrix[MAX_CHANNELS * MAX_CHANNELS];  // row of 'in_channels' coefficients for each output channel
+    int lfe;                        // output channel created as LFE, low-pass filtered after mixing; -1 if none
+    at_mix_kernel_t kernel;         // kernel specialised for count of input and output channels, NULL for identity
+} at_mix_t;
+
+/* positions of channels of layout of 'channels' channels, NULL if the count has no layout */
+const int *at_mix_layout(int channels, bool lfe_only);
+
+/* Set up default matrix: channels present in both layouts are copied, missing ones are
+ * upmixed from front channels and channels missing in output are folded into front ones.
+ * Returns -1 if a count of channels has no layout and counts differ, matrix has to be loaded then. */
+int at_mix_init(at_mix_t *mix, int in_channels, int out_channels, bool lfe_only);
+
+/* Replace matrix by one read from text file: a row of 'in_channels' coefficients separated
+ * by spaces or commas for each output channel, '#' starts a comment. LFE output created by
+ * at_mix_init() stays low-pass filtered. Exits on error. */
+void at_mix_load(at_mix_t *mix, const char *path);
+
+/* mix channels of container */
+void at_mix_process(const at_mix_t *mix, audio_container_t *container);
+
+#endif /* MIX_H_ */
@@ -16,7 +16,61 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "pa_play.h"
+#include "common.h"
+#include "mix.h"
+
+/* Playback stream. Asynchronous stream is fed from a ring of samples: processing
+ * prefills the ring and write callback of the stream, running on mainloop thread,
+ * pulls data from it whenever the server requests more. Processing therefore runs
+ * ahead of the device and blocks only when the ring is full.
+ */
+struct at_pulse_t {
+    pa_simple *simple;                  // stream of Simple API, NULL for asynchronous stream
+    pa_threaded_mainloop *mainloop;
+    pa_context *context;
+    pa_stream *stream;
+    pa_sample_spec spec;
+
+    char *buffer;                       // ring of samples waiting for playback
+    size_t size;                        // size of ring in bytes, multiple of frame size
+    size_t head;                        // bytes queued by processing
+    size_t tail;                        // bytes passed to server, changed with mainloop lock held
+};
+
+// server positions of positions of channels of layouts
+static const pa_channel_position_t positions[MAX_CHANNELS] = {
+        [FL] = PA_CHANNEL_POSITION_FRONT_LEFT,
+        [FR] = PA_CHANNEL_POSITION_FRONT_RIGHT,
+        [C] = PA_CHANNEL_POSITION_FRONT_CENTER,
+        [LFE] = PA_CHANNEL_POSITION_LFE,
+        [SL] = PA_CHANNEL_POSITION_REAR_LEFT,
+        [SR] = PA_CHANNEL_POSITION_REAR_RIGHT,
+        [SSL] = PA_CHANNEL_POSITION_SIDE_LEFT,
+        [SSR] = PA_CHANNEL_POSITION_SIDE_RIGHT,
+        [TFL] = PA_CHANNEL_POSITION_TOP_FRONT_LEFT,
+        [TFR] = PA_CHANNEL_POSITION_TOP_FRONT_RIGHT,
+        [TBL] = PA_CHANNEL_POSITION_TOP_REAR_LEFT,
+        [TBR] = PA_CHANNEL_POSITION_TOP_REAR_RIGHT
+};
+
+// channel map of layout of output, counts of channels without layout are played as auxiliary channels
+static void pulse_channel_map(pa_channel_map *channel_map, int channels) {
+    const int *layout = at_mix_layout(channels, channels == 1 && at_get_lfe_only_setting());
+
+    if (layout == NULL) {
+        pa_channel_map_init_extend(channel_map, (unsigned) channels, PA_CHANNEL_MAP_AUX);
+        return;
+    }
+
+    pa_channel_map_init(channel_map);
+    channel_map->channels = (uint8_t) channels;
+
+    for (int i = 0; i < channels; i++)
+        channel_map->map[i] = positions[layout[i]];
+}
 
 pa_simple *at_pulse_init(int channels, int samplerate) {
     int error;
@@ -35,66 +89,7 @@ pa_simple *at_pulse_init(int channels, int samplerate) {
     // Connection to server
     pa_simple *s = NULL;
 
-    // init channel map
-    pa_channel_map_init(&channel_map);
-
-    // if playing LFE or mono file
-    if (channels == 1) {
-        channel_map.channels = 1;
-
-        // LFE specified
-        if (at_get_lfe_only_setting() == true) {
-            channel_map.map[0] = PA_CHANNEL_POSITION_LFE;
-        }
-        else
-            channel_map.map[0] = PA_CHANNEL_POSITION_LEFT;
-    }
-
-    // 2-channel audio
-    if (channels == 2)
-        pa_channel_map_init_stereo(&channel_map);
-
-    // 3-channel audio: FL, FR, C
-    if (channels == 3) {
-        pa_channel_map_init(&channel_map);
-        channel_map.channels = 3;
-        channel_map.map[0] = PA_CHANNEL_POSITION_FRONT_LEFT;
-        channel_map.map[1] = PA_CHANNEL_POSITION_FRONT_RIGHT;
-        channel_map.map[2] = PA_CHANNEL_POSITION_FRONT_CENTER;
-    }
-
-    // 4-channel audio: FL, FR, SL, SR
-    if (channels == 4) {
-        pa_channel_map_init(&channel_map);
-        channel_map.channels = 4;
-        channel_map.map[0] = PA_CHANNEL_POSITION_FRONT_LEFT;
-        channel_map.map[1] = PA_CHANNEL_POSITION_FRONT_RIGHT;
-        channel_map.map[2] = PA_CHANNEL_POSITION_REAR_LEFT;
-        channel_map.map[3] = PA_CHANNEL_POSITION_REAR_RIGHT;
-    }
-
-    // 5-channel audio: FL, FR, C, SL, SR
-    if (channels == 5) {
-        pa_channel_map_init(&channel_map);
-        channel_map.channels = 5;
-        channel_map.map[0] = PA_CHANNEL_POSITION_FRONT_LEFT;
-        channel_map.map[1] = PA_CHANNEL_POSITION_FRONT_RIGHT;
-        channel_map.map[2] = PA_CHANNEL_POSITION_FRONT_CENTER;
-        channel_map.map[3] = PA_CHANNEL_POSITION_REAR_LEFT;
-        channel_map.map[4] = PA_CHANNEL_POSITION_REAR_RIGHT;
-    }
-
-    // 6-channel audio: FL, FR, C, LFE, SL, SR
-    if (channels == 6) {
-        pa_channel_map_init(&channel_map);
-        channel_map.channels = 6;
-        channel_map.map[0] = PA_CHANNEL_POSITION_FRONT_LEFT;
-        channel_map.map[1] = PA_CHANNEL_POSITION_FRONT_RIGHT;
-        channel_map.map[2] = PA_CHANNEL_POSITION_FRONT_CENTER;
-        channel_map.map[3] = PA_CHANNEL_POSITION_LFE;
-        channel_map.map[4] = PA_CHANNEL_POSITION_REAR_LEFT;
-        channel_map.map[5] = PA_CHANNEL_POSITION_REAR_RIGHT;
-    }
+    pulse_channel_map(&channel_map, channels);
 
     /* Create a new playback stream */
     if (!(s = pa_simple_new(NULL, "Audio Toolkit", PA_STREAM_PLAYBACK, NULL,
@@ -106,3 +101,364 @@ pa_simple *at_pulse_init(int channels, int samplerate) {
     // init completed
     return s;
 }
+
+// pass queued samples to server, as many as it accepts; called with mainloop lock held
+static void pulse_fill(at_pulse_t *pulse) {
+    size_t writable = pa_stream_writable_size(pulse->stream);
+    size_t available = __atomic_load_n(&pulse->head, __ATOMIC_ACQUIRE) - pulse->tail;
+
+    if (writable == (size_t) -1)
+        return;
+
+    size_t n = MIN(writable, available);
+
+    while (n > 0) {
+        size_t offset = pulse->tail % pulse->size;
+        size_t chunk = MIN(n, pulse->size - offset);
+
+        if (pa_stream_write(pulse->stream, pulse->buffer + offset, chunk, NULL, 0, PA_SEEK_RELATIVE) < 0) {
+            fprintf(stderr, __FILE__": pa_stream_write() failed: %s\n",
+                    pa_strerror(pa_context_errno(pulse->context)));
+            exit(1);
+        }
+
+        __atomic_store_n(&pulse->tail, pulse->tail + chunk, __ATOMIC_RELEASE);
+        n -= chunk;
+    }
+
+    // wake processing waiting for free space
+    pa_threaded_mainloop_signal(pulse->mainloop, 0);
+}
+
+static void stream_write_cb(pa_stream *stream, size_t nbytes, void *userdata) {
+    pulse_fill(userdata);
+}
+
+static void context_state_cb(pa_context *context, void *userdata) {
+    pa_threaded_mainloop_signal(userdata, 0);
+}
+
+static void stream_state_cb(pa_stream *stream, void *userdata) {
+    pa_threaded_mainloop_signal(userdata, 0);
+}
+
+static void stream_drain_cb(pa_stream *stream, int success, void *userdata) {
+    pa_threaded_mainloop_signal(userdata, 0);
+}
+
+// release asynchronous stream; mainloop must not be locked
+static void pulse_disconnect(at_pulse_t *pulse) {
+    if (pulse->mainloop != NULL)
+        pa_threaded_mainloop_stop(pulse->mainloop);
+
+    if (pulse->stream != NULL) {
+        pa_stream_disconnect(pulse->stream);
+        pa_stream_unref(pulse->stream);
+    }
+
+    if (pulse->context != NULL) {
+        pa_context_disconnect(pulse->context);
+        pa_context_unref(pulse->context);
+    }
+
+    if (pulse->mainloop != NULL)
+        pa_threaded_mainloop_free(pulse->mainloop);
+
+    pulse->stream = NULL;
+    pulse->context = NULL;
+    pulse->mainloop = NULL;
+}
+
+// connect asynchronous playback stream; returns -1 when server is not usable
+static int pulse_connect(at_pulse_t *pulse, int channels) {
+    pa_channel_map channel_map;
+    pa_context_state_t context_state;
+    pa_stream_state_t stream_state;
+
+    pulse_channel_map(&channel_map, channels);
+
+    if ((pulse->mainloop = pa_threaded_mainloop_new()) == NULL)
+        return -1;
+
+    pulse->context = pa_context_new(pa_threaded_mainloop_get_api(pulse->mainloop), "Audio Toolkit");
+    if (pulse->context == NULL)
+        return -1;
+
+    pa_context_set_state_callback(pulse->context, context_state_cb, pulse->mainloop);
+
+    if (pa_threaded_mainloop_start(pulse->mainloop) < 0)
+        return -1;
+
+    pa_threaded_mainloop_lock(pulse->mainloop);
+
+    if (pa_context_connect(pulse->context, NULL, PA_CONTEXT_NOFLAGS, NULL) < 0) {
+        pa_threaded_mainloop_unlock(pulse->mainloop);
+        return -1;
+    }
+
+    while ((context_state = pa_context_get_state(pulse->context)) != PA_CONTEXT_READY) {
+        if (!PA_CONTEXT_IS_GOOD(context_state)) {
+            pa_threaded_mainloop_unlock(pulse->mainloop);
+            return -1;
+        }
+        pa_threaded_mainloop_wait(pulse->mainloop);
+    }
+
+    if ((pulse->stream = pa_stream_new(pulse->context, "audio stream", &pulse->spec, &channel_map)) == NULL) {
+        pa_threaded_mainloop_unlock(pulse->mainloop);
+        return -1;
+    }
+
+    pa_stream_set_state_callback(pulse->stream, stream_state_cb, pulse->mainloop);
+    pa_stream_set_write_callback(pulse->stream, stream_write_cb, pulse);
+
+    /* target latency is the amount of data held by server (tlength), server asks for
+     * more data in chunks of at least minreq bytes; other attributes are left to server */
+    pa_buffer_attr attr = {
+            .maxlength = (uint32_t) -1,
+            .tlength = (uint32_t) pa_usec_to_bytes((pa_usec_t) at_get_pulse_latency() * 1000, &pulse->spec),
+            .prebuf = (uint32_t) -1,
+            .minreq = at_get_pulse_minreq() > 0 ?
+                      (uint32_t) pa_usec_to_bytes((pa_usec_t) at_get_pulse_minreq() * 1000, &pulse->spec) :
+                      (uint32_t) -1,
+            .fragsize = (uint32_t) -1
+    };
+
+    if (pa_stream_connect_playback(pulse->stream, NULL, &attr,
+                                   PA_STREAM_ADJUST_LATENCY | PA_STREAM_AUTO_TIMING_UPDATE |
+                                   PA_STREAM_INTERPOLATE_TIMING, NULL, NULL) < 0) {
+        pa_threaded_mainloop_unlock(pulse->mainloop);
+        return -1;
+    }
+
+    while ((stream_state = pa_stream_get_state(pulse->stream)) != PA_STREAM_READY) {
+        if (!PA_STREAM_IS_GOOD(stream_state)) {
+            pa_threaded_mainloop_unlock(pulse->mainloop);
+            return -1;
+        }
+        pa_threaded_mainloop_wait(pulse->mainloop);
+    }
+
+    // server may adjust requested attributes
+    const pa_buffer_attr *actual = pa_stream_get_buffer_attr(pulse->stream);
+    if (actual != NULL)
+        printf("PulseAudio buffer: tlength %.1f ms, minreq %.1f ms\n",
+               pa_bytes_to_usec(actual->tlength, &pulse->spec) / 1000.0,
+               pa_bytes_to_usec(actual->minreq, &pulse->spec) / 1000.0);
+
+    pa_threaded_mainloop_unlock(pulse->mainloop);
+
+    return 0;
+}
+
+// sample rate of default sink, or of server when sink is not known
+typedef struct pulse_rate_query_t {
+    pa_threaded_mainloop *mainloop;
+    int rate;
+    bool done;
+} pulse_rate_query_t;
+
+static void sink_info_cb(pa_context *context, const pa_sink_info *sink, int eol, void *userdata) {
+    pulse_rate_query_t *query = userdata;
+
+    if (eol == 0 && sink != NULL)
+        query->rate = (int) sink->sample_spec.rate;
+    if (eol != 0) {
+        query->done = true;
+        pa_threaded_mainloop_signal(query->mainloop, 0);
+    }
+}
+
+static void server_info_cb(pa_context *context, const pa_server_info *server, void *userdata) {
+    pulse_rate_query_t *query = userdata;
+    pa_operation *operation = NULL;
+
+    if (server != NULL) {
+        query->rate = (int) server->sample_spec.rate;
+
+        if (server->default_sink_name != NULL)
+            operation = pa_context_get_sink_info_by_name(context, server->default_sink_name, sink_info_cb, query);
+    }
+
+    if (operation != NULL)
+        pa_operation_unref(operation);
+    else {
+        query->done = true;
+        pa_threaded_mainloop_signal(query->mainloop, 0);
+    }
+}
+
+// connect context and wait for reply of the query; called with mainloop lock held
+static void pulse_query_rate(pa_context *context, pulse_rate_query_t *query) {
+    pa_context_state_t context_state;
+    pa_operation *operation;
+
+    if (pa_context_connect(context, NULL, PA_CONTEXT_NOFLAGS, NULL) < 0)
+        return;
+
+    while ((context_state = pa_context_get_state(context)) != PA_CONTEXT_READY) {
+        if (!PA_CONTEXT_IS_GOOD(context_state))
+            return;
+        pa_threaded_mainloop_wait(query->mainloop);
+    }
+
+    if ((operation = pa_context_get_server_info(context, server_info_cb, query)) == NULL)
+        return;
+
+    while (!query->done)
+        pa_threaded_mainloop_wait(query->mainloop);
+    pa_operation_unref(operation);
+}
+
+int at_pulse_native_rate(void) {
+    pulse_rate_query_t query = {NULL, 0, false};
+    pa_context *context;
+
+    if ((query.mainloop = pa_threaded_mainloop_new()) == NULL)
+        return 0;
+
+    context = pa_context_new(pa_threaded_mainloop_get_api(query.mainloop), "Audio Toolkit");
+
+    if (context != NULL) {
+        pa_context_set_state_callback(context, context_state_cb, query.mainloop);
+
+        if (pa_threaded_mainloop_start(query.mainloop) == 0) {
+            pa_threaded_mainloop_lock(query.mainloop);
+            pulse_query_rate(context, &query);
+            pa_threaded_mainloop_unlock(query.mainloop);
+            pa_threaded_mainloop_stop(query.mainloop);
+        }
+
+        pa_context_disconnect(context);
+        pa_context_unref(context);
+    }
+
+    pa_threaded_mainloop_free(query.mainloop);
+
+    return query.rate;
+}
+
+at_pulse_t *at_pulse_open(int channels, int samplerate) {
+    at_pulse_t *pulse = at_malloc(sizeof(*pulse));
+
+    memset(pulse, 0, sizeof(*pulse));
+    pulse->spec.rate = (uint32_t) samplerate;
+    pulse->spec.format = PA_SAMPLE_FLOAT32LE;
+    pulse->spec.channels = (uint8_t) channels;
+
+    if (!at_get_pulse_simple()) {
+        if (pulse_connect(pulse, channels) == 0) {
+            // ring holds at least one second of audio, so that processing can run well ahead
+            size_t frame = pa_frame_size(&pulse->spec);
+            size_t tlength = pa_usec_to_bytes((pa_usec_t) at_get_pulse_latency() * 1000, &pulse->spec);
+
+            pulse->size = MAX(4 * tlength, pa_usec_to_bytes(1000000, &pulse->spec));
+            pulse->size -= pulse->size % frame;
+            pulse->buffer = at_malloc(pulse->size);
+
+            return pulse;
+        }
+
+        pulse_disconnect(pulse);
+        puts("Asynchronous PulseAudio playback not available, using Simple API.");
+    }
+
+    pulse->simple = at_pulse_init(channels, samplerate);
+
+    return pulse;
+}
+
+void at_pulse_write(at_pulse_t *pulse, const float *data, size_t samples) {
+    const char *bytes = (const char *) data;
+    size_t length = sizeof(*data) * samples;
+    int error;
+
+    if (pulse->simple != NULL) {
+        if (pa_simple_write(pulse->simple, data, length, &error) < 0) {
+            fprintf(stderr, __FILE__": pa_simple_write() failed: %s\n", pa_strerror(error));
+            exit(1);
+        }
+        return;
+    }
+
+    while (length > 0) {
+        size_t head = pulse->head;
+        size_t free = pulse->size - (head - __atomic_load_n(&pulse->tail, __ATOMIC_ACQUIRE));
+
+        // ring is full, wait until write callback takes some data
+        if (free == 0) {
+            pa_threaded_mainloop_lock(pulse->mainloop);
+            while (pulse->size == head - pulse->tail)
+                pa_threaded_mainloop_wait(pulse->mainloop);
+            pa_threaded_mainloop_unlock(pulse->mainloop);
+            continue;
+        }
+
+        size_t offset = head % pulse->size;
+        size_t chunk = MIN(MIN(length, free), pulse->size - offset);
+
+        memcpy(pulse->buffer + offset, bytes, chunk);
+        __atomic_store_n(&pulse->head, head + chunk, __ATOMIC_RELEASE);
+        bytes += chunk;
+        length -= chunk;
+    }
+
+    // server may be waiting for data which were not available in write callback
+    pa_threaded_mainloop_lock(pulse->mainloop);
+    pulse_fill(pulse);
+    pa_threaded_mainloop_unlock(pulse->mainloop);
+}
+
+void at_pulse_drain(at_pulse_t *pulse) {
+    pa_usec_t latency;
+    int negative;
+    int error;
+
+    /* Make sure that every single sample was played */
+    if (pulse->simple != NULL) {
+        if (pa_simple_drain(pulse->simple, &error) < 0) {
+            fprintf(stderr, __FILE__": pa_simple_drain() failed: %s\n", pa_strerror(error));
+            exit(1);
+        }
+        return;
+    }
+
+    pa_threaded_mainloop_lock(pulse->mainloop);
+
+    // wait until all queued samples are passed to server
+    while (pulse->head != pulse->tail)
+        pa_threaded_mainloop_wait(pulse->mainloop);
+
+    if (pa_stream_get_latency(pulse->stream, &latency, &negative) >= 0)
+        printf("\nPlayback latency: %.1f ms\n", (negative ? -1.0 : 1.0) * latency / 1000.0);
+
+    // short recordings may not fill prebuffer of server
+    pa_operation *trigger = pa_stream_trigger(pulse->stream, NULL, NULL);
+    if (trigger != NULL)
+        pa_operation_unref(trigger);
+
+    pa_operation *operation = pa_stream_drain(pulse->stream, stream_drain_cb, pulse->mainloop);
+    if (operation == NULL) {
+        fprintf(stderr, __FILE__": pa_stream_drain() failed: %s\n", pa_strerror(pa_context_errno(pulse->context)));
+        exit(1);
+    }
+
+    while (pa_operation_get_state(operation) == PA_OPERATION_RUNNING)
+        pa_threaded_mainloop_wait(pulse->mainloop);
+    pa_operation_unref(operation);
+
+    pa_threaded_mainloop_unlock(pulse->mainloop);
+}
+
+void at_pulse_close(at_pulse_t *pulse) {
+    if (pulse == NULL)
+        return;
+
+    if (pulse->simple != NULL)
+        pa_simple_free(pulse->simple);
+    else
+        pulse_disconnect(pulse);
+
+    free(pulse->buffer);
+    free(pulse);
+}
@@ -20,10 +20,35 @@
 
 #include "dsp.h"
 #include "audiotools.h"
+#include <pulse/pulseaudio.h>
 #include <pulse/simple.h>
 #include <pulse/error.h>
 
+#define PULSE_LATENCY     100                   // default target latency of playback in ms
+
+/* playback stream, asynchronous or using Simple API */
+typedef struct at_pulse_t at_pulse_t;
+
 // initialize PA Simple API
 pa_simple *at_pulse_init(int channels, int samplerate);
 
+/* Open playback stream on pa_threaded_mainloop with target latency and minimal request
+ * given by --pa-latency and --pa-minreq; blocking Simple API is used when requested
+ * by --pa-simple or when asynchronous stream cannot be created.
+ */
+at_pulse_t *at_pulse_open(int channels, int samplerate);
+
+/* Sample rate of default sink of PA server, used for resampling to native rate.
+ * Returns 0 when server is not available. */
+int at_pulse_native_rate(void);
+
+/* queue interleaved samples for playback; blocks only while queue is full */
+void at_pulse_write(at_pulse_t *pulse, const float *data, size_t samples);
+
+/* wait until all queued samples are played and report actual latency */
+void at_pulse_drain(at_pulse_t *pulse);
+
+/* close playback stream */
+void at_pulse_close(at_pulse_t *pulse);
+
 #endif /* PA_PLAY_H_ */
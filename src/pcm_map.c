@@ -0,0 +1,477 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "pcm_map.h"
+
+#define ALWAYS_INLINE static inline __attribute__((always_inline))
+
+#define WAVE_FORMAT_PCM           0x0001
+#define WAVE_FORMAT_IEEE_FLOAT    0x0003
+#define WAVE_FORMAT_EXTENSIBLE    0xFFFE
+
+/* Call kernel with channel count known at compile time, so that strided loads
+ * of each layout are vectorized by compiler. */
+#define SPECIALISE(kernel, a, b, channels, frames)          \
+    switch (channels) {                                     \
+        case 1: kernel(a, b, 1, frames); break;             \
+        case 2: kernel(a, b, 2, frames); break;             \
+        case 3: kernel(a, b, 3, frames); break;             \
+        case 4: kernel(a, b, 4, frames); break;             \
+        case 5: kernel(a, b, 5, frames); break;             \
+        case 6: kernel(a, b, 6, frames); break;             \
+        default: kernel(a, b, channels, frames); break;     \
+    }
+
+/* loads of unaligned values in given byte order */
+
+ALWAYS_INLINE uint16_t load_le16(const unsigned char *p) {
+    return (uint16_t) (p[0] | p[1] << 8);
+}
+
+ALWAYS_INLINE uint32_t load_le32(const unsigned char *p) {
+    return (uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+ALWAYS_INLINE uint64_t load_le64(const unsigned char *p) {
+    return (uint64_t) load_le32(p) | (uint64_t) load_le32(p + 4) << 32;
+}
+
+ALWAYS_INLINE uint16_t load_be16(const unsigned char *p) {
+    return (uint16_t) (p[0] << 8 | p[1]);
+}
+
+ALWAYS_INLINE uint32_t load_be32(const unsigned char *p) {
+    return (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 8 | (uint32_t) p[3];
+}
+
+ALWAYS_INLINE uint64_t load_be64(const unsigned char *p) {
+    return (uint64_t) load_be32(p) << 32 | (uint64_t) load_be32(p + 4);
+}
+
+/* Decoding of single sample. Integer samples are normalized by power of two scale as
+ * libsndfile does, so results are bit-exact with sf_readf_double()/sf_readf_float(). */
+
+ALWAYS_INLINE sample_t decode_u8(const unsigned char *p) {
+    return (sample_t) ((int) p[0] - 128) * (sample_t) (1.0 / 0x80);
+}
+
+ALWAYS_INLINE sample_t decode_s8(const unsigned char *p) {
+    return (sample_t) (signed char) p[0] * (sample_t) (1.0 / 0x80);
+}
+
+ALWAYS_INLINE sample_t decode_s16le(const unsigned char *p) {
+    return (sample_t) (int16_t) load_le16(p) * (sample_t) (1.0 / 0x8000);
+}
+
+ALWAYS_INLINE sample_t decode_s16be(const unsigned char *p) {
+    return (sample_t) (int16_t) load_be16(p) * (sample_t) (1.0 / 0x8000);
+}
+
+ALWAYS_INLINE sample_t decode_s24le(const unsigned char *p) {
+    int32_t x = (int32_t) ((uint32_t) p[0] << 8 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 24) >> 8;
+    return (sample_t) x * (sample_t) (1.0 / 0x800000);
+}
+
+ALWAYS_INLINE sample_t decode_s24be(const unsigned char *p) {
+    int32_t x = (int32_t) ((uint32_t) p[2] << 8 | (uint32_t) p[1] << 16 | (uint32_t) p[0] << 24) >> 8;
+    return (sample_t) x * (sample_t) (1.0 / 0x800000);
+}
+
+ALWAYS_INLINE sample_t decode_s32le(const unsigned char *p) {
+    return (sample_t) (int32_t) load_le32(p) * (sample_t) (1.0 / 0x80000000);
+}
+
+ALWAYS_INLINE sample_t decode_s32be(const unsigned char *p) {
+    return (sample_t) (int32_t) load_be32(p) * (sample_t) (1.0 / 0x80000000);
+}
+
+ALWAYS_INLINE sample_t decode_f32le(const unsigned char *p) {
+    uint32_t x = load_le32(p);
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return (sample_t) f;
+}
+
+ALWAYS_INLINE sample_t decode_f32be(const unsigned char *p) {
+    uint32_t x = load_be32(p);
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return (sample_t) f;
+}
+
+ALWAYS_INLINE sample_t decode_f64le(const unsigned char *p) {
+    uint64_t x = load_le64(p);
+    double d;
+    memcpy(&d, &x, sizeof(d));
+    return (sample_t) d;
+}
+
+ALWAYS_INLINE sample_t decode_f64be(const unsigned char *p) {
+    uint64_t x = load_be64(p);
+    double d;
+    memcpy(&d, &x, sizeof(d));
+    return (sample_t) d;
+}
+
+/* Kernels of each sample format: linear conversion of interleaved samples and conversion
+ * with deinterleaving, which walks mapped data once per channel. */
+#define DEFINE_KERNELS(name, bytes)                                                                     \
+    static void read_##name(const unsigned char *restrict in, sample_t *restrict out, size_t count) {    \
+        for (size_t i = 0; i < count; i++)                                                              \
+            out[i] = decode_##name(in + i * (bytes));                                                   \
+    }                                                                                                   \
+                                                                                                        \
+    ALWAYS_INLINE void deinterleave_##name##_kernel(const unsigned char *restrict in, sample_t *const *out, \
+                                                    const int channels, size_t frames) {               \
+        for (int c = 0; c < channels; c++) {                                                            \
+            const unsigned char *restrict src = in + c * (bytes);                                       \
+            sample_t *restrict dst = out[c];                                                            \
+            for (size_t j = 0; j < frames; j++)                                                         \
+                dst[j] = decode_##name(src + j * channels * (bytes));                                   \
+        }                                                                                               \
+    }                                                                                                   \
+                                                                                                        \
+    static void deinterleave_##name(const unsigned char *in, sample_t *const *out, int channels,        \
+                                    size_t frames) {                                                    \
+        SPECIALISE(deinterleave_##name##_kernel, in, out, channels, frames)                             \
+    }
+
+DEFINE_KERNELS(u8, 1)
+DEFINE_KERNELS(s8, 1)
+DEFINE_KERNELS(s16le, 2)
+DEFINE_KERNELS(s16be, 2)
+DEFINE_KERNELS(s24le, 3)
+DEFINE_KERNELS(s24be, 3)
+DEFINE_KERNELS(s32le, 4)
+DEFINE_KERNELS(s32be, 4)
+DEFINE_KERNELS(f32le, 4)
+DEFINE_KERNELS(f32be, 4)
+DEFINE_KERNELS(f64le, 8)
+DEFINE_KERNELS(f64be, 8)
+
+typedef struct pcm_kernels_t {
+    void (*read)(const unsigned char *restrict in, sample_t *restrict out, size_t count);
+    void (*deinterleave)(const unsigned char *in, sample_t *const *out, int channels, size_t frames);
+} pcm_kernels_t;
+
+// kernels indexed by format and byte order
+static const pcm_kernels_t pcm_kernels[][2] = {
+        [AT_PCM_U8] =     {{read_u8,    deinterleave_u8},    {read_u8,    deinterleave_u8}},
+        [AT_PCM_S8] =     {{read_s8,    deinterleave_s8},    {read_s8,    deinterleave_s8}},
+        [AT_PCM_S16] =    {{read_s16le, deinterleave_s16le}, {read_s16be, deinterleave_s16be}},
+        [AT_PCM_S24] =    {{read_s24le, deinterleave_s24le}, {read_s24be, deinterleave_s24be}},
+        [AT_PCM_S32] =    {{read_s32le, deinterleave_s32le}, {read_s32be, deinterleave_s32be}},
+        [AT_PCM_FLOAT] =  {{read_f32le, deinterleave_f32le}, {read_f32be, deinterleave_f32be}},
+        [AT_PCM_DOUBLE] = {{read_f64le, deinterleave_f64le}, {read_f64be, deinterleave_f64be}}
+};
+
+/* Parsing of headers. Each parser fills format of samples and returns offset and size of
+ * sample data, or false if the file is not a plain PCM file. */
+
+// GUIDs of W64 chunks
+static const unsigned char w64_riff[16] = {'r', 'i', 'f', 'f', 0x2E, 0x91, 0xCF, 0x11,
+                                           0xA5, 0xD6, 0x28, 0xDB, 0x04, 0xC1, 0x00, 0x00};
+static const unsigned char w64_wave[16] = {'w', 'a', 'v', 'e', 0xF3, 0xAC, 0xD3, 0x11,
+                                           0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A};
+static const unsigned char w64_fmt[16] = {'f', 'm', 't', ' ', 0xF3, 0xAC, 0xD3, 0x11,
+                                          0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A};
+static const unsigned char w64_data[16] = {'d', 'a', 't', 'a', 0xF3, 0xAC, 0xD3, 0x11,
+                                           0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A};
+
+// fmt chunk shared by WAV and W64
+static bool parse_fmt(at_pcm_map_t *map, const unsigned char *p, uint64_t size) {
+    if (size < 16)
+        return false;
+
+    int tag = load_le16(p);
+    int block_align = load_le16(p + 12);
+    int bits = load_le16(p + 14);
+
+    map->channels = load_le16(p + 2);
+    map->samplerate = (int) load_le32(p + 4);
+    map->big_endian = false;
+
+    // extensible format carries tag of samples in its sub-format GUID
+    if (tag == WAVE_FORMAT_EXTENSIBLE) {
+        if (size < 40)
+            return false;
+        tag = load_le16(p + 24);
+    }
+
+    if (tag == WAVE_FORMAT_PCM && bits == 8)
+        map->format = AT_PCM_U8;
+    else if (tag == WAVE_FORMAT_PCM && bits == 16)
+        map->format = AT_PCM_S16;
+    else if (tag == WAVE_FORMAT_PCM && bits == 24)
+        map->format = AT_PCM_S24;
+    else if (tag == WAVE_FORMAT_PCM && bits == 32)
+        map->format = AT_PCM_S32;
+    else if (tag == WAVE_FORMAT_IEEE_FLOAT && bits == 32)
+        map->format = AT_PCM_FLOAT;
+    else if (tag == WAVE_FORMAT_IEEE_FLOAT && bits == 64)
+        map->format = AT_PCM_DOUBLE;
+    else
+        return false;
+
+    map->bytes = bits / 8;
+
+    return map->channels > 0 && block_align == map->channels * map->bytes;
+}
+
+static bool parse_wav(at_pcm_map_t *map, const unsigned char *file, uint64_t size, uint64_t *offset,
+                      uint64_t *length) {
+    bool fmt = false, data = false;
+
+    if (size < 12 || memcmp(file, "RIFF", 4) != 0 || memcmp(file + 8, "WAVE", 4) != 0)
+        return false;
+
+    for (uint64_t pos = 12; pos + 8 <= size; ) {
+        const unsigned char *chunk = file + pos;
+        uint64_t chunk_size = load_le32(chunk + 4);
+
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            if (!parse_fmt(map, chunk + 8, MIN(chunk_size, size - pos - 8)))
+                return false;
+            fmt = true;
+        }
+        else if (memcmp(chunk, "data", 4) == 0) {
+            *offset = pos + 8;
+            *length = chunk_size;
+            data = true;
+        }
+
+        if (fmt && data)
+            return true;
+
+        pos += 8 + chunk_size + (chunk_size & 1);
+    }
+
+    return false;
+}
+
+static bool parse_w64(at_pcm_map_t *map, const unsigned char *file, uint64_t size, uint64_t *offset,
+                      uint64_t *length) {
+    bool fmt = false, data = false;
+
+    if (size < 40 || memcmp(file, w64_riff, 16) != 0 || memcmp(file + 24, w64_wave, 16) != 0)
+        return false;
+
+    // size of each chunk includes its 24-byte header, chunks are aligned to 8 bytes
+    for (uint64_t pos = 40; pos + 24 <= size; ) {
+        const unsigned char *chunk = file + pos;
+        uint64_t chunk_size = load_le64(chunk + 16);
+
+        if (chunk_size < 24)
+            return false;
+
+        if (memcmp(chunk, w64_fmt, 16) == 0) {
+            if (!parse_fmt(map, chunk + 24, MIN(chunk_size, size - pos) - 24))
+                return false;
+            fmt = true;
+        }
+        else if (memcmp(chunk, w64_data, 16) == 0) {
+            *offset = pos + 24;
+            *length = chunk_size - 24;
+            data = true;
+        }
+
+        if (fmt && data)
+            return true;
+
+        pos += (chunk_size + 7) & ~(uint64_t) 7;
+    }
+
+    return false;
+}
+
+// sample rate of AIFF is stored as 80-bit extended float
+static int aiff_samplerate(const unsigned char *p) {
+    int exponent = (p[0] & 0x7F) << 8 | p[1];
+    uint64_t mantissa = load_be64(p + 2);
+
+    if (exponent == 0 || exponent == 0x7FFF)
+        return 0;
+
+    return (int) ldexp((double) mantissa, exponent - 16383 - 63);
+}
+
+static bool parse_aiff(at_pcm_map_t *map, const unsigned char *file, uint64_t size, uint64_t *offset,
+                       uint64_t *length) {
+    bool comm = false, data = false;
+
+    if (size < 12 || memcmp(file, "FORM", 4) != 0)
+        return false;
+
+    bool aifc = memcmp(file + 8, "AIFC", 4) == 0;
+    if (!aifc && memcmp(file + 8, "AIFF", 4) != 0)
+        return false;
+
+    for (uint64_t pos = 12; pos + 8 <= size; ) {
+        const unsigned char *chunk = file + pos;
+        uint64_t chunk_size = load_be32(chunk + 4);
+        uint64_t available = MIN(chunk_size, size - pos - 8);
+
+        if (memcmp(chunk, "COMM", 4) == 0) {
+            if (available < (aifc ? 22 : 18))
+                return false;
+
+            int bits = load_be16(chunk + 14);
+
+            map->channels = load_be16(chunk + 8);
+            map->samplerate = aiff_samplerate(chunk + 16);
+            map->big_endian = true;
+
+            if (bits == 8)
+                map->format = AT_PCM_S8;
+            else if (bits == 16)
+                map->format = AT_PCM_S16;
+            else if (bits == 24)
+                map->format = AT_PCM_S24;
+            else if (bits == 32)
+                map->format = AT_PCM_S32;
+            else if (!aifc || bits != 64)
+                return false;
+
+            // compression type of AIFC selects byte order or float samples
+            if (aifc) {
+                const unsigned char *type = chunk + 26;
+
+                if (memcmp(type, "fl32", 4) == 0 || memcmp(type, "FL32", 4) == 0)
+                    map->format = AT_PCM_FLOAT;
+                else if (memcmp(type, "fl64", 4) == 0 || memcmp(type, "FL64", 4) == 0)
+                    map->format = AT_PCM_DOUBLE;
+                else if (memcmp(type, "sowt", 4) == 0 && bits != 8 && bits != 64)
+                    map->big_endian = false;
+                else if ((memcmp(type, "NONE", 4) != 0 && memcmp(type, "twos", 4) != 0) || bits == 64)
+                    return false;
+
+                if ((map->format == AT_PCM_FLOAT && bits != 32) || (map->format == AT_PCM_DOUBLE && bits != 64))
+                    return false;
+            }
+
+            map->bytes = bits / 8;
+            comm = map->channels > 0;
+            if (!comm)
+                return false;
+        }
+        else if (memcmp(chunk, "SSND", 4) == 0) {
+            if (available < 8)
+                return false;
+
+            // samples follow block alignment header and its offset
+            uint64_t skip = 8 + (uint64_t) load_be32(chunk + 8);
+            if (skip > chunk_size)
+                return false;
+
+            *offset = pos + 8 + skip;
+            *length = chunk_size - skip;
+            data = true;
+        }
+
+        if (comm && data)
+            return true;
+
+        pos += 8 + chunk_size + (chunk_size & 1);
+    }
+
+    return false;
+}
+
+at_pcm_map_t *at_pcm_map_open(const char *path) {
+    struct stat st;
+    at_pcm_map_t map;
+    uint64_t offset = 0, length = 0;
+    int fd;
+
+    memset(&map, 0, sizeof(map));
+
+    if (path == NULL || (fd = open(path, O_RDONLY)) < 0)
+        return NULL;
+
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 || (uint64_t) st.st_size > SIZE_MAX) {
+        close(fd);
+        return NULL;
+    }
+
+    map.size = (size_t) st.st_size;
+    map.base = mmap(NULL, map.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (map.base == MAP_FAILED)
+        return NULL;
+
+    const unsigned char *file = map.base;
+
+    if (!parse_wav(&map, file, map.size, &offset, &length) &&
+        !parse_w64(&map, file, map.size, &offset, &length) &&
+        !parse_aiff(&map, file, map.size, &offset, &length)) {
+        munmap(map.base, map.size);
+        return NULL;
+    }
+
+    // data of truncated file end with the file, as libsndfile does
+    if (offset > map.size) {
+        munmap(map.base, map.size);
+        return NULL;
+    }
+    length = MIN(length, map.size - offset);
+
+    map.data = file + offset;
+    map.frames = (sf_count_t) (length / ((uint64_t) map.bytes * map.channels));
+
+    // frames are converted in order, let kernel read ahead and drop pages behind
+    madvise(map.base, map.size, MADV_SEQUENTIAL);
+
+    at_pcm_map_t *result = at_malloc(sizeof(*result));
+    *result = map;
+
+    return result;
+}
+
+void at_pcm_map_close(at_pcm_map_t *map) {
+    if (map == NULL)
+        return;
+
+    munmap(map->base, map->size);
+    free(map);
+}
+
+sf_count_t at_pcm_map_read(const at_pcm_map_t *map, sf_count_t pos, sample_t *out, sf_count_t frames) {
+    const pcm_kernels_t *kernels = &pcm_kernels[map->format][map->big_endian];
+
+    if (pos >= map->frames)
+        return 0;
+
+    frames = MIN(frames, map->frames - pos);
+    kernels->read(map->data + pos * map->channels * map->bytes, out, (size_t) (frames * map->channels));
+
+    return frames;
+}
+
+void at_pcm_map_deinterleave(const at_pcm_map_t *map, sf_count_t pos, sample_t *const *out, size_t frames) {
+    const pcm_kernels_t *kernels = &pcm_kernels[map->format][map->big_endian];
+
+    kernels->deinterleave(map->data + pos * map->channels * map->bytes, out, map->channels, frames);
+}
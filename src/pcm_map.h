@@ -0,0 +1,69 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PCM_MAP_H_
+#define PCM_MAP_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sndfile.h>
+#include "common.h"
+
+/* Zero-copy input of uncompressed PCM files. WAV (including WAVE_FORMAT_EXTENSIBLE), W64
+ * and AIFF/AIFC files with 8 to 32-bit integer or 32/64-bit float samples are mapped into
+ * memory and their samples are converted straight from mapped pages, so neither libsndfile
+ * nor an intermediate interleaved buffer is involved. Conversion is bit-exact with
+ * libsndfile reading of normalized samples. All other inputs are left to libsndfile.
+ */
+
+typedef enum at_pcm_format_t {
+    AT_PCM_U8,          // unsigned 8-bit (WAV)
+    AT_PCM_S8,          // signed 8-bit (AIFF)
+    AT_PCM_S16,
+    AT_PCM_S24,
+    AT_PCM_S32,
+    AT_PCM_FLOAT,
+    AT_PCM_DOUBLE
+} at_pcm_format_t;
+
+typedef struct at_pcm_map_t {
+    void *base;                 // whole mapped file
+    size_t size;
+    const unsigned char *data;  // first frame of sample data
+    at_pcm_format_t format;
+    bool big_endian;            // byte order of samples (AIFF)
+    int bytes;                  // bytes per sample
+    int channels;
+    int samplerate;
+    sf_count_t frames;
+} at_pcm_map_t;
+
+/* map file and parse its header; returns NULL if the file is not a supported PCM file */
+at_pcm_map_t *at_pcm_map_open(const char *path);
+
+/* unmap file */
+void at_pcm_map_close(at_pcm_map_t *map);
+
+/* convert frames from position 'pos' into interleaved buffer 'out'; returns count of
+ * frames really converted, which is less than 'frames' at the end of data */
+sf_count_t at_pcm_map_read(const at_pcm_map_t *map, sf_count_t pos, sample_t *out, sf_count_t frames);
+
+/* convert frames from position 'pos' straight into separate channel buffers 'out';
+ * all frames must be available */
+void at_pcm_map_deinterleave(const at_pcm_map_t *map, sf_count_t pos, sample_t *const *out, size_t frames);
+
+#endif /* PCM_MAP_H_ */
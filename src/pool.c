@@ -0,0 +1,164 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "pool.h"
+#include "common.h"
+
+// startup data of a worker thread
+typedef struct pool_worker_t {
+    at_pool_t *pool;
+    int index;
+} pool_worker_t;
+
+struct at_pool_t {
+    int threads;                    // workers including the calling thread
+    pthread_t thread[MAX_THREADS];
+    pool_worker_t worker[MAX_THREADS];
+
+    pthread_mutex_t lock;
+    pthread_cond_t start;           // signalled when new batch of tasks is available
+    pthread_cond_t done;            // signalled when last task of a batch is finished
+
+    unsigned long generation;       // incremented for each batch of tasks
+    at_task_func_t func;            // current batch
+    void *user_data;
+    int tasks;
+    int next_task;                  // next task to be taken
+    int pending;                    // tasks not finished yet
+    bool shutdown;
+};
+
+// take tasks of current batch until none is left; called with pool lock held
+static void run_tasks(at_pool_t *pool, int worker) {
+    while (pool->next_task < pool->tasks) {
+        int task = pool->next_task++;
+
+        pthread_mutex_unlock(&pool->lock);
+        pool->func(pool->user_data, task, worker);
+        pthread_mutex_lock(&pool->lock);
+
+        if (--pool->pending == 0)
+            pthread_cond_broadcast(&pool->done);
+    }
+}
+
+static void *worker_main(void *arg) {
+    pool_worker_t *worker = arg;
+    at_pool_t *pool = worker->pool;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+
+    while (true) {
+        while (!pool->shutdown && pool->generation == seen)
+            pthread_cond_wait(&pool->start, &pool->lock);
+
+        if (pool->shutdown)
+            break;
+
+        seen = pool->generation;
+        run_tasks(pool, worker->index);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+at_pool_t *at_pool_create(int threads) {
+    if (threads < 1 || threads > MAX_THREADS) {
+        fprintf(stderr, "Error: Invalid count of threads %d, valid range is <1 - %d>.\n", threads, MAX_THREADS);
+        exit(1);
+    }
+
+    at_pool_t *pool = at_malloc(sizeof(*pool));
+
+    memset(pool, 0, sizeof(*pool));
+    pool->threads = threads;
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    // worker 0 is the calling thread
+    for (int i = 1; i < threads; i++) {
+        pool->worker[i].pool = pool;
+        pool->worker[i].index = i;
+
+        if (pthread_create(&pool->thread[i], NULL, worker_main, &pool->worker[i]) != 0) {
+            fprintf(stderr, "Error: Unable to start worker thread.\n");
+            exit(1);
+        }
+    }
+
+    return pool;
+}
+
+int at_pool_get_threads(const at_pool_t *pool) {
+    return pool->threads;
+}
+
+void at_pool_run(at_pool_t *pool, int tasks, at_task_func_t func, void *user_data) {
+    // nothing to distribute
+    if (pool->threads == 1 || tasks == 1) {
+        for (int i = 0; i < tasks; i++)
+            func(user_data, i, 0);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+
+    pool->func = func;
+    pool->user_data = user_data;
+    pool->tasks = tasks;
+    pool->next_task = 0;
+    pool->pending = tasks;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+
+    // calling thread works as well
+    run_tasks(pool, 0);
+
+    while (pool->pending > 0)
+        pthread_cond_wait(&pool->done, &pool->lock);
+
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void at_pool_free(at_pool_t *pool) {
+    if (pool == NULL)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = true;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 1; i < pool->threads; i++)
+        pthread_join(pool->thread[i], NULL);
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+
+    free(pool);
+}
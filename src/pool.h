@@ -0,0 +1,46 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef POOL_H_
+#define POOL_H_
+
+#define MAX_THREADS       64                    // maximum count of threads in worker pool
+
+/* Task executed by worker pool; 'task' is index of a task, 'worker' is index of a thread
+ * which runs it, in range <0, threads - 1>. Worker index can be used to select private
+ * scratch memory of the thread.
+ */
+typedef void (*at_task_func_t)(void *user_data, int task, int worker);
+
+typedef struct at_pool_t at_pool_t;
+
+/* Create pool of persistent worker threads. Calling thread takes part in processing
+ * as worker 0, so 'threads - 1' new threads are started. Pool with single thread
+ * runs all tasks serially in the caller.
+ */
+at_pool_t *at_pool_create(int threads);
+
+/* number of workers including the calling thread */
+int at_pool_get_threads(const at_pool_t *pool);
+
+/* run tasks <0, tasks - 1> on the pool and wait until all of them are finished */
+void at_pool_run(at_pool_t *pool, int tasks, at_task_func_t func, void *user_data);
+
+/* stop worker threads and free the pool */
+void at_pool_free(at_pool_t *pool);
+
+#endif /* POOL_H_ */
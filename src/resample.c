@@ -0,0 +1,440 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include "resample.h"
+#include "window.h"
+#include "arena.h"
+
+#if !defined(AT_NO_SIMD) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#    define AT_SIMD_X86
+#    include <immintrin.h>
+#endif
+
+#define ALWAYS_INLINE static inline __attribute__((always_inline))
+
+// filter of each quality preset; cutoff relative to the lower of both Nyquist frequencies
+typedef struct resample_preset_t {
+    const char *name;
+    int taps;                           // taps of a phase when upsampling, multiple of 16
+    int phases;                         // phases of interpolated table
+    double beta;                        // shape of Kaiser window, sets stopband attenuation
+    double cutoff;                      // stopband starts around Nyquist frequency
+} resample_preset_t;
+
+static const resample_preset_t presets[] = {
+        [AT_RESAMPLE_FAST]   = {"fast", 16, 64, 5.0, 0.80},
+        [AT_RESAMPLE_MEDIUM] = {"medium", 32, 256, 7.0, 0.86},
+        [AT_RESAMPLE_BEST]   = {"best", 64, 512, 9.0, 0.91}
+};
+
+int at_resample_quality_parse(const char *name, at_resample_quality_t *quality) {
+    for (int i = 0; i < ARRAY_LEN(presets); i++) {
+        if (strcasecmp(name, presets[i].name) == 0) {
+            *quality = (at_resample_quality_t) i;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+const char *at_resample_quality_name(at_resample_quality_t quality) {
+    return presets[quality].name;
+}
+
+/* inner product of history and a phase; taps are multiple of 16 and phases are aligned,
+ * interpolated variant blends products of two adjacent phases */
+
+ALWAYS_INLINE sample_t dot_scalar(const sample_t *restrict x, const sample_t *restrict h, int taps) {
+    sample_t a0 = 0, a1 = 0, a2 = 0, a3 = 0;
+
+    for (int k = 0; k < taps; k += 4) {
+        a0 += x[k] * h[k];
+        a1 += x[k + 1] * h[k + 1];
+        a2 += x[k + 2] * h[k + 2];
+        a3 += x[k + 3] * h[k + 3];
+    }
+
+    return (a0 + a1) + (a2 + a3);
+}
+
+ALWAYS_INLINE sample_t dot_interp_scalar(const sample_t *restrict x, const sample_t *restrict h0,
+                                  const sample_t *restrict h1, sample_t frac, int taps) {
+    sample_t y0 = dot_scalar(x, h0, taps);
+
+    return y0 + frac * (dot_scalar(x, h1, taps) - y0);
+}
+
+#if defined(AT_SIMD_X86) && defined(AT_SINGLE_PRECISION)
+
+ALWAYS_INLINE float hsum_ps(__m128 a) {
+    a = _mm_add_ps(a, _mm_movehl_ps(a, a));
+    a = _mm_add_ss(a, _mm_shuffle_ps(a, a, 1));
+
+    return _mm_cvtss_f32(a);
+}
+
+ALWAYS_INLINE float dot_sse(const float *restrict x, const float *restrict h, int taps) {
+    __m128 a0 = _mm_setzero_ps(), a1 = _mm_setzero_ps(), a2 = _mm_setzero_ps(), a3 = _mm_setzero_ps();
+
+    for (int k = 0; k < taps; k += 16) {
+        a0 = _mm_add_ps(a0, _mm_mul_ps(_mm_loadu_ps(x + k), _mm_load_ps(h + k)));
+        a1 = _mm_add_ps(a1, _mm_mul_ps(_mm_loadu_ps(x + k + 4), _mm_load_ps(h + k + 4)));
+        a2 = _mm_add_ps(a2, _mm_mul_ps(_mm_loadu_ps(x + k + 8), _mm_load_ps(h + k + 8)));
+        a3 = _mm_add_ps(a3, _mm_mul_ps(_mm_loadu_ps(x + k + 12), _mm_load_ps(h + k + 12)));
+    }
+
+    return hsum_ps(_mm_add_ps(_mm_add_ps(a0, a1), _mm_add_ps(a2, a3)));
+}
+
+ALWAYS_INLINE float dot_interp_sse(const float *restrict x, const float *restrict h0, const float *restrict h1,
+                            float frac, int taps) {
+    __m128 a0 = _mm_setzero_ps(), a1 = _mm_setzero_ps(), b0 = _mm_setzero_ps(), b1 = _mm_setzero_ps();
+
+    for (int k = 0; k < taps; k += 8) {
+        __m128 v0 = _mm_loadu_ps(x + k), v1 = _mm_loadu_ps(x + k + 4);
+        a0 = _mm_add_ps(a0, _mm_mul_ps(v0, _mm_load_ps(h0 + k)));
+        a1 = _mm_add_ps(a1, _mm_mul_ps(v1, _mm_load_ps(h0 + k + 4)));
+        b0 = _mm_add_ps(b0, _mm_mul_ps(v0, _mm_load_ps(h1 + k)));
+        b1 = _mm_add_ps(b1, _mm_mul_ps(v1, _mm_load_ps(h1 + k + 4)));
+    }
+
+    float y0 = hsum_ps(_mm_add_ps(a0, a1));
+
+    return y0 + frac * (hsum_ps(_mm_add_ps(b0, b1)) - y0);
+}
+
+#define AVX2 __attribute__((target("avx2,fma")))
+
+ALWAYS_INLINE AVX2 float hsum256_ps(__m256 a) {
+    return hsum_ps(_mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1)));
+}
+
+ALWAYS_INLINE AVX2 float dot_avx2(const float *restrict x, const float *restrict h, int taps) {
+    __m256 a0 = _mm256_setzero_ps(), a1 = _mm256_setzero_ps();
+
+    for (int k = 0; k < taps; k += 16) {
+        a0 = _mm256_fmadd_ps(_mm256_loadu_ps(x + k), _mm256_load_ps(h + k), a0);
+        a1 = _mm256_fmadd_ps(_mm256_loadu_ps(x + k + 8), _mm256_load_ps(h + k + 8), a1);
+    }
+
+    return hsum256_ps(_mm256_add_ps(a0, a1));
+}
+
+ALWAYS_INLINE AVX2 float dot_interp_avx2(const float *restrict x, const float *restrict h0, const float *restrict h1,
+                                  float frac, int taps) {
+    __m256 a0 = _mm256_setzero_ps(), a1 = _mm256_setzero_ps(), b0 = _mm256_setzero_ps(), b1 = _mm256_setzero_ps();
+
+    for (int k = 0; k < taps; k += 16) {
+        __m256 v0 = _mm256_loadu_ps(x + k), v1 = _mm256_loadu_ps(x + k + 8);
+        a0 = _mm256_fmadd_ps(v0, _mm256_load_ps(h0 + k), a0);
+        a1 = _mm256_fmadd_ps(v1, _mm256_load_ps(h0 + k + 8), a1);
+        b0 = _mm256_fmadd_ps(v0, _mm256_load_ps(h1 + k), b0);
+        b1 = _mm256_fmadd_ps(v1, _mm256_load_ps(h1 + k + 8), b1);
+    }
+
+    float y0 = hsum256_ps(_mm256_add_ps(a0, a1));
+
+    return y0 + frac * (hsum256_ps(_mm256_add_ps(b0, b1)) - y0);
+}
+
+#elif defined(AT_SIMD_X86)
+
+ALWAYS_INLINE double hsum_pd(__m128d a) {
+    return _mm_cvtsd_f64(_mm_add_sd(a, _mm_unpackhi_pd(a, a)));
+}
+
+ALWAYS_INLINE double dot_sse(const double *restrict x, const double *restrict h, int taps) {
+    __m128d a0 = _mm_setzero_pd(), a1 = _mm_setzero_pd(), a2 = _mm_setzero_pd(), a3 = _mm_setzero_pd();
+
+    for (int k = 0; k < taps; k += 8) {
+        a0 = _mm_add_pd(a0, _mm_mul_pd(_mm_loadu_pd(x + k), _mm_load_pd(h + k)));
+        a1 = _mm_add_pd(a1, _mm_mul_pd(_mm_loadu_pd(x + k + 2), _mm_load_pd(h + k + 2)));
+        a2 = _mm_add_pd(a2, _mm_mul_pd(_mm_loadu_pd(x + k + 4), _mm_load_pd(h + k + 4)));
+        a3 = _mm_add_pd(a3, _mm_mul_pd(_mm_loadu_pd(x + k + 6), _mm_load_pd(h + k + 6)));
+    }
+
+    return hsum_pd(_mm_add_pd(_mm_add_pd(a0, a1), _mm_add_pd(a2, a3)));
+}
+
+ALWAYS_INLINE double dot_interp_sse(const double *restrict x, const double *restrict h0, const double *restrict h1,
+                             double frac, int taps) {
+    __m128d a0 = _mm_setzero_pd(), a1 = _mm_setzero_pd(), b0 = _mm_setzero_pd(), b1 = _mm_setzero_pd();
+
+    for (int k = 0; k < taps; k += 4) {
+        __m128d v0 = _mm_loadu_pd(x + k), v1 = _mm_loadu_pd(x + k + 2);
+        a0 = _mm_add_pd(a0, _mm_mul_pd(v0, _mm_load_pd(h0 + k)));
+        a1 = _mm_add_pd(a1, _mm_mul_pd(v1, _mm_load_pd(h0 + k + 2)));
+        b0 = _mm_add_pd(b0, _mm_mul_pd(v0, _mm_load_pd(h1 + k)));
+        b1 = _mm_add_pd(b1, _mm_mul_pd(v1, _mm_load_pd(h1 + k + 2)));
+    }
+
+    double y0 = hsum_pd(_mm_add_pd(a0, a1));
+
+    return y0 + frac * (hsum_pd(_mm_add_pd(b0, b1)) - y0);
+}
+
+#define AVX2 __attribute__((target("avx2,fma")))
+
+ALWAYS_INLINE AVX2 double hsum256_pd(__m256d a) {
+    return hsum_pd(_mm_add_pd(_mm256_castpd256_pd128(a), _mm256_extractf128_pd(a, 1)));
+}
+
+ALWAYS_INLINE AVX2 double dot_avx2(const double *restrict x, const double *restrict h, int taps) {
+    __m256d a0 = _mm256_setzero_pd(), a1 = _mm256_setzero_pd(), a2 = _mm256_setzero_pd(), a3 = _mm256_setzero_pd();
+
+    for (int k = 0; k < taps; k += 16) {
+        a0 = _mm256_fmadd_pd(_mm256_loadu_pd(x + k), _mm256_load_pd(h + k), a0);
+        a1 = _mm256_fmadd_pd(_mm256_loadu_pd(x + k + 4), _mm256_load_pd(h + k + 4), a1);
+        a2 = _mm256_fmadd_pd(_mm256_loadu_pd(x + k + 8), _mm256_load_pd(h + k + 8), a2);
+        a3 = _mm256_fmadd_pd(_mm256_loadu_pd(x + k + 12), _mm256_load_pd(h + k + 12), a3);
+    }
+
+    return hsum256_pd(_mm256_add_pd(_mm256_add_pd(a0, a1), _mm256_add_pd(a2, a3)));
+}
+
+ALWAYS_INLINE AVX2 double dot_interp_avx2(const double *restrict x, const double *restrict h0, const double *restrict h1,
+                                   double frac, int taps) {
+    __m256d a0 = _mm256_setzero_pd(), a1 = _mm256_setzero_pd(), b0 = _mm256_setzero_pd(), b1 = _mm256_setzero_pd();
+
+    for (int k = 0; k < taps; k += 8) {
+        __m256d v0 = _mm256_loadu_pd(x + k), v1 = _mm256_loadu_pd(x + k + 4);
+        a0 = _mm256_fmadd_pd(v0, _mm256_load_pd(h0 + k), a0);
+        a1 = _mm256_fmadd_pd(v1, _mm256_load_pd(h0 + k + 4), a1);
+        b0 = _mm256_fmadd_pd(v0, _mm256_load_pd(h1 + k), b0);
+        b1 = _mm256_fmadd_pd(v1, _mm256_load_pd(h1 + k + 4), b1);
+    }
+
+    double y0 = hsum256_pd(_mm256_add_pd(a0, a1));
+
+    return y0 + frac * (hsum256_pd(_mm256_add_pd(b0, b1)) - y0);
+}
+
+#endif
+
+static uint64_t gcd(uint64_t a, uint64_t b) {
+    while (b != 0) {
+        uint64_t t = a % b;
+        a = b;
+        b = t;
+    }
+
+    return a;
+}
+
+// windowed sinc of each phase, normalized to unity gain at DC
+static void design_filter(sample_t *coefs, int phases, int taps, double cutoff, double beta) {
+    int center = taps / 2 - 1;
+
+    for (int p = 0; p <= phases; p++) {
+        sample_t *row = coefs + (size_t) p * taps;
+        double sum = 0;
+
+        for (int k = 0; k < taps; k++) {
+            double d = k - center - (double) p / phases;
+            double r = d / (taps / 2);
+            double x = M_PI * cutoff * d;
+            double sinc = x == 0 ? 1.0 : sin(x) / x;
+
+            row[k] = cutoff * sinc * at_bessel_i0(beta * sqrt(MAX(0.0, 1.0 - r * r))) / at_bessel_i0(beta);
+            sum += row[k];
+        }
+
+        for (int k = 0; k < taps; k++)
+            row[k] /= sum;
+    }
+}
+
+int at_resampler_init(at_resampler_t *resampler, double in_rate, int out_rate, int channels,
+                      at_resample_quality_t quality, size_t max_block) {
+    const resample_preset_t *preset = &presets[quality];
+
+    memset(resampler, 0, sizeof(*resampler));
+
+    if (in_rate <= 0 || out_rate <= 0 || channels < 1 || channels > MAX_CHANNELS)
+        return -1;
+
+    // lowpass of downsampling is narrower, so it needs proportionally more taps
+    double ratio = out_rate / in_rate;
+    int taps = (int) ceil(preset->taps / MIN(ratio, 1.0));
+
+    resampler->channels = channels;
+    resampler->taps = (taps + 15) & ~15;
+
+    // integer rates with small ratio use exact phases, others interpolate between phases
+    uint64_t divisor = in_rate == floor(in_rate) ? gcd((uint64_t) in_rate, (uint64_t) out_rate) : 0;
+
+    if (divisor != 0 && out_rate / divisor <= RESAMPLE_MAX_PHASES) {
+        resampler->exact = true;
+        resampler->phases = (int) (out_rate / divisor);
+        resampler->den = (uint64_t) out_rate / divisor;
+        resampler->step = (uint64_t) in_rate / divisor;
+    }
+    else {
+        resampler->exact = false;
+        resampler->phases = preset->phases;
+        resampler->den = (uint64_t) 1 << 32;
+        resampler->step = (uint64_t) llround(in_rate / out_rate * resampler->den);
+    }
+
+    resampler->coefs = at_malloc_aligned(ARENA_ALIGNMENT,
+                                         sizeof(sample_t) * (resampler->phases + 1) * resampler->taps);
+    design_filter(resampler->coefs, resampler->phases, resampler->taps, preset->cutoff * MIN(ratio, 1.0),
+                  preset->beta);
+
+    // history starts with zeros, so that the first output sample is centered on the first input sample
+    resampler->max_block = max_block;
+    resampler->filled = (size_t) (resampler->taps / 2 - 1);
+
+    for (int c = 0; c < channels; c++)
+        resampler->history[c] = init_buffer_sample(resampler->taps + max_block);
+
+    return 0;
+}
+
+size_t at_resampler_max_output(const at_resampler_t *resampler, size_t frames) {
+    return (size_t) ((frames * resampler->den + resampler->step - 1) / resampler->step) + 1;
+}
+
+/* Filter one channel from position 'pos' and fraction 'frac' of the history, until the filter
+ * runs out of input; kernels are inlined into a copy of the loop for each instruction set. */
+#define FILTER_CHANNEL(name, attr, dot, dot_interp)                                                 \
+static attr size_t name(const at_resampler_t *r, const sample_t *history, size_t filled,            \
+                        sample_t *restrict output, size_t *position, uint64_t *fraction) {          \
+    const size_t taps = (size_t) r->taps;                                                           \
+    const size_t step_whole = (size_t) (r->step / r->den);                                          \
+    const uint64_t step_frac = r->step % r->den, den = r->den;                                      \
+    size_t pos = *position, count = 0;                                                              \
+    uint64_t frac = *fraction;                                                                      \
+                                                                                                    \
+    while (pos + taps <= filled) {                                                                  \
+        if (r->exact)                                                                               \
+            output[count++] = dot(history + pos, r->coefs + frac * taps, (int) taps);               \
+        else {                                                                                      \
+            uint64_t phase = frac * (uint64_t) r->phases;                                           \
+            const sample_t *h0 = r->coefs + (phase >> 32) * taps;                                   \
+            sample_t blend = (sample_t) ((phase & 0xFFFFFFFFu) * (1.0 / 4294967296.0));            \
+                                                                                                    \
+            output[count++] = dot_interp(history + pos, h0, h0 + taps, blend, (int) taps);          \
+        }                                                                                           \
+                                                                                                    \
+        /* advance is split into whole and fractional samples, so the loop needs no division */    \
+        pos += step_whole;                                                                          \
+        frac += step_frac;                                                                          \
+        if (frac >= den) {                                                                          \
+            frac -= den;                                                                            \
+            pos++;                                                                                  \
+        }                                                                                           \
+    }                                                                                               \
+                                                                                                    \
+    *position = pos;                                                                                \
+    *fraction = frac;                                                                               \
+                                                                                                    \
+    return count;                                                                                   \
+}
+
+#ifdef AT_SIMD_X86
+FILTER_CHANNEL(filter_channel_sse, , dot_sse, dot_interp_sse)
+FILTER_CHANNEL(filter_channel_avx2, AVX2, dot_avx2, dot_interp_avx2)
+#else
+FILTER_CHANNEL(filter_channel_scalar, , dot_scalar, dot_interp_scalar)
+#endif
+
+/* Append 'frames' frames of 'in' to history, or zeros if 'in' is NULL, and filter them into
+ * 'out' starting at frame 'offset'; returns count of output frames. */
+static size_t resample_block(at_resampler_t *resampler, sample_t *const *in, size_t frames, sample_t *const *out,
+                             size_t offset) {
+    size_t filled = resampler->filled + frames;
+    size_t count = 0, pos = 0;
+    uint64_t frac = 0;
+
+    // positions of output samples are the same in all channels
+    for (int c = 0; c < resampler->channels; c++) {
+        sample_t *history = resampler->history[c];
+
+        if (in != NULL)
+            memcpy(history + resampler->filled, in[c], sizeof(*history) * frames);
+        else
+            memset(history + resampler->filled, 0, sizeof(*history) * frames);
+
+        pos = resampler->pos;
+        frac = resampler->frac;
+
+#ifdef AT_SIMD_X86
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+            count = filter_channel_avx2(resampler, history, filled, out[c] + offset, &pos, &frac);
+        else
+            count = filter_channel_sse(resampler, history, filled, out[c] + offset, &pos, &frac);
+#else
+        count = filter_channel_scalar(resampler, history, filled, out[c] + offset, &pos, &frac);
+#endif
+
+        // keep only samples needed by following output; position may be ahead of input when downsampling
+        size_t shift = MIN(pos, filled);
+        memmove(history, history + shift, sizeof(*history) * (filled - shift));
+    }
+
+    size_t shift = MIN(pos, filled);
+    resampler->filled = filled - shift;
+    resampler->pos = pos - shift;
+    resampler->frac = frac;
+    resampler->frames_out += count;
+
+    return count;
+}
+
+size_t at_resampler_process(at_resampler_t *resampler, sample_t *const *in, size_t frames, sample_t *const *out) {
+    if (frames > resampler->max_block) {
+        fprintf(stderr, "Error: Block of %zu frames is too large for resampler.\n", frames);
+        exit(1);
+    }
+
+    resampler->frames_in += frames;
+
+    return resample_block(resampler, in, frames, out, 0);
+}
+
+size_t at_resampler_flush(at_resampler_t *resampler, sample_t *const *out) {
+    // output sample is centered 'taps / 2 - 1' samples into filter, the last one needs 'taps / 2' more
+    size_t zeros = (size_t) resampler->taps / 2, count = 0;
+    uint64_t total = (uint64_t) ceil((double) resampler->frames_in * resampler->den / resampler->step);
+    uint64_t frames_out = resampler->frames_out;
+
+    while (zeros > 0) {
+        size_t block = MIN(zeros, resampler->max_block);
+
+        count += resample_block(resampler, NULL, block, out, count);
+        zeros -= block;
+    }
+
+    // output past the last input sample is dropped
+    count = (size_t) MIN(count, total > frames_out ? total - frames_out : 0);
+    resampler->frames_out = frames_out + count;
+
+    return count;
+}
+
+void at_resampler_free(at_resampler_t *resampler) {
+    for (int c = 0; c < resampler->channels; c++)
+        free(resampler->history[c]);
+    free(resampler->coefs);
+    memset(resampler, 0, sizeof(*resampler));
+}
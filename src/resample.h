@@ -0,0 +1,84 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RESAMPLE_H_
+#define RESAMPLE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "common.h"
+#include "dsp.h"
+
+/* Streaming polyphase resampler with Kaiser-windowed sinc filters. Rational ratios with
+ * a small count of phases (e.g. 44.1 -> 48 kHz, 160 phases) use an exact phase for each
+ * output sample; other ratios, like those given by playback speed, interpolate linearly
+ * between adjacent phases of a finer table. Filter state is kept across blocks, so frames
+ * of any length can be passed in. Inner products use SSE2 (AVX2/FMA when supported by CPU).
+ */
+
+#define RESAMPLE_MAX_PHASES    1024            // max. count of phases of exact rational ratio
+
+typedef enum at_resample_quality_t {
+    AT_RESAMPLE_FAST = 0,
+    AT_RESAMPLE_MEDIUM,
+    AT_RESAMPLE_BEST
+} at_resample_quality_t;
+
+typedef struct at_resampler_t {
+    int channels;
+    int taps;                           // taps of each phase, multiple of 16
+    int phases;                         // count of phases in table
+    bool exact;                         // each output sample falls on a phase of table
+    uint64_t step;                      // advance of input position per output sample, in units of 1 / 'den'
+    uint64_t den;                       // denominator of fractional position
+    uint64_t frac;                      // fractional position of next output sample
+    size_t pos;                         // position of next output sample in history
+    sample_t *coefs;                    // 'phases + 1' rows of 'taps' coefficients
+    sample_t *history[MAX_CHANNELS];    // input waiting for filtering
+    size_t filled;                      // count of samples in history
+    size_t max_block;                   // max. count of frames passed at once
+    uint64_t frames_in;                 // count of input frames passed in
+    uint64_t frames_out;                // count of output frames given out
+} at_resampler_t;
+
+/* translate quality preset given on command line; returns -1 for unknown name */
+int at_resample_quality_parse(const char *name, at_resample_quality_t *quality);
+
+/* name of quality preset */
+const char *at_resample_quality_name(at_resample_quality_t quality);
+
+/* Prepare resampler from 'in_rate' to 'out_rate' for blocks of up to 'max_block' frames.
+ * Output is aligned with input, the filter delay is compensated. Returns -1 if rates are invalid. */
+int at_resampler_init(at_resampler_t *resampler, double in_rate, int out_rate, int channels,
+                      at_resample_quality_t quality, size_t max_block);
+
+/* upper bound of count of output frames of a block of 'frames' frames */
+size_t at_resampler_max_output(const at_resampler_t *resampler, size_t frames);
+
+/* Resample 'frames' frames of separate channel buffers 'in' into 'out', which need room for
+ * at_resampler_max_output() frames. Returns count of output frames. */
+size_t at_resampler_process(at_resampler_t *resampler, sample_t *const *in, size_t frames, sample_t *const *out);
+
+/* Filter the last input samples at end of stream: history is padded by 'taps / 2' zeros and
+ * output is trimmed to ceil(input frames * ratio) frames in total. 'out' needs room for
+ * at_resampler_max_output() of 'taps / 2' frames. Returns count of output frames. */
+size_t at_resampler_flush(at_resampler_t *resampler, sample_t *const *out);
+
+void at_resampler_free(at_resampler_t *resampler);
+
+#endif /* RESAMPLE_H_ */
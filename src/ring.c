@@ -0,0 +1,97 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include "ring.h"
+
+/* Sleeping side announces itself by its waiting flag and then checks the ring again,
+ * the other side first publishes its position and then checks the flag. Both use
+ * sequentially consistent operations, so at least one of them notices the other
+ * and no wake-up is lost.
+ */
+
+// sleep until 'ready' is true; called by side owning 'waiting' flag
+static void ring_wait(at_ring_t *ring, int *waiting, pthread_cond_t *cond, bool (*ready)(const at_ring_t *)) {
+    pthread_mutex_lock(&ring->lock);
+    __atomic_store_n(waiting, 1, __ATOMIC_SEQ_CST);
+
+    while (!ready(ring))
+        pthread_cond_wait(cond, &ring->lock);
+
+    __atomic_store_n(waiting, 0, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&ring->lock);
+}
+
+// wake the other side if it sleeps
+static void ring_wake(at_ring_t *ring, int *waiting, pthread_cond_t *cond) {
+    if (__atomic_load_n(waiting, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&ring->lock);
+        pthread_cond_signal(cond);
+        pthread_mutex_unlock(&ring->lock);
+    }
+}
+
+static bool ring_not_full(const at_ring_t *ring) {
+    return __atomic_load_n(&ring->head, __ATOMIC_RELAXED) - __atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST)
+           < ring->count;
+}
+
+static bool ring_not_empty(const at_ring_t *ring) {
+    return __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) != __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+}
+
+void at_ring_init(at_ring_t *ring, void *memory, size_t count, size_t slot_size) {
+    memset(ring, 0, sizeof(*ring));
+
+    ring->slots = memory;
+    ring->count = count;
+    ring->slot_size = slot_size;
+
+    pthread_mutex_init(&ring->lock, NULL);
+    pthread_cond_init(&ring->not_full, NULL);
+    pthread_cond_init(&ring->not_empty, NULL);
+}
+
+void *at_ring_acquire_write(at_ring_t *ring) {
+    if (!ring_not_full(ring))
+        ring_wait(ring, &ring->producer_waiting, &ring->not_full, ring_not_full);
+
+    return ring->slots + (ring->head % ring->count) * ring->slot_size;
+}
+
+void at_ring_commit_write(at_ring_t *ring) {
+    __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_SEQ_CST);
+    ring_wake(ring, &ring->consumer_waiting, &ring->not_empty);
+}
+
+void *at_ring_acquire_read(at_ring_t *ring) {
+    if (!ring_not_empty(ring))
+        ring_wait(ring, &ring->consumer_waiting, &ring->not_empty, ring_not_empty);
+
+    return ring->slots + (ring->tail % ring->count) * ring->slot_size;
+}
+
+void at_ring_release_read(at_ring_t *ring) {
+    __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_SEQ_CST);
+    ring_wake(ring, &ring->producer_waiting, &ring->not_full);
+}
+
+void at_ring_destroy(at_ring_t *ring) {
+    pthread_mutex_destroy(&ring->lock);
+    pthread_cond_destroy(&ring->not_full);
+    pthread_cond_destroy(&ring->not_empty);
+}
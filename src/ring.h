@@ -0,0 +1,66 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RING_H_
+#define RING_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#define MAX_PIPELINE_DEPTH  64                  // maximum count of slots in a ring
+#define PIPELINE_DEPTH      4                   // default count of slots in a ring
+
+/* Bounded single-producer single-consumer ring of preallocated fixed size slots.
+ * Slots are exchanged without locks; mutex and condition variables are touched only
+ * when one side has to sleep because the ring is full (backpressure) or empty.
+ */
+typedef struct at_ring_t {
+    char *slots;                    // memory of all slots, owned by caller
+    size_t slot_size;
+    size_t count;                   // count of slots
+
+    // positions only grow, each is written by one side and kept on its own cache line
+    size_t head __attribute__((aligned(64)));     // slots committed by producer
+    size_t tail __attribute__((aligned(64)));     // slots released by consumer
+
+    int producer_waiting;
+    int consumer_waiting;
+    pthread_mutex_t lock;
+    pthread_cond_t not_full;
+    pthread_cond_t not_empty;
+} at_ring_t;
+
+/* initialize ring of 'count' slots of 'slot_size' bytes placed in 'memory' */
+void at_ring_init(at_ring_t *ring, void *memory, size_t count, size_t slot_size);
+
+/* get free slot to be filled by producer, blocks while ring is full */
+void *at_ring_acquire_write(at_ring_t *ring);
+
+/* pass slot obtained by at_ring_acquire_write() to consumer */
+void at_ring_commit_write(at_ring_t *ring);
+
+/* get oldest committed slot, blocks while ring is empty */
+void *at_ring_acquire_read(at_ring_t *ring);
+
+/* return slot obtained by at_ring_acquire_read() to producer */
+void at_ring_release_read(at_ring_t *ring);
+
+/* destroy synchronization objects of ring, memory of slots is owned by caller */
+void at_ring_destroy(at_ring_t *ring);
+
+#endif /* RING_H_ */
@@ -0,0 +1,153 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include "session.h"
+#include "audiotools.h"
+#include "dsp.h"
+#include "mix.h"
+
+struct at_session_t {
+    AT_INFO settings;                   // bound to thread calling into session
+    at_stream_t *stream;
+};
+
+void at_session_config_init(at_session_config_t *config) {
+    AT_INFO defaults;
+
+    at_default_settings(&defaults);
+
+    memset(config, 0, sizeof(*config));
+    config->frame_duration = 20;
+    config->overlap = 50;
+    config->volume = defaults.volume;
+    config->window = defaults.window;
+    config->kaiser_beta = defaults.kaiser_beta;
+    config->lfe_cutoff = defaults.lfe_cutoff;
+    config->lfe_slope = defaults.lfe_slope;
+    config->lfe_decimation = defaults.lfe_decimation;
+    config->plan_effort = defaults.plan_effort;
+    config->wisdom_file = defaults.wisdom_file;
+}
+
+// ranges of settings are the same as ranges accepted on command line
+static bool config_ranges_valid(const at_session_config_t *config) {
+    return config->channels >= 1 && config->channels <= MAX_CHANNELS && config->samplerate > 0 &&
+           config->out_channels >= 0 && config->out_channels <= MAX_CHANNELS &&
+           config->frame_duration >= 10 && config->frame_duration <= 30 &&
+           config->overlap >= 1 && config->overlap <= 99 &&
+           config->volume >= 0 && config->volume <= 2.0 &&
+           config->window >= AT_WINDOW_HAMMING && config->window <= AT_WINDOW_KAISER && config->kaiser_beta >= 0 &&
+           config->lfe_cutoff >= 20 && config->lfe_cutoff <= 500 &&
+           config->lfe_slope >= 12 && config->lfe_slope <= 96 && config->lfe_slope % 12 == 0 &&
+           config->lfe_decimation >= 1 && config->lfe_decimation <= MAX_LFE_DECIMATION &&
+           config->plan_effort >= AT_PLAN_ESTIMATE && config->plan_effort <= AT_PLAN_PATIENT;
+}
+
+// count of output channels given by settings
+static int config_out_channels(const at_session_config_t *config) {
+    if (config->lfe_only)
+        return 1;
+
+    return config->out_channels ? config->out_channels : config->channels;
+}
+
+/* Ranges of settings are the same as ranges accepted on command line. Sessions have no matrix
+ * of user, so input has to be mixed into output by a default matrix. */
+static bool config_valid(const at_session_config_t *config) {
+    at_mix_t mix;
+
+    if (!config_ranges_valid(config))
+        return false;
+
+    return at_mix_init(&mix, config->channels, config_out_channels(config), config->lfe_only) == 0;
+}
+
+at_session_t *at_session_create(const at_session_config_t *config) {
+    if (!config_valid(config))
+        return NULL;
+
+    at_session_t *session = at_malloc(sizeof(*session));
+    AT_INFO *settings = &session->settings;
+
+    at_default_settings(settings);
+
+    settings->out_channels = config_out_channels(config);
+    settings->lfe_only = config->lfe_only;
+    settings->frame_duration = config->frame_duration;
+    settings->overlap = config->overlap;
+    settings->volume = config->volume;
+    settings->playback_speed = 1.0;
+    settings->window = config->window;
+    settings->kaiser_beta = config->kaiser_beta;
+    settings->spectral_passthrough = config->spectral_passthrough;
+    settings->lfe_cutoff = config->lfe_cutoff;
+    settings->lfe_slope = config->lfe_slope;
+    settings->lfe_decimation = config->lfe_decimation;
+    settings->plan_effort = config->plan_effort;
+    settings->wisdom_file = config->wisdom_file;
+
+    // session is processed by calling thread, concurrency comes from running more sessions
+    settings->threads = 1;
+    settings->segments = 1;
+    settings->pipeline_depth = 0;
+    settings->mmap_input = false;
+
+    AT_INFO *previous = at_bind_settings(settings);
+    session->stream = at_stream_create(config->channels, config->samplerate);
+    at_bind_settings(previous);
+
+    return session;
+}
+
+size_t at_session_process(at_session_t *session, const sample_t *in, sample_t *out, size_t frames) {
+    AT_INFO *previous = at_bind_settings(&session->settings);
+    size_t written = at_stream_process(session->stream, in, frames, out);
+
+    at_bind_settings(previous);
+
+    return written;
+}
+
+size_t at_session_flush(at_session_t *session, sample_t *out) {
+    AT_INFO *previous = at_bind_settings(&session->settings);
+    size_t written = at_stream_flush(session->stream, out);
+
+    at_bind_settings(previous);
+
+    return written;
+}
+
+size_t at_session_max_output(const at_session_t *session, size_t frames) {
+    return at_stream_max_output(session->stream, frames);
+}
+
+size_t at_session_frame_step(const at_session_t *session) {
+    return at_stream_frame_step(session->stream);
+}
+
+int at_session_out_channels(const at_session_t *session) {
+    return session->settings.out_channels;
+}
+
+void at_session_free(at_session_t *session) {
+    if (session == NULL)
+        return;
+
+    at_stream_free(session->stream);
+    free(session);
+}
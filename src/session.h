@@ -0,0 +1,85 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SESSION_H_
+#define SESSION_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "common.h"
+#include "fft.h"
+#include "window.h"
+
+/* Embeddable processing engine of libaudiotools. A session owns its settings, buffers and FFT
+ * plans, so more sessions may run in one process, each of them on its own thread. Interleaved
+ * frames are pushed into session and processed output is pulled in the same call; output lags
+ * behind input by up to a frame, at_session_flush() returns the rest of it at the end of input.
+ * Output equals output of command line tool for the same settings, written as samples of the
+ * precision library was built with (sample_t, see AT_SINGLE_PRECISION).
+ *
+ * A single session must not be used from more threads at once. Creation of sessions is thread
+ * safe, FFT planning and wisdom cache are serialized between them.
+ */
+
+typedef struct at_session_t at_session_t;
+
+// settings of a session, at_session_config_init() fills in defaults of command line tool
+typedef struct at_session_config_t {
+    int channels;                   // count of channels of input, 1 - 12
+    int samplerate;                 // sample rate of input in Hz
+    int out_channels;               // count of channels of output 1 - 12, 0 for count of input channels
+    bool lfe_only;                  // LFE output only
+    int frame_duration;             // frame duration 10 - 30 ms
+    int overlap;                    // overlap of frames 1 - 99 %
+    double volume;                  // volume 0 - 2
+    at_window_type_t window;        // analysis window
+    double kaiser_beta;             // shape parameter of Kaiser window
+    bool spectral_passthrough;      // keep FFT/IFFT round trip without spectral stages
+    double lfe_cutoff;              // cutoff frequency of LFE filter 20 - 500 Hz
+    int lfe_slope;                  // slope of LFE filter 12 - 96 dB/oct, multiple of 12
+    int lfe_decimation;             // decimation factor of LFE filter
+    at_plan_effort_t plan_effort;   // FFTW planner effort
+    const char *wisdom_file;        // FFTW wisdom cache, NULL if disabled
+} at_session_config_t;
+
+/* fill 'config' with default settings; channels and sample rate of input are left zero */
+void at_session_config_init(at_session_config_t *config);
+
+/* create session for given settings; returns NULL if some of them is out of range, or if channels
+ * of input have no default mixing into channels of output (see at_mix_init()) */
+at_session_t *at_session_create(const at_session_config_t *config);
+
+/* Push 'frames' interleaved frames of input 'in' and pull processed output into 'out', which
+ * needs room for at_session_max_output() frames. Returns count of output frames stored. */
+size_t at_session_process(at_session_t *session, const sample_t *in, sample_t *out, size_t frames);
+
+/* Finish input; the rest of output, at most 2 * at_session_frame_step() frames, is stored into 'out'.
+ * Returns count of output frames stored, session is ready for another input afterwards. */
+size_t at_session_flush(at_session_t *session, sample_t *out);
+
+/* count of output frames given by at_session_process() of 'frames' frames */
+size_t at_session_max_output(const at_session_t *session, size_t frames);
+
+/* count of output frames given by each processed frame of input */
+size_t at_session_frame_step(const at_session_t *session);
+
+/* count of channels of output frames */
+int at_session_out_channels(const at_session_t *session);
+
+void at_session_free(at_session_t *session);
+
+#endif /* SESSION_H_ */
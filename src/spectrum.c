@@ -0,0 +1,403 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <math.h>
+#include <float.h>
+#include "spectrum.h"
+
+#if !defined(AT_NO_SIMD) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#    define AT_SIMD_X86
+#    include <immintrin.h>
+#endif
+
+#define ALWAYS_INLINE static inline __attribute__((always_inline))
+
+// odd polynomial approximating arctangent on <0, 1> (Hastings), error below 2e-6 rad
+#define ATAN_C0      0.99997726
+#define ATAN_C1     -0.33262347
+#define ATAN_C2      0.19354346
+#define ATAN_C3     -0.11643287
+#define ATAN_C4      0.05265332
+#define ATAN_C5     -0.01172120
+
+// pi / 2 split into two parts, so that reduction of angle by quarter turns is exact
+#define PIO2_HI      1.57079632679489655800e+00
+#define PIO2_LO      6.12323399573676603587e-17
+
+/* adding and subtracting 1.5 * 2^(mantissa bits) rounds to the nearest integer, ties to even;
+ * quadrants of sine and cosine are derived from rounded values without integer instructions */
+#ifdef AT_SINGLE_PRECISION
+#    define ROUND_MAGIC  12582912.0f
+#else
+#    define ROUND_MAGIC  6755399441055744.0
+#endif
+
+// smallest normal sample, divisor of arctangent is kept above it, so that bins of zero have zero phase
+#ifdef AT_SINGLE_PRECISION
+#    define SAMPLE_MIN   FLT_MIN
+#else
+#    define SAMPLE_MIN   DBL_MIN
+#endif
+
+/* scalar kernels, used for tails of spectra, as a fallback and by phase vocoder; they compute
+ * in double precision, the same polynomials are evaluated by vector kernels */
+
+// nearest integer of double, ties to even
+static inline double round_double(double x) {
+    return (x + 6755399441055744.0) - 6755399441055744.0;
+}
+
+double at_atan2(double y, double x) {
+    double ax = fabs(x), ay = fabs(y);
+    double a = MIN(ax, ay) / MAX(MAX(ax, ay), DBL_MIN), s = a * a;
+    double r = a * (ATAN_C0 + s * (ATAN_C1 + s * (ATAN_C2 + s * (ATAN_C3 + s * (ATAN_C4 + s * ATAN_C5)))));
+
+    r = ay > ax ? M_PI_2 - r : r;
+    r = x < 0 ? M_PI - r : r;
+
+    return copysign(r, y);
+}
+
+/* Angle is reduced by 'q' quarter turns to <-pi/4, pi/4>, where Taylor polynomials are accurate
+ * to 2e-9; odd 'q' swaps sine and cosine, 'q' of 2 or 3 modulo 4 negates both. */
+void at_sincos(double angle, double *sine, double *cosine) {
+    double q = round_double(angle * M_2_PI);
+    double r = (angle - q * PIO2_HI) - q * PIO2_LO, s = r * r;
+    double sin_r = r * (1 + s * (-1.0 / 6 + s * (1.0 / 120 + s * (-1.0 / 5040 + s * (1.0 / 362880)))));
+    double cos_r = 1 + s * (-1.0 / 2 + s * (1.0 / 24 + s * (-1.0 / 720 + s * (1.0 / 40320 + s * (-1.0 / 3628800)))));
+    double quarter = q - 4 * round_double(q * 0.25);
+    double sign = quarter < -0.5 || quarter > 1.5 ? -1 : 1;
+    int odd = q != 2 * round_double(q * 0.5);
+
+    *sine = sign * (odd ? cos_r : sin_r);
+    *cosine = sign * (odd ? -sin_r : cos_r);
+}
+
+#ifdef AT_SIMD_X86
+
+/* Vector primitives of each instruction set; kernels are written once in SPECTRUM_KERNELS()
+ * and instantiated for SSE2 and AVX2/FMA. Selects are done by masks of comparisons. */
+
+#ifdef AT_SINGLE_PRECISION
+typedef __m128 vec_sse;
+typedef __m256 vec_avx2;
+#    define WIDTH_sse           4
+#    define WIDTH_avx2          8
+#    define SSE(op)             _mm_##op##_ps
+#    define AVX(op)             _mm256_##op##_ps
+#else
+typedef __m128d vec_sse;
+typedef __m256d vec_avx2;
+#    define WIDTH_sse           2
+#    define WIDTH_avx2          4
+#    define SSE(op)             _mm_##op##_pd
+#    define AVX(op)             _mm256_##op##_pd
+#endif
+
+#define load_sse(p)             SSE(loadu)(p)
+#define store_sse(p, v)         SSE(storeu)(p, v)
+#define zero_sse()              SSE(setzero)()
+#define set1_sse(x)             SSE(set1)((sample_t) (x))
+#define add_sse(a, b)           SSE(add)(a, b)
+#define sub_sse(a, b)           SSE(sub)(a, b)
+#define mul_sse(a, b)           SSE(mul)(a, b)
+#define div_sse(a, b)           SSE(div)(a, b)
+#define sqrt_sse(a)             SSE(sqrt)(a)
+#define min_sse(a, b)           SSE(min)(a, b)
+#define max_sse(a, b)           SSE(max)(a, b)
+#define and_sse(a, b)           SSE(and)(a, b)
+#define andnot_sse(a, b)        SSE(andnot)(a, b)
+#define or_sse(a, b)            SSE(or)(a, b)
+#define xor_sse(a, b)           SSE(xor)(a, b)
+#define lt_sse(a, b)            SSE(cmplt)(a, b)
+#define gt_sse(a, b)            SSE(cmpgt)(a, b)
+#define neq_sse(a, b)           SSE(cmpneq)(a, b)
+#define fmadd_sse(a, b, c)      add_sse(mul_sse(a, b), c)
+#define fnmadd_sse(a, b, c)     sub_sse(c, mul_sse(a, b))
+
+#define load_avx2(p)            AVX(loadu)(p)
+#define store_avx2(p, v)        AVX(storeu)(p, v)
+#define zero_avx2()             AVX(setzero)()
+#define set1_avx2(x)            AVX(set1)((sample_t) (x))
+#define add_avx2(a, b)          AVX(add)(a, b)
+#define sub_avx2(a, b)          AVX(sub)(a, b)
+#define mul_avx2(a, b)          AVX(mul)(a, b)
+#define div_avx2(a, b)          AVX(div)(a, b)
+#define sqrt_avx2(a)            AVX(sqrt)(a)
+#define min_avx2(a, b)          AVX(min)(a, b)
+#define max_avx2(a, b)          AVX(max)(a, b)
+#define and_avx2(a, b)          AVX(and)(a, b)
+#define andnot_avx2(a, b)       AVX(andnot)(a, b)
+#define or_avx2(a, b)           AVX(or)(a, b)
+#define xor_avx2(a, b)          AVX(xor)(a, b)
+#define lt_avx2(a, b)           AVX(cmp)(a, b, _CMP_LT_OQ)
+#define gt_avx2(a, b)           AVX(cmp)(a, b, _CMP_GT_OQ)
+#define neq_avx2(a, b)          AVX(cmp)(a, b, _CMP_NEQ_UQ)
+#define fmadd_avx2(a, b, c)     AVX(fmadd)(a, b, c)
+#define fnmadd_avx2(a, b, c)    AVX(fnmadd)(a, b, c)
+
+#define AVX2 __attribute__((target("avx2,fma")))
+
+/* Each kernel processes whole vectors of bins from the beginning and returns count of processed
+ * bins, the rest is done by scalar kernels. */
+#define SPECTRUM_KERNELS(isa, attr)                                                                         \
+ALWAYS_INLINE attr vec_##isa select_##isa(vec_##isa mask, vec_##isa a, vec_##isa b) {                      \
+    return or_##isa(and_##isa(mask, a), andnot_##isa(mask, b));                                           \
+}                                                                                                           \
+                                                                                                            \
+ALWAYS_INLINE attr vec_##isa round_##isa(vec_##isa x) {                                                     \
+    return sub_##isa(add_##isa(x, set1_##isa(ROUND_MAGIC)), set1_##isa(ROUND_MAGIC));                        \
+}                                                                                                           \
+                                                                                                            \
+ALWAYS_INLINE attr vec_##isa atan2_##isa(vec_##isa y, vec_##isa x) {                                        \
+    vec_##isa sign = set1_##isa(-0.0);                                                                      \
+    vec_##isa ax = andnot_##isa(sign, x), ay = andnot_##isa(sign, y);                                       \
+    vec_##isa a = div_##isa(min_##isa(ax, ay), max_##isa(max_##isa(ax, ay), set1_##isa(SAMPLE_MIN)));       \
+    vec_##isa s = mul_##isa(a, a);                                                                          \
+    vec_##isa p = fmadd_##isa(s, set1_##isa(ATAN_C5), set1_##isa(ATAN_C4));                                 \
+                                                                                                            \
+    p = fmadd_##isa(s, p, set1_##isa(ATAN_C3));                                                             \
+    p = fmadd_##isa(s, p, set1_##isa(ATAN_C2));                                                             \
+    p = fmadd_##isa(s, p, set1_##isa(ATAN_C1));                                                             \
+    p = fmadd_##isa(s, p, set1_##isa(ATAN_C0));                                                             \
+                                                                                                            \
+    vec_##isa r = mul_##isa(a, p);                                                                          \
+    r = select_##isa(gt_##isa(ay, ax), sub_##isa(set1_##isa(M_PI_2), r), r);                                \
+    r = select_##isa(lt_##isa(x, zero_##isa()), sub_##isa(set1_##isa(M_PI), r), r);                  \
+                                                                                                            \
+    return or_##isa(r, and_##isa(sign, y));                                                                 \
+}                                                                                                           \
+                                                                                                            \
+ALWAYS_INLINE attr void sincos_##isa(vec_##isa angle, vec_##isa *sine, vec_##isa *cosine) {                 \
+    vec_##isa q = round_##isa(mul_##isa(angle, set1_##isa(M_2_PI)));                                        \
+    vec_##isa r = fnmadd_##isa(q, set1_##isa(PIO2_LO), fnmadd_##isa(q, set1_##isa(PIO2_HI), angle));        \
+    vec_##isa s = mul_##isa(r, r);                                                                          \
+    vec_##isa sin_r = fmadd_##isa(s, set1_##isa(1.0 / 362880), set1_##isa(-1.0 / 5040));                    \
+    vec_##isa cos_r = fmadd_##isa(s, set1_##isa(-1.0 / 3628800), set1_##isa(1.0 / 40320));                  \
+                                                                                                            \
+    sin_r = fmadd_##isa(s, sin_r, set1_##isa(1.0 / 120));                                                   \
+    sin_r = fmadd_##isa(s, sin_r, set1_##isa(-1.0 / 6));                                                    \
+    sin_r = mul_##isa(r, fmadd_##isa(s, sin_r, set1_##isa(1)));                                             \
+    cos_r = fmadd_##isa(s, cos_r, set1_##isa(-1.0 / 720));                                                  \
+    cos_r = fmadd_##isa(s, cos_r, set1_##isa(1.0 / 24));                                                    \
+    cos_r = fmadd_##isa(s, cos_r, set1_##isa(-1.0 / 2));                                                    \
+    cos_r = fmadd_##isa(s, cos_r, set1_##isa(1));                                                           \
+                                                                                                            \
+    vec_##isa quarter = fnmadd_##isa(set1_##isa(4), round_##isa(mul_##isa(q, set1_##isa(0.25))), q);        \
+    vec_##isa negate = or_##isa(lt_##isa(quarter, set1_##isa(-0.5)), gt_##isa(quarter, set1_##isa(1.5)));   \
+    vec_##isa odd = neq_##isa(q, mul_##isa(set1_##isa(2), round_##isa(mul_##isa(q, set1_##isa(0.5)))));     \
+    vec_##isa sign = and_##isa(negate, set1_##isa(-0.0));                                                   \
+                                                                                                            \
+    *sine = xor_##isa(select_##isa(odd, cos_r, sin_r), sign);                                               \
+    *cosine = xor_##isa(select_##isa(odd, xor_##isa(sin_r, set1_##isa(-0.0)), cos_r), sign);                \
+}                                                                                                           \
+                                                                                                            \
+static attr size_t magnitude_##isa(const sample_t *re, const sample_t *im, sample_t *magnitude, size_t bins) { \
+    size_t k;                                                                                               \
+                                                                                                            \
+    for (k = 0; k + WIDTH_##isa <= bins; k += WIDTH_##isa) {                                                \
+        vec_##isa x = load_##isa(re + k), y = load_##isa(im + k);                                           \
+        store_##isa(magnitude + k, sqrt_##isa(fmadd_##isa(x, x, mul_##isa(y, y))));                         \
+    }                                                                                                       \
+                                                                                                            \
+    return k;                                                                                               \
+}                                                                                                           \
+                                                                                                            \
+static attr size_t power_##isa(const sample_t *re, const sample_t *im, sample_t *power, size_t bins,        \
+                               double *sum) {                                                               \
+    vec_##isa total = zero_##isa();                                                                  \
+    sample_t lanes[WIDTH_##isa];                                                                            \
+    size_t k;                                                                                               \
+                                                                                                            \
+    for (k = 0; k + WIDTH_##isa <= bins; k += WIDTH_##isa) {                                                \
+        vec_##isa x = load_##isa(re + k), y = load_##isa(im + k);                                           \
+        vec_##isa p = fmadd_##isa(x, x, mul_##isa(y, y));                                                   \
+                                                                                                            \
+        store_##isa(power + k, p);                                                                          \
+        total = add_##isa(total, p);                                                                        \
+    }                                                                                                       \
+                                                                                                            \
+    store_##isa(lanes, total);                                                                              \
+    for (int i = 0; i < WIDTH_##isa; i++)                                                                   \
+        *sum += lanes[i];                                                                                   \
+                                                                                                            \
+    return k;                                                                                               \
+}                                                                                                           \
+                                                                                                            \
+static attr size_t phase_##isa(const sample_t *re, const sample_t *im, sample_t *phase, size_t bins) {      \
+    size_t k;                                                                                               \
+                                                                                                            \
+    for (k = 0; k + WIDTH_##isa <= bins; k += WIDTH_##isa)                                                  \
+        store_##isa(phase + k, atan2_##isa(load_##isa(im + k), load_##isa(re + k)));                        \
+                                                                                                            \
+    return k;                                                                                               \
+}                                                                                                           \
+                                                                                                            \
+static attr size_t polar_##isa(const sample_t *magnitude, const sample_t *phase, sample_t *re, sample_t *im, \
+                               size_t bins) {                                                               \
+    size_t k;                                                                                               \
+                                                                                                            \
+    for (k = 0; k + WIDTH_##isa <= bins; k += WIDTH_##isa) {                                                \
+        vec_##isa m = load_##isa(magnitude + k), sine, cosine;                                              \
+                                                                                                            \
+        sincos_##isa(load_##isa(phase + k), &sine, &cosine);                                                \
+        store_##isa(re + k, mul_##isa(m, cosine));                                                          \
+        store_##isa(im + k, mul_##isa(m, sine));                                                            \
+    }                                                                                                       \
+                                                                                                            \
+    return k;                                                                                               \
+}                                                                                                           \
+                                                                                                            \
+static attr size_t gain_##isa(const sample_t *gain, sample_t *re, sample_t *im, size_t bins) {              \
+    size_t k;                                                                                               \
+                                                                                                            \
+    for (k = 0; k + WIDTH_##isa <= bins; k += WIDTH_##isa) {                                                \
+        vec_##isa g = load_##isa(gain + k);                                                                 \
+                                                                                                            \
+        store_##isa(re + k, mul_##isa(load_##isa(re + k), g));                                              \
+        store_##isa(im + k, mul_##isa(load_##isa(im + k), g));                                              \
+    }                                                                                                       \
+                                                                                                            \
+    return k;                                                                                               \
+}                                                                                                           \
+                                                                                                            \
+static attr size_t complex_gain_##isa(const sample_t *gain_re, const sample_t *gain_im, sample_t *re,      \
+                                      sample_t *im, size_t bins) {                                          \
+    size_t k;                                                                                               \
+                                                                                                            \
+    for (k = 0; k + WIDTH_##isa <= bins; k += WIDTH_##isa) {                                                \
+        vec_##isa x = load_##isa(re + k), y = load_##isa(im + k);                                           \
+        vec_##isa g = load_##isa(gain_re + k), h = load_##isa(gain_im + k);                                 \
+                                                                                                            \
+        store_##isa(re + k, fnmadd_##isa(y, h, mul_##isa(x, g)));                                           \
+        store_##isa(im + k, fmadd_##isa(x, h, mul_##isa(y, g)));                                            \
+    }                                                                                                       \
+                                                                                                            \
+    return k;                                                                                               \
+}                                                                                                           \
+                                                                                                            \
+static attr size_t multiply_add_##isa(const sample_t *x_re, const sample_t *x_im, const sample_t *h_re,     \
+                                      const sample_t *h_im, sample_t *sum_re, sample_t *sum_im,             \
+                                      size_t bins) {                                                        \
+    size_t k;                                                                                               \
+                                                                                                            \
+    for (k = 0; k + WIDTH_##isa <= bins; k += WIDTH_##isa) {                                                \
+        vec_##isa xr = load_##isa(x_re + k), xi = load_##isa(x_im + k);                                     \
+        vec_##isa hr = load_##isa(h_re + k), hi = load_##isa(h_im + k);                                     \
+                                                                                                            \
+        store_##isa(sum_re + k, fnmadd_##isa(xi, hi, fmadd_##isa(xr, hr, load_##isa(sum_re + k))));         \
+        store_##isa(sum_im + k, fmadd_##isa(xi, hr, fmadd_##isa(xr, hi, load_##isa(sum_im + k))));          \
+    }                                                                                                       \
+                                                                                                            \
+    return k;                                                                                               \
+}
+
+SPECTRUM_KERNELS(sse, )
+SPECTRUM_KERNELS(avx2, AVX2)
+
+// run vector kernel of the best instruction set supported by CPU, returns count of processed bins
+#define DISPATCH(kernel, ...) \
+    (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") ? kernel##_avx2(__VA_ARGS__) \
+                                                                       : kernel##_sse(__VA_ARGS__))
+
+#else
+
+// scalar fallback, loops are left to auto-vectorization of compiler
+#define DISPATCH(kernel, ...)   ((size_t) 0)
+
+#endif
+
+void at_spectrum_magnitude(const sample_t *spectrum, int fft_size, sample_t *magnitude) {
+    const sample_t *re = spectrum, *im = spectrum + SPECTRUM_IMAG(fft_size);
+    size_t bins = SPECTRUM_BINS(fft_size);
+
+    for (size_t k = DISPATCH(magnitude, re, im, magnitude, bins); k < bins; k++)
+        magnitude[k] = sqrt(re[k] * re[k] + im[k] * im[k]);
+}
+
+double at_spectrum_power(const sample_t *spectrum, int fft_size, sample_t *power) {
+    const sample_t *re = spectrum, *im = spectrum + SPECTRUM_IMAG(fft_size);
+    size_t bins = SPECTRUM_BINS(fft_size);
+    double sum = 0;
+
+    for (size_t k = DISPATCH(power, re, im, power, bins, &sum); k < bins; k++) {
+        power[k] = re[k] * re[k] + im[k] * im[k];
+        sum += power[k];
+    }
+
+    return sum;
+}
+
+void at_spectrum_phase(const sample_t *spectrum, int fft_size, sample_t *phase) {
+    const sample_t *re = spectrum, *im = spectrum + SPECTRUM_IMAG(fft_size);
+    size_t bins = SPECTRUM_BINS(fft_size);
+
+    for (size_t k = DISPATCH(phase, re, im, phase, bins); k < bins; k++)
+        phase[k] = (sample_t) at_atan2(im[k], re[k]);
+}
+
+void at_spectrum_polar(const sample_t *magnitude, const sample_t *phase, int fft_size, sample_t *spectrum) {
+    sample_t *re = spectrum, *im = spectrum + SPECTRUM_IMAG(fft_size);
+    size_t bins = SPECTRUM_BINS(fft_size);
+
+    for (size_t k = DISPATCH(polar, magnitude, phase, re, im, bins); k < bins; k++) {
+        double sine, cosine;
+
+        at_sincos(phase[k], &sine, &cosine);
+        re[k] = magnitude[k] * cosine;
+        im[k] = magnitude[k] * sine;
+    }
+
+    // spectrum of real signal
+    im[0] = im[bins - 1] = 0;
+}
+
+void at_spectrum_gain(const sample_t *gain, int fft_size, sample_t *spectrum) {
+    sample_t *re = spectrum, *im = spectrum + SPECTRUM_IMAG(fft_size);
+    size_t bins = SPECTRUM_BINS(fft_size);
+
+    for (size_t k = DISPATCH(gain, gain, re, im, bins); k < bins; k++) {
+        re[k] *= gain[k];
+        im[k] *= gain[k];
+    }
+}
+
+void at_spectrum_complex_gain(const sample_t *gain, int fft_size, sample_t *spectrum) {
+    const sample_t *gain_re = gain, *gain_im = gain + SPECTRUM_IMAG(fft_size);
+    sample_t *re = spectrum, *im = spectrum + SPECTRUM_IMAG(fft_size);
+    size_t bins = SPECTRUM_BINS(fft_size);
+
+    for (size_t k = DISPATCH(complex_gain, gain_re, gain_im, re, im, bins); k < bins; k++) {
+        sample_t x = re[k], y = im[k];
+
+        re[k] = x * gain_re[k] - y * gain_im[k];
+        im[k] = x * gain_im[k] + y * gain_re[k];
+    }
+}
+
+void at_spectrum_multiply_add(const sample_t *x, const sample_t *h, int fft_size, sample_t *sum) {
+    const sample_t *x_re = x, *x_im = x + SPECTRUM_IMAG(fft_size);
+    const sample_t *h_re = h, *h_im = h + SPECTRUM_IMAG(fft_size);
+    sample_t *sum_re = sum, *sum_im = sum + SPECTRUM_IMAG(fft_size);
+    size_t bins = SPECTRUM_BINS(fft_size);
+
+    for (size_t k = DISPATCH(multiply_add, x_re, x_im, h_re, h_im, sum_re, sum_im, bins); k < bins; k++) {
+        sum_re[k] += x_re[k] * h_re[k] - x_im[k] * h_im[k];
+        sum_im[k] += x_re[k] * h_im[k] + x_im[k] * h_re[k];
+    }
+}
@@ -0,0 +1,59 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SPECTRUM_H_
+#define SPECTRUM_H_
+
+#include "common.h"
+#include "fft.h"
+
+/* Kernels on spectra of 'fft_size' transforms in split layout (see SPECTRUM_IMAG()); arrays of
+ * magnitudes, powers, phases and real gains hold SPECTRUM_BINS() samples, complex gains have
+ * the layout of spectra. Kernels have no branches on data, they use SSE2 (AVX2/FMA when
+ * supported by CPU). Phase is approximated with error below 2e-6 rad, sine and cosine of
+ * polar to rectangular conversion with error below 1e-8.
+ */
+
+/* magnitude of each bin */
+void at_spectrum_magnitude(const sample_t *spectrum, int fft_size, sample_t *magnitude);
+
+/* power of each bin; returns sum of powers of all bins */
+double at_spectrum_power(const sample_t *spectrum, int fft_size, sample_t *power);
+
+/* phase of each bin in <-pi, pi> */
+void at_spectrum_phase(const sample_t *spectrum, int fft_size, sample_t *phase);
+
+/* spectrum from magnitudes and phases; imaginary parts of DC and Nyquist bins are zero */
+void at_spectrum_polar(const sample_t *magnitude, const sample_t *phase, int fft_size, sample_t *spectrum);
+
+/* multiply each bin by real gain */
+void at_spectrum_gain(const sample_t *gain, int fft_size, sample_t *spectrum);
+
+/* multiply each bin by complex gain */
+void at_spectrum_complex_gain(const sample_t *gain, int fft_size, sample_t *spectrum);
+
+/* add product of spectra 'x' and 'h' to 'sum' */
+void at_spectrum_multiply_add(const sample_t *x, const sample_t *h, int fft_size, sample_t *sum);
+
+/* arctangent of y / x in <-pi, pi> by the polynomial of phase kernel, zero for zero 'x' and 'y' */
+double at_atan2(double y, double x);
+
+/* sine and cosine of any angle by the polynomials of polar kernel */
+void at_sincos(double angle, double *sine, double *cosine);
+
+#endif /* SPECTRUM_H_ */
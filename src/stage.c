@@ -0,0 +1,174 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stage.h"
+#include "fft.h"
+#include "stats.h"
+
+void at_stage_graph_init(at_stage_graph_t *graph) {
+    memset(graph, 0, sizeof(*graph));
+    graph->fft_stat = -1;
+    graph->ifft_stat = -1;
+}
+
+void at_stage_graph_add(at_stage_graph_t *graph, const char *name, at_stage_domain_t domain,
+                        at_stage_func_t process, void *user_data) {
+    if (graph->count >= MAX_STAGES) {
+        fprintf(stderr, "Error: Too many processing stages, unable to add stage '%s'.\n", name);
+        exit(1);
+    }
+
+    at_stage_t *stage = &graph->stages[graph->count++];
+
+    // transforms are timed as separate stages around spectral ones
+    if (domain != AT_STAGE_TIME_DOMAIN && graph->fft_stat < 0)
+        graph->fft_stat = at_stats_register("fft");
+    stage->stat = at_stats_register(name);
+    if (domain == AT_STAGE_FREQ_DOMAIN && graph->ifft_stat < 0)
+        graph->ifft_stat = at_stats_register("ifft");
+
+    stage->name = name;
+    stage->domain = domain;
+    stage->process = process;
+    stage->user_data = user_data;
+}
+
+bool at_stage_graph_needs_fft(const at_stage_graph_t *graph) {
+    for (int i = 0; i < graph->count; i++) {
+        if (graph->stages[i].domain != AT_STAGE_TIME_DOMAIN)
+            return true;
+    }
+
+    return false;
+}
+
+void at_stage_graph_set_pool(at_stage_graph_t *graph, at_pool_t *pool, sample_t **scratch) {
+    graph->pool = pool;
+    graph->scratch = scratch;
+}
+
+void at_stage_graph_set_batch(at_stage_graph_t *graph, at_fft_batch_t *batch) {
+    graph->batch = batch;
+}
+
+void at_stage_graph_free(at_stage_graph_t *graph) {
+    graph->pool = NULL;
+    graph->scratch = NULL;
+    graph->batch = NULL;
+}
+
+// data of a transform shared by all workers
+typedef struct transform_job_t {
+    const at_stage_graph_t *graph;
+    audio_container_t *td;
+    audio_container_t *fd;
+    size_t window_size;
+} transform_job_t;
+
+// worker task: forward transform of a single channel
+static void task_forward(void *user_data, int channel, int worker) {
+    transform_job_t *job = user_data;
+    at_compute_fft_r(job->td->channel[channel], job->window_size, job->fd->channel[channel],
+                     job->graph->scratch[worker]);
+}
+
+// worker task: inverse transform of a single channel
+static void task_backward(void *user_data, int channel, int worker) {
+    transform_job_t *job = user_data;
+    at_compute_ifft_r(job->fd->channel[channel], job->window_size, job->td->channel[channel],
+                      job->graph->scratch[worker]);
+}
+
+// transform all channels into frequency domain
+static void stage_forward(const at_stage_graph_t *graph, audio_container_t *td, audio_container_t *fd,
+                          size_t window_size) {
+    if (graph->pool != NULL) {
+        transform_job_t job = {graph, td, fd, window_size};
+        at_pool_run(graph->pool, td->used_channels, task_forward, &job);
+        return;
+    }
+
+    if (graph->batch != NULL) {
+        at_compute_fft_batch(graph->batch);
+        return;
+    }
+
+    for (int i = 0; i < td->used_channels; i++)
+        at_compute_fft(td->channel[i], window_size, fd->channel[i]);
+}
+
+// transform all channels back into time domain
+static void stage_backward(const at_stage_graph_t *graph, audio_container_t *fd, audio_container_t *td,
+                           size_t window_size) {
+    if (graph->pool != NULL) {
+        transform_job_t job = {graph, td, fd, window_size};
+        at_pool_run(graph->pool, td->used_channels, task_backward, &job);
+        return;
+    }
+
+    if (graph->batch != NULL) {
+        at_compute_ifft_batch(graph->batch);
+        return;
+    }
+
+    for (int i = 0; i < td->used_channels; i++)
+        at_compute_ifft(fd->channel[i], window_size, td->channel[i]);
+}
+
+void at_stage_graph_run(const at_stage_graph_t *graph, audio_container_t *td, audio_container_t *fd,
+                        size_t window_size) {
+    bool spectral = false;              // data are spectra of 'fd'
+    bool changed = false;               // spectra were changed since forward transform
+
+    for (int i = 0; i < graph->count; i++) {
+        const at_stage_t *stage = &graph->stages[i];
+        bool needs_spectrum = stage->domain != AT_STAGE_TIME_DOMAIN;
+
+        // insert transform if domain of data differs from the one of a stage
+        if (needs_spectrum != spectral) {
+            AT_STATS_BEGIN(transform);
+
+            if (needs_spectrum) {
+                stage_forward(graph, td, fd, window_size);
+                AT_STATS_END(graph->fft_stat, transform);
+                changed = false;
+            }
+            else if (changed) {
+                stage_backward(graph, fd, td, window_size);
+                AT_STATS_END(graph->ifft_stat, transform);
+            }
+
+            spectral = needs_spectrum;
+        }
+
+        changed = changed || stage->domain == AT_STAGE_FREQ_DOMAIN;
+
+        AT_STATS_BEGIN(start);
+        stage->process(spectral ? fd : td, stage->user_data);
+        AT_STATS_END(stage->stat, start);
+    }
+
+    // output of the graph is always in time domain
+    if (spectral && changed) {
+        AT_STATS_BEGIN(transform);
+        stage_backward(graph, fd, td, window_size);
+        AT_STATS_END(graph->ifft_stat, transform);
+    }
+}
@@ -0,0 +1,86 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STAGE_H_
+#define STAGE_H_
+
+#include <stdbool.h>
+#include "dsp.h"
+#include "pool.h"
+
+#define MAX_STAGES        16                    // maximum count of stages in processing graph
+
+typedef enum at_stage_domain_t {
+    AT_STAGE_TIME_DOMAIN = 0,    // stage works on time domain samples
+    AT_STAGE_FREQ_DOMAIN,        // stage works on FFT spectrum (split layout, see SPECTRUM_IMAG())
+    AT_STAGE_FREQ_OBSERVE        // stage only reads FFT spectrum, it is not transformed back for it
+} at_stage_domain_t;
+
+/* processing function of a stage, called once per frame */
+typedef void (*at_stage_func_t)(audio_container_t *container, void *user_data);
+
+typedef struct at_stage_t {
+    const char *name;               // name of a stage
+    at_stage_domain_t domain;       // domain of data processed by the stage
+    at_stage_func_t process;        // processing function
+    void *user_data;                // private data passed to processing function
+    int stat;                       // timing counter of the stage
+} at_stage_t;
+
+/* Processing graph is an ordered chain of stages. Transitions between time and frequency
+ * domain are inserted automatically, so FFT and IFFT are computed only when at least one
+ * frequency domain stage is present in the graph. Forward transform keeps time domain data,
+ * so IFFT is skipped when spectra were only observed since the last FFT.
+ */
+typedef struct at_stage_graph_t {
+    at_stage_t stages[MAX_STAGES];
+    int count;
+    at_pool_t *pool;                    // worker pool for per-channel transforms, may be NULL
+    sample_t **scratch;                 // FFT scratch buffer of each worker
+    at_fft_batch_t *batch;              // batched transform of all channels, may be NULL
+    int fft_stat;                       // timing counters of transforms, -1 without spectral stages
+    int ifft_stat;
+} at_stage_graph_t;
+
+/* initialize empty processing graph */
+void at_stage_graph_init(at_stage_graph_t *graph);
+
+/* append stage at the end of processing graph */
+void at_stage_graph_add(at_stage_graph_t *graph, const char *name, at_stage_domain_t domain,
+                        at_stage_func_t process, void *user_data);
+
+/* Transform channels in parallel on a worker pool; 'scratch' holds FFT scratch buffer
+ * of FFT size for each worker of the pool. Pool and buffers are owned by caller. */
+void at_stage_graph_set_pool(at_stage_graph_t *graph, at_pool_t *pool, sample_t **scratch);
+
+/* Transform all channels by one batched plan; plan has to be created for the containers
+ * later passed to at_stage_graph_run(). */
+void at_stage_graph_set_batch(at_stage_graph_t *graph, at_fft_batch_t *batch);
+
+/* detach processing graph from worker pool and batched transform */
+void at_stage_graph_free(at_stage_graph_t *graph);
+
+/* check for presence of any frequency domain stage */
+bool at_stage_graph_needs_fft(const at_stage_graph_t *graph);
+
+/* Run all stages on a single frame. Time domain data are taken from and returned in 'td',
+ * 'fd' is used as storage for spectrum of each channel.
+ */
+void at_stage_graph_run(const at_stage_graph_t *graph, audio_container_t *td, audio_container_t *fd,
+                        size_t window_size);
+
+#endif /* STAGE_H_ */
@@ -0,0 +1,209 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "stats.h"
+
+/* Histogram has 8 linear buckets for each power of two, so values are kept
+ * with relative error below 12.5 % in a constant amount of memory. */
+#define HIST_SUB_BITS     3
+#define HIST_SUB          (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS      ((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+
+typedef struct stat_counter_t {
+    const char *name;
+    uint64_t count;
+    uint64_t total;                 // sum of durations in ns
+    uint64_t max;
+    uint32_t hist[HIST_BUCKETS];
+} stat_counter_t;
+
+static stat_counter_t counters[MAX_STATS];
+static int counter_count = 0;
+static bool enabled = false;
+
+static int hist_bucket(uint64_t value) {
+    if (value < HIST_SUB)
+        return (int) value;
+
+    int msb = 63 - __builtin_clzll(value);
+
+    return (msb - HIST_SUB_BITS + 1) * HIST_SUB + (int) ((value >> (msb - HIST_SUB_BITS)) & (HIST_SUB - 1));
+}
+
+// middle of range of values falling into bucket
+static double hist_value(int bucket) {
+    if (bucket < HIST_SUB)
+        return bucket;
+
+    int shift = bucket / HIST_SUB - 1;
+    double low = (double) ((uint64_t) (HIST_SUB + bucket % HIST_SUB) << shift);
+
+    return low + (double) ((uint64_t) 1 << shift) / 2;
+}
+
+// value below which lies given fraction of recorded durations
+static double percentile(const stat_counter_t *counter, double fraction) {
+    uint64_t rank = (uint64_t) (fraction * counter->count + 0.5);
+    uint64_t seen = 0;
+
+    if (rank < 1)
+        rank = 1;
+
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += counter->hist[i];
+        if (seen >= rank)
+            return hist_value(i) < counter->max ? hist_value(i) : (double) counter->max;
+    }
+
+    return (double) counter->max;
+}
+
+void at_stats_enable(bool enable) {
+    enabled = enable;
+}
+
+bool at_stats_enabled(void) {
+    return enabled;
+}
+
+int at_stats_register(const char *name) {
+    // counters are not shared by sessions of library, which never enable statistics
+    if (!enabled)
+        return -1;
+
+    for (int i = 0; i < counter_count; i++) {
+        if (strcmp(counters[i].name, name) == 0)
+            return i;
+    }
+
+    if (counter_count >= MAX_STATS) {
+        fprintf(stderr, "Error: Too many timed stages, unable to add '%s'.\n", name);
+        exit(1);
+    }
+
+    memset(&counters[counter_count], 0, sizeof(counters[counter_count]));
+    counters[counter_count].name = name;
+
+    return counter_count++;
+}
+
+uint64_t at_stats_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+uint64_t at_stats_begin(void) {
+    return enabled ? at_stats_now() : 0;
+}
+
+uint64_t at_stats_end(int id, uint64_t start) {
+    if (start == 0 || id < 0)
+        return 0;
+
+    stat_counter_t *counter = &counters[id];
+    uint64_t duration = at_stats_now() - start;
+
+    counter->count++;
+    counter->total += duration;
+    if (duration > counter->max)
+        counter->max = duration;
+    counter->hist[hist_bucket(duration)]++;
+
+    return duration;
+}
+
+// total DSP time of all frames, used to express share of stages
+static uint64_t frame_total(void) {
+    for (int i = 0; i < counter_count; i++) {
+        if (strcmp(counters[i].name, "frame") == 0)
+            return counters[i].total;
+    }
+
+    return 0;
+}
+
+void at_stats_print(FILE *out, const at_stats_session_t *session) {
+    double audio = session->samplerate > 0 ? (double) session->samples / session->samplerate : 0;
+    double wall = session->wall_time / 1e9;
+    uint64_t frames_time = frame_total();
+
+    fprintf(out, "Processing statistics:\n");
+    fprintf(out, "-----------------------------------------------------------------------------\n");
+    fprintf(out, "%-12s %9s %11s %9s %9s %9s %9s %7s\n", "stage", "calls", "total [ms]", "mean [us]", "p50 [us]",
+            "p99 [us]", "max [us]", "frame");
+
+    for (int i = 0; i < counter_count; i++) {
+        const stat_counter_t *c = &counters[i];
+
+        if (c->count == 0)
+            continue;
+
+        fprintf(out, "%-12s %9llu %11.3f %9.2f %9.2f %9.2f %9.2f %6.1f%%\n", c->name, (unsigned long long) c->count,
+                c->total / 1e6, c->total / 1e3 / c->count, percentile(c, 0.50) / 1e3, percentile(c, 0.99) / 1e3,
+                c->max / 1e3, frames_time ? 100.0 * c->total / frames_time : 0);
+    }
+
+    fprintf(out, "-----------------------------------------------------------------------------\n");
+    fprintf(out, "Frames: %llu, %.1f frames/s\n", (unsigned long long) session->frames,
+            wall > 0 ? session->frames / wall : 0);
+    if (audio > 0)
+        fprintf(out, "Real-time factor: %.4f (%.1fx real time)\n", wall / audio, wall > 0 ? audio / wall : 0);
+}
+
+void at_stats_write_json(const char *path, const at_stats_session_t *session) {
+    double audio = session->samplerate > 0 ? (double) session->samples / session->samplerate : 0;
+    double wall = session->wall_time / 1e9;
+    FILE *out = fopen(path, "w");
+
+    if (out == NULL) {
+        fprintf(stderr, "Error: Unable to write statistics into '%s'.\n", path);
+        return;
+    }
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"frames\": %llu,\n", (unsigned long long) session->frames);
+    fprintf(out, "  \"frame_step\": %zu,\n", session->frame_step);
+    fprintf(out, "  \"samplerate\": %d,\n", session->samplerate);
+    fprintf(out, "  \"audio_seconds\": %.6f,\n", audio);
+    fprintf(out, "  \"wall_seconds\": %.6f,\n", wall);
+    fprintf(out, "  \"frames_per_second\": %.3f,\n", wall > 0 ? session->frames / wall : 0);
+    fprintf(out, "  \"realtime_factor\": %.6f,\n", audio > 0 ? wall / audio : 0);
+    fprintf(out, "  \"stages\": [");
+
+    bool first = true;
+    for (int i = 0; i < counter_count; i++) {
+        const stat_counter_t *c = &counters[i];
+
+        if (c->count == 0)
+            continue;
+
+        fprintf(out, "%s\n    {\"name\": \"%s\", \"calls\": %llu, \"total_ms\": %.6f, \"mean_us\": %.3f, "
+                     "\"p50_us\": %.3f, \"p99_us\": %.3f, \"max_us\": %.3f}", first ? "" : ",", c->name,
+                (unsigned long long) c->count, c->total / 1e6, c->total / 1e3 / c->count,
+                percentile(c, 0.50) / 1e3, percentile(c, 0.99) / 1e3, c->max / 1e3);
+        first = false;
+    }
+
+    fprintf(out, "\n  ]\n}\n");
+    fclose(out);
+}
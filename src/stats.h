@@ -0,0 +1,75 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STATS_H_
+#define STATS_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MAX_STATS         32                    // maximum count of timed stages
+
+/* Timing of processing stages by monotonic clock. Each stage registers a named
+ * counter, durations of its calls are collected into a log-linear histogram, so
+ * that percentiles are available without storing every sample. Counter has to be
+ * updated by a single thread only.
+ *
+ * Instrumentation in processing loop uses AT_STATS_BEGIN / AT_STATS_END, which are
+ * compiled out in builds without AT_STATS; at run time it is enabled by --stats.
+ */
+#ifdef AT_STATS
+#    define AT_STATS_BEGIN(start)     uint64_t start = at_stats_begin()
+#    define AT_STATS_END(id, start)   at_stats_end(id, start)
+#else
+#    define AT_STATS_BEGIN(start)
+#    define AT_STATS_END(id, start)
+#endif
+
+// summary of processing session for report
+typedef struct at_stats_session_t {
+    uint64_t frames;                // count of processed frames
+    uint64_t samples;               // count of processed samples per channel
+    int samplerate;
+    size_t frame_step;              // count of new samples per frame
+    uint64_t wall_time;             // wall time of processing in ns
+} at_stats_session_t;
+
+/* enable or disable collection of timings */
+void at_stats_enable(bool enable);
+
+bool at_stats_enabled(void);
+
+/* get counter of given name, new counter is created if it does not exist yet; -1 while disabled */
+int at_stats_register(const char *name);
+
+/* current time of monotonic clock in ns */
+uint64_t at_stats_now(void);
+
+/* start of timed section, 0 if timing is disabled */
+uint64_t at_stats_begin(void);
+
+/* record duration of timed section started at 'start'; returns the duration in ns */
+uint64_t at_stats_end(int id, uint64_t start);
+
+/* print human readable report */
+void at_stats_print(FILE *out, const at_stats_session_t *session);
+
+/* write report in JSON format into given file */
+void at_stats_write_json(const char *path, const at_stats_session_t *session);
+
+#endif /* STATS_H_ */
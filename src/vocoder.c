@@ -0,0 +1,179 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "vocoder.h"
+#include "spectrum.h"
+#include "window.h"
+
+// wrap phase into <-pi, pi>; turns are rounded by conversion to integer, which is inlined unlike floor()
+static inline double princarg(double phase) {
+    double turns = phase * (0.5 / M_PI);
+
+    return phase - 2 * M_PI * (double) (long) (turns + (turns < 0 ? -0.5 : 0.5));
+}
+
+size_t at_vocoder_hop(double tempo, size_t synthesis_hop, double *error) {
+    double exact = tempo * synthesis_hop + *error;
+    size_t hop = (size_t) MAX(floor(exact + 0.5), 1.0);
+
+    *error = exact - hop;
+
+    return hop;
+}
+
+void at_vocoder_init(at_vocoder_t *vocoder, double tempo, size_t window_size, int fft_size, size_t synthesis_hop,
+                     const sample_t *window, int channels) {
+    double energy = 0;
+
+    memset(vocoder, 0, sizeof(*vocoder));
+
+    vocoder->tempo = tempo;
+    vocoder->channels = channels;
+    vocoder->fft_size = fft_size;
+    vocoder->bins = fft_size / 2 + 1;
+    vocoder->synthesis_hop = synthesis_hop;
+    vocoder->window_size = window_size;
+
+    vocoder->power = init_buffer_sample((size_t) vocoder->bins);
+    vocoder->peaks = at_malloc(sizeof(*vocoder->peaks) * vocoder->bins);
+    vocoder->rotation = at_malloc(sizeof(*vocoder->rotation) * vocoder->bins);
+
+    for (int i = 0; i < vocoder->channels; i++) {
+        vocoder->analysis[i] = init_buffer_sample(SPECTRUM_SIZE((size_t) fft_size));
+        vocoder->angle[i] = at_malloc(sizeof(*vocoder->angle[i]) * vocoder->bins);
+    }
+
+    /* frames are weighted by window twice, by analysis and synthesis one; overlap-add
+     * of squared window with synthesis hop is normalized to unity gain */
+    for (size_t i = 0; i < window_size; i++)
+        energy += (double) window[i] * window[i];
+
+    vocoder->window = init_buffer_sample(window_size);
+    for (size_t i = 0; i < window_size; i++)
+        vocoder->window[i] = (sample_t) (window[i] * synthesis_hop / energy);
+}
+
+/* Peaks are bins with magnitude larger than two neighbouring bins on each side;
+ * DC and Nyquist bins are never peaks. Returns count of peaks. */
+static int find_peaks(const sample_t *power, int bins, int *peaks) {
+    int count = 0;
+
+    // bins are stored unconditionally and count is advanced by the comparison, spectra of noise
+    // have peaks at random, so that branches would be mispredicted
+    for (int k = 2; k < bins - 2; k++) {
+        sample_t m = power[k];
+
+        peaks[count] = k;
+        count += (m > power[k - 1]) & (m > power[k - 2]) & (m >= power[k + 1]) & (m >= power[k + 2]);
+    }
+
+    return count;
+}
+
+static void vocoder_channel(at_vocoder_t *vocoder, sample_t *freq, sample_t *analysis, double *angle,
+                            size_t analysis_hop) {
+    const int n = vocoder->fft_size, bins = vocoder->bins, imag = SPECTRUM_IMAG(n);
+    const double hop_a = (double) analysis_hop, hop_s = (double) vocoder->synthesis_hop;
+    double *rotation = vocoder->rotation;
+    int *peaks = vocoder->peaks;
+
+    // peaks are found in power spectrum, so magnitudes need no square roots
+    at_spectrum_power(freq, n, vocoder->power);
+    int count = find_peaks(vocoder->power, bins, peaks);
+
+    /* Phase of a peak advances by its instantaneous frequency over synthesis hop; frequency is
+     * given by deviation of measured phase advance over analysis hop from advance of bin centre.
+     * Output phase is input phase rotated by the angle kept for the bin in previous frame, so
+     * the new angle follows from measured advance alone. */
+    for (int i = 0; i < count; i++) {
+        int p = peaks[i];
+        double re = freq[p], im = freq[imag + p], prev_re = analysis[p], prev_im = analysis[imag + p];
+        double advance = at_atan2(im * prev_re - re * prev_im, re * prev_re + im * prev_im);
+        double omega = 2 * M_PI * p / n;
+        double deviation = princarg(advance - omega * hop_a);
+
+        rotation[i] = princarg(angle[p] - advance + (omega + deviation / hop_a) * hop_s);
+    }
+
+    memcpy(analysis, freq, sizeof(*freq) * SPECTRUM_SIZE(n));
+
+    /* region of a peak reaches half way to adjacent peaks; DC and Nyquist bins are real
+     * and they are left untouched, as are all bins of a spectrum without peaks */
+    angle[0] = angle[bins - 1] = 0;
+    if (count == 0)
+        memset(angle, 0, sizeof(*angle) * bins);
+
+    for (int i = 0, start = 1; i < count; i++) {
+        int end = i + 1 < count ? (peaks[i] + peaks[i + 1]) / 2 + 1 : bins - 1;
+        double cosine, sine;
+
+        at_sincos(rotation[i], &sine, &cosine);
+        sample_t c = (sample_t) cosine, s = (sample_t) sine;
+
+        for (int k = start; k < end; k++) {
+            sample_t re = freq[k], im = freq[imag + k];
+
+            freq[k] = re * c - im * s;
+            freq[imag + k] = re * s + im * c;
+            angle[k] = rotation[i];
+        }
+
+        start = end;
+    }
+}
+
+void at_vocoder_process(at_vocoder_t *vocoder, audio_container_t *spectrum, size_t analysis_hop) {
+    // the first frame keeps its phases, they are the reference for following frames
+    if (!vocoder->started) {
+        for (int i = 0; i < vocoder->channels; i++) {
+            memcpy(vocoder->analysis[i], spectrum->channel[i], sizeof(sample_t) * SPECTRUM_SIZE(vocoder->fft_size));
+            memset(vocoder->angle[i], 0, sizeof(*vocoder->angle[i]) * vocoder->bins);
+        }
+
+        vocoder->started = true;
+        return;
+    }
+
+    for (int i = 0; i < vocoder->channels; i++)
+        vocoder_channel(vocoder, spectrum->channel[i], vocoder->analysis[i], vocoder->angle[i], analysis_hop);
+}
+
+void at_vocoder_synthesis(const at_vocoder_t *vocoder, audio_container_t *frame) {
+    for (int i = 0; i < vocoder->channels; i++)
+        at_window_multiply(frame->channel[i], vocoder->window, vocoder->window_size);
+}
+
+void at_vocoder_reset(at_vocoder_t *vocoder) {
+    vocoder->started = false;
+}
+
+void at_vocoder_free(at_vocoder_t *vocoder) {
+    free(vocoder->power);
+    free(vocoder->peaks);
+    free(vocoder->rotation);
+    free(vocoder->window);
+
+    for (int i = 0; i < vocoder->channels; i++) {
+        free(vocoder->analysis[i]);
+        free(vocoder->angle[i]);
+    }
+
+    memset(vocoder, 0, sizeof(*vocoder));
+}
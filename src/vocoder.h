@@ -0,0 +1,74 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef VOCODER_H_
+#define VOCODER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "common.h"
+#include "dsp.h"
+
+/* Phase vocoder changing tempo without change of pitch. Frames are read with analysis hop
+ * 'tempo * synthesis_hop' and overlap-added with synthesis hop, so spectra of frames have to
+ * get phases consistent with synthesis hop. Phase locking by Laroche and Dolson: only peaks
+ * of magnitude spectrum get phase advanced by their instantaneous frequency, bins around
+ * a peak are rotated together with it, which keeps vertical coherence of partials. Rotation
+ * is applied to complex bins and phase advance of a peak is taken from the product of its bin
+ * and conjugated bin of previous frame, so trigonometric functions are evaluated only twice
+ * per peak.
+ */
+
+#define TEMPO_MIN_OVERLAP 75                    // min. overlap of frames in percents for tempo change
+
+typedef struct at_vocoder_t {
+    double tempo;
+    int channels;                       // count of processed channels
+    int fft_size;
+    int bins;                           // count of bins of spectrum, 'fft_size / 2 + 1'
+    size_t synthesis_hop;
+    size_t window_size;
+    bool started;                       // spectra of previous frame are valid
+    sample_t *power;                    // power spectrum of current channel
+    int *peaks;                         // bins of peaks of current channel
+    double *rotation;                   // phase rotation of each peak
+    sample_t *analysis[MAX_CHANNELS];   // input spectrum of previous frame
+    double *angle[MAX_CHANNELS];        // phase rotation of each bin of previous frame
+    sample_t *window;                   // synthesis window normalized for overlap-add
+} at_vocoder_t;
+
+/* Analysis hop of next frame; fractional part of 'tempo * synthesis_hop' is carried in 'error',
+ * so that average hop is exact. Returns 'synthesis_hop' for unchanged tempo. */
+size_t at_vocoder_hop(double tempo, size_t synthesis_hop, double *error);
+
+/* Prepare vocoder for frames of 'channels' channels of 'window_size' samples weighted by 'window',
+ * transformed by FFT of 'fft_size' and overlap-added with 'synthesis_hop' */
+void at_vocoder_init(at_vocoder_t *vocoder, double tempo, size_t window_size, int fft_size, size_t synthesis_hop,
+                     const sample_t *window, int channels);
+
+/* adjust phases of spectra of all channels of a frame read 'analysis_hop' samples after previous one */
+void at_vocoder_process(at_vocoder_t *vocoder, audio_container_t *spectrum, size_t analysis_hop);
+
+/* apply synthesis window to time domain frame of all channels */
+void at_vocoder_synthesis(const at_vocoder_t *vocoder, audio_container_t *frame);
+
+/* forget previous frame, so that following frame starts a new input */
+void at_vocoder_reset(at_vocoder_t *vocoder);
+
+void at_vocoder_free(at_vocoder_t *vocoder);
+
+#endif /* VOCODER_H_ */
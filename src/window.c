@@ -0,0 +1,158 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include <pthread.h>
+#include "window.h"
+#include "common.h"
+
+#ifndef M_PI
+#    define M_PI 3.14159265358979323846
+#endif
+
+// one cached window table
+typedef struct window_entry_t {
+    at_window_type_t type;
+    size_t length;
+    double beta;
+    sample_t *table;
+    struct window_entry_t *next;
+} window_entry_t;
+
+// list of already computed windows, shared by all sessions of a process
+static window_entry_t *cache = NULL;
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *window_names[] = {
+        [AT_WINDOW_HAMMING]   = "hamming",
+        [AT_WINDOW_HANN]      = "hann",
+        [AT_WINDOW_SQRT_HANN] = "sqrt-hann",
+        [AT_WINDOW_BLACKMAN]  = "blackman",
+        [AT_WINDOW_KAISER]    = "kaiser"
+};
+
+double at_bessel_i0(double x) {
+    double sum = 1.0, term = 1.0;
+    double y = x * x / 4.0;
+
+    for (int k = 1; k < 64; k++) {
+        term *= y / ((double) k * k);
+        sum += term;
+        if (term < sum * 1e-17)
+            break;
+    }
+
+    return sum;
+}
+
+// fill table with window of given type; windows are symmetric, same as original Hamming window
+static void compute_window(sample_t *table, at_window_type_t type, size_t length, double beta) {
+    if (length == 1) {
+        table[0] = 1.0;
+        return;
+    }
+
+    for (size_t j = 0; j < length; j++) {
+        switch (type) {
+            case AT_WINDOW_HAMMING:
+                table[j] = 0.54 - 0.46 * cos(2 * M_PI * j / (length - 1));
+                break;
+            case AT_WINDOW_HANN:
+                table[j] = 0.5 - 0.5 * cos(2 * M_PI * j / (length - 1));
+                break;
+            case AT_WINDOW_SQRT_HANN:
+                table[j] = sqrt(0.5 - 0.5 * cos(2 * M_PI * j / (length - 1)));
+                break;
+            case AT_WINDOW_BLACKMAN:
+                table[j] = 0.42 - 0.5 * cos(2 * M_PI * j / (length - 1))
+                           + 0.08 * cos(4 * M_PI * j / (length - 1));
+                break;
+            case AT_WINDOW_KAISER: {
+                double r = 2.0 * j / (length - 1) - 1.0;
+                table[j] = at_bessel_i0(beta * sqrt(MAX(0.0, 1.0 - r * r))) / at_bessel_i0(beta);
+                break;
+            }
+        }
+    }
+}
+
+int at_window_parse(const char *name, at_window_type_t *type) {
+    for (int i = 0; i < ARRAY_LEN(window_names); i++) {
+        if (strcasecmp(name, window_names[i]) == 0) {
+            *type = (at_window_type_t) i;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+const char *at_window_name(at_window_type_t type) {
+    return window_names[type];
+}
+
+const sample_t *at_window_get(at_window_type_t type, size_t length, double beta) {
+    // beta is a parameter of Kaiser window only
+    if (type != AT_WINDOW_KAISER)
+        beta = 0.0;
+
+    pthread_mutex_lock(&cache_lock);
+
+    for (window_entry_t *entry = cache; entry != NULL; entry = entry->next) {
+        if (entry->type == type && entry->length == length && entry->beta == beta) {
+            pthread_mutex_unlock(&cache_lock);
+            return entry->table;
+        }
+    }
+
+    // window not computed yet
+    window_entry_t *entry = at_malloc(sizeof(*entry));
+
+    entry->type = type;
+    entry->length = length;
+    entry->beta = beta;
+    entry->table = init_buffer_sample(length);
+    compute_window(entry->table, type, length, beta);
+
+    entry->next = cache;
+    cache = entry;
+
+    pthread_mutex_unlock(&cache_lock);
+
+    return entry->table;
+}
+
+void at_window_multiply(sample_t *restrict data, const sample_t *restrict window, size_t length) {
+    for (size_t j = 0; j < length; j++)
+        data[j] *= window[j];
+}
+
+void at_window_free_cache(void) {
+    pthread_mutex_lock(&cache_lock);
+
+    while (cache != NULL) {
+        window_entry_t *next = cache->next;
+        free(cache->table);
+        free(cache);
+        cache = next;
+    }
+
+    pthread_mutex_unlock(&cache_lock);
+}
@@ -0,0 +1,55 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef WINDOW_H_
+#define WINDOW_H_
+
+#include <stddef.h>
+#include "common.h"
+
+#define KAISER_BETA        8.6                    // default shape parameter of Kaiser window
+
+typedef enum at_window_type_t {
+    AT_WINDOW_HAMMING = 0,
+    AT_WINDOW_HANN,
+    AT_WINDOW_SQRT_HANN,
+    AT_WINDOW_BLACKMAN,
+    AT_WINDOW_KAISER
+} at_window_type_t;
+
+/* translate window name given on command line into window type; returns -1 for unknown name */
+int at_window_parse(const char *name, at_window_type_t *type);
+
+/* name of a window type */
+const char *at_window_name(at_window_type_t type);
+
+/* Get window table of given type and length. Table is computed on first request only
+ * and kept in cache, every subsequent call returns the same table. Parameter 'beta'
+ * is used by Kaiser window only. Cache may be used from more threads at once.
+ */
+const sample_t *at_window_get(at_window_type_t type, size_t length, double beta);
+
+/* multiply data by a window table */
+void at_window_multiply(sample_t *restrict data, const sample_t *restrict window, size_t length);
+
+/* modified Bessel function of the first kind, order zero (power series), shape of Kaiser window */
+double at_bessel_i0(double x);
+
+/* free all cached window tables */
+void at_window_free_cache(void);
+
+#endif /* WINDOW_H_ */
@@ -0,0 +1,194 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include "fft.h"
+#include "wisdom.h"
+
+#ifndef PATH_MAX
+#    define PATH_MAX 4096
+#endif
+
+// wisdom known after import, used to detect whether planner learned something new
+static char *imported_wisdom = NULL;
+
+// wisdom of single and double precision FFTW is not interchangeable
+#ifdef AT_SINGLE_PRECISION
+#    define WISDOM_FILE_NAME    "wisdom-float"
+#else
+#    define WISDOM_FILE_NAME    "wisdom"
+#endif
+
+// default location of wisdom cache, it is resolved only once for all sessions
+static char default_path[PATH_MAX];
+static const char *default_path_result = NULL;
+static pthread_once_t default_path_once = PTHREAD_ONCE_INIT;
+
+static void resolve_default_path(void) {
+    const char *cache_dir = getenv("XDG_CACHE_HOME");
+
+    if (cache_dir != NULL && cache_dir[0] != '\0')
+        snprintf(default_path, sizeof(default_path), "%s/audiotools/" WISDOM_FILE_NAME, cache_dir);
+    else if (getenv("HOME") != NULL)
+        snprintf(default_path, sizeof(default_path), "%s/.cache/audiotools/" WISDOM_FILE_NAME, getenv("HOME"));
+    else
+        return;
+
+    default_path_result = default_path;
+}
+
+const char *at_wisdom_default_path(void) {
+    pthread_once(&default_path_once, resolve_default_path);
+
+    return default_path_result;
+}
+
+// create all parent directories of a file
+static int make_parent_dirs(const char *path) {
+    char dir[PATH_MAX];
+
+    snprintf(dir, sizeof(dir), "%s", path);
+
+    for (char *p = dir + 1; *p != '\0'; p++) {
+        if (*p != '/')
+            continue;
+
+        *p = '\0';
+        if (mkdir(dir, 0755) < 0 && errno != EEXIST)
+            return -1;
+        *p = '/';
+    }
+
+    return 0;
+}
+
+// open and lock '<path>.lock'; returns file descriptor or -1
+static int lock_wisdom(const char *path, int operation) {
+    char lock_path[PATH_MAX];
+    int fd;
+
+    snprintf(lock_path, sizeof(lock_path), "%s.lock", path);
+
+    if ((fd = open(lock_path, O_RDWR | O_CREAT, 0644)) < 0)
+        return -1;
+
+    while (flock(fd, operation) < 0) {
+        if (errno != EINTR) {
+            close(fd);
+            return -1;
+        }
+    }
+
+    return fd;
+}
+
+static void unlock_wisdom(int fd) {
+    flock(fd, LOCK_UN);
+    close(fd);
+}
+
+// load wisdom from file, file needs to be locked by caller
+static bool read_wisdom(const char *path) {
+    FILE *file = fopen(path, "r");
+    bool loaded = false;
+
+    if (file != NULL) {
+        loaded = FFTW(import_wisdom_from_file)(file) != 0;
+        fclose(file);
+    }
+
+    return loaded;
+}
+
+bool at_wisdom_import(const char *path) {
+    bool loaded = false;
+    int fd;
+
+    if (path == NULL)
+        return false;
+
+    // there is nothing to import without a cache directory
+    if (make_parent_dirs(path) < 0 || (fd = lock_wisdom(path, LOCK_SH)) < 0)
+        return false;
+
+    loaded = read_wisdom(path);
+    unlock_wisdom(fd);
+
+    free(imported_wisdom);
+    imported_wisdom = FFTW(export_wisdom_to_string)();
+
+    return loaded;
+}
+
+int at_wisdom_export(const char *path) {
+    char tmp_path[PATH_MAX];
+    int fd;
+
+    if (path == NULL)
+        return 0;
+
+    // planner did not learn anything new, keep the file as it is
+    char *wisdom = FFTW(export_wisdom_to_string)();
+    bool unchanged = (wisdom != NULL && imported_wisdom != NULL && strcmp(wisdom, imported_wisdom) == 0);
+
+    free(wisdom);
+    free(imported_wisdom);
+    imported_wisdom = NULL;
+
+    if (unchanged)
+        return 0;
+
+    if (make_parent_dirs(path) < 0 || (fd = lock_wisdom(path, LOCK_EX)) < 0) {
+        fprintf(stderr, "Warning: Unable to lock FFTW wisdom file '%s': %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    // merge wisdom stored by other processes since import
+    read_wisdom(path);
+
+    // write into temporary file and atomically replace the old one
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%ld", path, (long) getpid());
+
+    FILE *file = fopen(tmp_path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Warning: Unable to store FFTW wisdom '%s': %s\n", tmp_path, strerror(errno));
+        unlock_wisdom(fd);
+        return -1;
+    }
+
+    FFTW(export_wisdom_to_file)(file);
+
+    if (fclose(file) != 0 || rename(tmp_path, path) < 0) {
+        fprintf(stderr, "Warning: Unable to store FFTW wisdom '%s': %s\n", path, strerror(errno));
+        unlink(tmp_path);
+        unlock_wisdom(fd);
+        return -1;
+    }
+
+    unlock_wisdom(fd);
+
+    return 0;
+}
@@ -0,0 +1,40 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef WISDOM_H_
+#define WISDOM_H_
+
+#include <stdbool.h>
+
+/* Persistent cache of FFTW wisdom. Wisdom file is guarded by a lock file '<path>.lock',
+ * readers take shared lock, writer takes exclusive lock, merges wisdom stored by other
+ * processes in a meantime and atomically replaces the file.
+ */
+
+/* default location of wisdom file: $XDG_CACHE_HOME/audiotools/wisdom or ~/.cache/audiotools/wisdom;
+ * single precision build uses file 'wisdom-float' */
+const char *at_wisdom_default_path(void);
+
+/* Import and export are not thread safe, fft.c calls them only while holding lock of planner. */
+
+/* import wisdom from file; returns true if some wisdom was loaded */
+bool at_wisdom_import(const char *path);
+
+/* store accumulated wisdom into file, if it differs from content loaded by at_wisdom_import() */
+int at_wisdom_export(const char *path);
+
+#endif /* WISDOM_H_ */
@@ -0,0 +1,295 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <math.h>
+#include <strings.h>
+#include "writer.h"
+#include "interleave.h"
+#include "dsp.h"
+
+#if !defined(AT_NO_SIMD) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#    define AT_SIMD_X86
+#    include <immintrin.h>
+#endif
+
+#define ALWAYS_INLINE static inline __attribute__((always_inline))
+
+#define WRITER_BLOCK    256                     // frames converted at once, channels of block stay in cache
+
+/* Call kernel with channel count known at compile time, so that a specialised
+ * version is generated for each common layout. */
+#define SPECIALISE(kernel, a, b, c, channels, frames)       \
+    switch (channels) {                                     \
+        case 1: kernel(a, b, c, 1, frames); break;          \
+        case 2: kernel(a, b, c, 2, frames); break;          \
+        case 3: kernel(a, b, c, 3, frames); break;          \
+        case 4: kernel(a, b, c, 4, frames); break;          \
+        case 5: kernel(a, b, c, 5, frames); break;          \
+        case 6: kernel(a, b, c, 6, frames); break;          \
+        default: kernel(a, b, c, channels, frames); break;  \
+    }
+
+// range of integer formats; scale is the one used by libsndfile for normalized samples
+typedef struct int_range_t {
+    double scale;
+    double min;
+    double max;
+    int shift;                          // left justification of 24-bit samples
+} int_range_t;
+
+static const int_range_t int_ranges[] = {
+        [AT_WRITER_S16] = {0x7FFF, -0x8000, 0x7FFF, 0},
+        [AT_WRITER_S24] = {0x7FFFFF, -0x800000, 0x7FFFFF, 8},
+        [AT_WRITER_S32] = {0x7FFFFFFF, -2147483648.0, 0x7FFFFFFF, 0}
+};
+
+// sample formats selectable on command line
+static const struct {
+    const char *name;
+    int sf_format;
+} sample_formats[] = {
+        {"s16",   SF_FORMAT_PCM_16},
+        {"s24",   SF_FORMAT_PCM_24},
+        {"s32",   SF_FORMAT_PCM_32},
+        {"float", SF_FORMAT_FLOAT}
+};
+
+int at_writer_parse(const char *name, int *sf_format) {
+    for (int i = 0; i < ARRAY_LEN(sample_formats); i++) {
+        if (strcasecmp(name, sample_formats[i].name) == 0) {
+            *sf_format = sample_formats[i].sf_format;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+const char *at_writer_name(int sf_format) {
+    for (int i = 0; i < ARRAY_LEN(sample_formats); i++) {
+        if (sample_formats[i].sf_format == (sf_format & SF_FORMAT_SUBMASK))
+            return sample_formats[i].name;
+    }
+
+    return "other";
+}
+
+at_writer_format_t at_writer_format(int sf_format) {
+    switch (sf_format & SF_FORMAT_SUBMASK) {
+        case SF_FORMAT_PCM_16:
+            return AT_WRITER_S16;
+        case SF_FORMAT_PCM_24:
+            return AT_WRITER_S24;
+        case SF_FORMAT_PCM_32:
+            return AT_WRITER_S32;
+        case SF_FORMAT_FLOAT:
+        case SF_FORMAT_VORBIS:
+            return AT_WRITER_FLOAT;
+        default:
+            return AT_WRITER_SAMPLE;
+    }
+}
+
+size_t at_writer_sample_size(at_writer_format_t format) {
+    switch (format) {
+        case AT_WRITER_S16:
+            return sizeof(int16_t);
+        case AT_WRITER_S24:
+        case AT_WRITER_S32:
+            return sizeof(int32_t);
+        case AT_WRITER_FLOAT:
+            return sizeof(float);
+        default:
+            return sizeof(sample_t);
+    }
+}
+
+void at_writer_init(at_writer_t *writer, at_writer_format_t format, int channels, bool dither) {
+    writer->format = format;
+    writer->channels = channels;
+    writer->dither = dither && format != AT_WRITER_FLOAT && format != AT_WRITER_SAMPLE;
+    writer->samples = 0;
+    writer->clipped = 0;
+    at_writer_seed(writer, 0);
+}
+
+void at_writer_seed(at_writer_t *writer, uint64_t position) {
+    // splitmix64 finalizer spreads adjacent positions over whole state
+    uint64_t z = position + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+
+    writer->state = (uint32_t) z ? (uint32_t) z : 1;
+}
+
+// TPDF noise in range (-1, 1) LSB, sum of two 16-bit uniform values taken from one step of xorshift generator
+static void dither_noise(at_writer_t *writer, double *noise, size_t count) {
+    uint32_t x = writer->state;
+
+    for (size_t i = 0; i < count; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+
+        noise[i] = (int) ((x & 0xFFFF) + (x >> 16)) * (1.0 / 0x10000) - 1.0;
+    }
+
+    writer->state = x;
+}
+
+/* Scale samples of a channel into integer range, add dither, saturate and round to nearest
+ * even, as lrint() does; returns count of saturated samples. */
+static uint64_t convert_int(int32_t *restrict out, const sample_t *restrict in, const double *restrict noise,
+                            size_t count, const int_range_t *range) {
+    uint64_t clipped = 0;
+    size_t i = 0;
+
+#ifdef AT_SIMD_X86
+    const __m128d scale = _mm_set1_pd(range->scale);
+    const __m128d min = _mm_set1_pd(range->min);
+    const __m128d max = _mm_set1_pd(range->max);
+
+    for (; i + 2 <= count; i += 2) {
+#ifdef AT_SINGLE_PRECISION
+        __m128d x = _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((const __m128i *) (in + i))));
+#else
+        __m128d x = _mm_loadu_pd(in + i);
+#endif
+        __m128d y = _mm_mul_pd(x, scale);
+
+        if (noise != NULL)
+            y = _mm_add_pd(y, _mm_loadu_pd(noise + i));
+
+        int mask = _mm_movemask_pd(_mm_or_pd(_mm_cmpgt_pd(y, max), _mm_cmplt_pd(y, min)));
+        clipped += (mask & 1) + (mask >> 1);
+        y = _mm_min_pd(_mm_max_pd(y, min), max);
+        _mm_storel_epi64((__m128i *) (out + i), _mm_cvtpd_epi32(y));
+    }
+#endif
+
+    for (; i < count; i++) {
+        double y = (double) in[i] * range->scale + (noise != NULL ? noise[i] : 0.0);
+
+        if (y > range->max) {
+            y = range->max;
+            clipped++;
+        }
+        else if (y < range->min) {
+            y = range->min;
+            clipped++;
+        }
+        else if (y != y)
+            y = range->min;
+
+        out[i] = (int32_t) lrint(y);
+    }
+
+    return clipped;
+}
+
+// samples of float output out of range <-1, 1> are counted, they clip on playback
+static unsigned convert_float(float *restrict out, const sample_t *restrict in, size_t count) {
+    unsigned clipped = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        out[i] = (float) in[i];
+        clipped += fabsf(out[i]) > 1.0f;
+    }
+
+    return clipped;
+}
+
+/* interleaving of converted block */
+
+ALWAYS_INLINE void interleave_s16(int16_t *restrict out, int32_t (*in)[WRITER_BLOCK], int shift,
+                                  const int channels, size_t frames) {
+    for (size_t j = 0; j < frames; j++)
+        for (int c = 0; c < channels; c++)
+            out[j * channels + c] = (int16_t) in[c][j];
+}
+
+ALWAYS_INLINE void interleave_s32(int32_t *restrict out, int32_t (*in)[WRITER_BLOCK], int shift,
+                                  const int channels, size_t frames) {
+    for (size_t j = 0; j < frames; j++)
+        for (int c = 0; c < channels; c++)
+            out[j * channels + c] = (int32_t) ((uint32_t) in[c][j] << shift);
+}
+
+ALWAYS_INLINE void interleave_f32(float *restrict out, float (*in)[WRITER_BLOCK], int shift,
+                                  const int channels, size_t frames) {
+    for (size_t j = 0; j < frames; j++)
+        for (int c = 0; c < channels; c++)
+            out[j * channels + c] = in[c][j];
+}
+
+void at_writer_convert(at_writer_t *writer, void *out, sample_t *const *in, size_t frames) {
+    int channels = writer->channels;
+
+    writer->samples += (uint64_t) frames * channels;
+
+    if (writer->format == AT_WRITER_SAMPLE) {
+        at_interleave(out, in, channels, frames);
+        return;
+    }
+
+    union {
+        int32_t i[MAX_CHANNELS][WRITER_BLOCK];
+        float f[MAX_CHANNELS][WRITER_BLOCK];
+    } block;
+    double noise[WRITER_BLOCK];
+
+    for (size_t start = 0; start < frames; start += WRITER_BLOCK) {
+        size_t count = MIN(frames - start, WRITER_BLOCK);
+        size_t offset = start * channels;
+
+        if (writer->format == AT_WRITER_FLOAT) {
+            for (int c = 0; c < channels; c++)
+                writer->clipped += convert_float(block.f[c], in[c] + start, count);
+
+            SPECIALISE(interleave_f32, (float *) out + offset, block.f, 0, channels, count)
+            continue;
+        }
+
+        const int_range_t *range = &int_ranges[writer->format];
+
+        for (int c = 0; c < channels; c++) {
+            if (writer->dither)
+                dither_noise(writer, noise, count);
+            writer->clipped += convert_int(block.i[c], in[c] + start, writer->dither ? noise : NULL, count, range);
+        }
+
+        if (writer->format == AT_WRITER_S16)
+            SPECIALISE(interleave_s16, (int16_t *) out + offset, block.i, 0, channels, count)
+        else
+            SPECIALISE(interleave_s32, (int32_t *) out + offset, block.i, range->shift, channels, count)
+    }
+}
+
+sf_count_t at_writer_write(const at_writer_t *writer, SNDFILE *file, const void *data, sf_count_t frames) {
+    switch (writer->format) {
+        case AT_WRITER_S16:
+            return sf_writef_short(file, data, frames);
+        case AT_WRITER_S24:
+        case AT_WRITER_S32:
+            return sf_writef_int(file, data, frames);
+        case AT_WRITER_FLOAT:
+            return sf_writef_float(file, data, frames);
+        default:
+            return sf_writef_sample(file, data, frames);
+    }
+}
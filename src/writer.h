@@ -0,0 +1,77 @@
+/*
+** Copyright (C) 2013 Vladimir Zahradnik <vladimir.zahradnik@gmail.com>
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 or version 3 of the
+** License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef WRITER_H_
+#define WRITER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <sndfile.h>
+#include "common.h"
+
+/* Output stage converting processed channel buffers straight into sample format of output:
+ * 16, 24 and 32-bit integers written by sf_writef_short()/sf_writef_int() and float, which
+ * is also used by PA server. Conversion and interleaving run in one pass over blocks of
+ * frames held in cache; integer conversion uses SSE2 on x86. Integer samples are scaled
+ * as libsndfile does, saturated and optionally dithered by TPDF noise of 1 LSB. Other
+ * formats get interleaved samples and are converted by libsndfile.
+ */
+
+typedef enum at_writer_format_t {
+    AT_WRITER_SAMPLE,       // interleaved sample_t, converted by libsndfile
+    AT_WRITER_S16,
+    AT_WRITER_S24,          // left-justified in 32-bit integers, as sf_writef_int() expects
+    AT_WRITER_S32,
+    AT_WRITER_FLOAT
+} at_writer_format_t;
+
+typedef struct at_writer_t {
+    at_writer_format_t format;
+    int channels;
+    bool dither;
+    uint32_t state;         // state of dither generator
+    uint64_t samples;       // count of converted samples
+    uint64_t clipped;       // count of samples out of range of output format
+} at_writer_t;
+
+/* translate sample format given on command line (s16, s24, s32, float) into libsndfile
+ * sub-format; returns -1 for unknown name */
+int at_writer_parse(const char *name, int *sf_format);
+
+/* name of libsndfile sub-format as accepted by at_writer_parse() */
+const char *at_writer_name(int sf_format);
+
+/* choose sample format of writer for given libsndfile format of output file */
+at_writer_format_t at_writer_format(int sf_format);
+
+/* size of converted sample in bytes */
+size_t at_writer_sample_size(at_writer_format_t format);
+
+void at_writer_init(at_writer_t *writer, at_writer_format_t format, int channels, bool dither);
+
+/* reseed dither generator by position of frame, so that output does not depend on order
+ * in which frames are converted */
+void at_writer_seed(at_writer_t *writer, uint64_t position);
+
+/* convert and interleave 'frames' frames of channel buffers 'in' into 'out' */
+void at_writer_convert(at_writer_t *writer, void *out, sample_t *const *in, size_t frames);
+
+/* write converted frames into output file */
+sf_count_t at_writer_write(const at_writer_t *writer, SNDFILE *file, const void *data, sf_count_t frames);
+
+#endif /* WRITER_H_ */